@@ -0,0 +1,713 @@
+#include "binary_fuse_filter.hpp"
+#include "bit_sliced_index.hpp"
+#include "bloom_filter.hpp"
+#include "compressed_bloom_filter.hpp"
+#include "concurrent_bloom_filter.hpp"
+#include "hashers.hpp"
+#include "huge_page_allocator.hpp"
+#include "partitioned_bloom_filter.hpp"
+#include "split_block_bloom_filter.hpp"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace BF
+{
+
+constexpr std::uint64_t HASH_COUNT = 7;
+constexpr std::uint64_t KEY_COUNT  = 1 << 16;
+constexpr std::uint64_t BATCH      = 1024;
+
+// filter sizes in bytes: L2 resident, LLC resident and well past the LLC
+#define BF_FILTER_SIZES ->Arg(256 << 10)->Arg(4 << 20)->Arg(64 << 20)->Arg(1 << 30)
+
+// A filter of the requested size whose bits are about half set, which is
+// what a filter filled up to its expected_elements looks like.
+template <typename index = modulo_index, typename allocator = aligned_allocator<std::uint64_t, 64>>
+inline bloom_filter<murmur3, index, no_stats, allocator> half_full_filter(std::uint64_t byte_count, std::uint64_t hash_count = HASH_COUNT)
+{
+    std::vector<std::uint8_t> raw(byte_count);
+    std::mt19937_64           rng(byte_count);
+    for (auto& byte : raw)
+        byte = static_cast<std::uint8_t>(rng());
+
+    const std::uint64_t                               m = byte_count * 8;
+    bloom_filter<murmur3, index, no_stats, allocator> bf;
+    bf.from(m, hash_count, m / 10, 0.01, raw.data(), raw.size());
+    return bf;
+}
+
+inline std::vector<std::uint64_t> random_keys(std::uint64_t seed = 42)
+{
+    std::vector<std::uint64_t> keys(KEY_COUNT);
+    std::mt19937_64            rng(seed);
+    for (auto& key : keys)
+        key = rng();
+    return keys;
+}
+
+// count random keys of len bytes each, stored back to back
+inline std::vector<std::uint8_t> random_bytes(std::uint64_t len, std::uint64_t count)
+{
+    std::vector<std::uint8_t> keys(len * count);
+    std::mt19937_64           rng(len);
+    for (auto& byte : keys)
+        byte = static_cast<std::uint8_t>(rng());
+    return keys;
+}
+
+template <typename index>
+static void BM_contains_loop(benchmark::State& state)
+{
+    const auto bf   = half_full_filter<index>(state.range(0));
+    const auto keys = random_keys();
+
+    std::uint64_t i = 0;
+    for (auto _ : state)
+    {
+        for (std::uint64_t j = 0; j < BATCH; ++j, ++i)
+            benchmark::DoNotOptimize(bf.contains(&keys[i % KEY_COUNT], sizeof(std::uint64_t)));
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+}
+
+template <typename index>
+static void BM_contains_many(benchmark::State& state)
+{
+    const auto bf   = half_full_filter<index>(state.range(0));
+    const auto keys = random_keys();
+
+    std::vector<const void*>   key_ptrs(KEY_COUNT);
+    std::vector<std::uint64_t> lens(KEY_COUNT, sizeof(std::uint64_t));
+    for (std::uint64_t i = 0; i < KEY_COUNT; ++i)
+        key_ptrs[i] = &keys[i];
+
+    std::uint8_t  bitmap[BATCH / 8];
+    std::uint64_t i = 0;
+    for (auto _ : state)
+    {
+        bf.contains_many(key_ptrs.data() + i, lens.data() + i, BATCH, bitmap);
+        benchmark::DoNotOptimize(bitmap);
+        i = (i + BATCH) % KEY_COUNT;
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+}
+
+template <typename index>
+static void BM_add_loop(benchmark::State& state)
+{
+    auto       bf   = half_full_filter<index>(state.range(0));
+    const auto keys = random_keys();
+
+    std::uint64_t i = 0;
+    for (auto _ : state)
+    {
+        for (std::uint64_t j = 0; j < BATCH; ++j, ++i)
+            bf.add(&keys[i % KEY_COUNT], sizeof(std::uint64_t));
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+}
+
+template <typename index>
+static void BM_add_many(benchmark::State& state)
+{
+    auto       bf   = half_full_filter<index>(state.range(0));
+    const auto keys = random_keys();
+
+    std::vector<const void*>   key_ptrs(KEY_COUNT);
+    std::vector<std::uint64_t> lens(KEY_COUNT, sizeof(std::uint64_t));
+    for (std::uint64_t i = 0; i < KEY_COUNT; ++i)
+        key_ptrs[i] = &keys[i];
+
+    std::uint64_t i = 0;
+    for (auto _ : state)
+    {
+        bf.add_many(key_ptrs.data() + i, lens.data() + i, BATCH);
+        i = (i + BATCH) % KEY_COUNT;
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+}
+
+static void BM_merge(benchmark::State& state)
+{
+    auto       bf    = half_full_filter<modulo_index>(state.range(0));
+    const auto shard = half_full_filter<modulo_index>(state.range(0));
+    for (auto _ : state)
+    {
+        bf.merge(shard);
+        benchmark::DoNotOptimize(bf.raw());
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_approx_size(benchmark::State& state)
+{
+    const auto bf = half_full_filter<modulo_index>(state.range(0));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(bf.approx_size());
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+// from() is what loading a serialized filter costs
+static void BM_from(benchmark::State& state)
+{
+    const auto src = half_full_filter(state.range(0));
+    for (auto _ : state)
+    {
+        bloom_filter<> bf;
+        bf.from(src.bit_count(), src.hash_count(), src.expected_elements(), src.false_positive(), src.raw(), src.size());
+        benchmark::DoNotOptimize(bf.raw());
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_merge)->Arg(256 << 10)->Arg(4 << 20)->Arg(64 << 20);
+BENCHMARK(BM_approx_size)->Arg(256 << 10)->Arg(4 << 20)->Arg(64 << 20);
+BENCHMARK(BM_from)->Arg(256 << 10)->Arg(4 << 20)->Arg(64 << 20)->Arg(1 << 30);
+
+// Keys from 8 bytes to 1 KB against a LLC resident filter: the larger keys
+// are dominated by hashing.
+static void BM_add_key_size(benchmark::State& state)
+{
+    const std::uint64_t len   = state.range(0);
+    const std::uint64_t count = 4096;
+    auto                bf    = half_full_filter(4 << 20);
+    const auto          keys  = random_bytes(len, count);
+
+    std::uint64_t i = 0;
+    for (auto _ : state)
+    {
+        for (std::uint64_t j = 0; j < BATCH; ++j, ++i)
+            bf.add(keys.data() + (i % count) * len, len);
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+    state.SetBytesProcessed(state.iterations() * BATCH * len);
+}
+
+static void BM_contains_key_size(benchmark::State& state)
+{
+    const std::uint64_t len   = state.range(0);
+    const std::uint64_t count = 4096;
+    const auto          bf    = half_full_filter(4 << 20);
+    const auto          keys  = random_bytes(len, count);
+
+    std::uint64_t i = 0;
+    for (auto _ : state)
+    {
+        for (std::uint64_t j = 0; j < BATCH; ++j, ++i)
+            benchmark::DoNotOptimize(bf.contains(keys.data() + (i % count) * len, len));
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+    state.SetBytesProcessed(state.iterations() * BATCH * len);
+}
+
+BENCHMARK(BM_add_key_size)->RangeMultiplier(2)->Range(8, 1024);
+BENCHMARK(BM_contains_key_size)->RangeMultiplier(2)->Range(8, 1024);
+
+// Args: filter size, percentage of the looked up keys that were added. Hits
+// always probe all k bits, misses stop at the first clear one.
+static void BM_contains_hit_ratio(benchmark::State& state)
+{
+    auto          bf   = half_full_filter(state.range(0));
+    const auto    keys = random_keys();
+    std::mt19937  rng(7);
+    std::uint64_t hits = 0;
+    for (const auto& key : keys)
+    {
+        if (rng() % 100 < static_cast<std::uint64_t>(state.range(1)))
+        {
+            bf.add(&key, sizeof(key));
+            ++hits;
+        }
+    }
+
+    std::uint64_t i = 0, found = 0;
+    for (auto _ : state)
+    {
+        for (std::uint64_t j = 0; j < BATCH; ++j, ++i)
+            found += bf.contains(&keys[i % KEY_COUNT], sizeof(std::uint64_t));
+    }
+    benchmark::DoNotOptimize(found);
+    state.SetItemsProcessed(state.iterations() * BATCH);
+    state.counters["hit_ratio"] = static_cast<double>(hits) / KEY_COUNT;
+}
+
+BENCHMARK(BM_contains_hit_ratio)->ArgsProduct({ { 4 << 20, 64 << 20 }, { 0, 50, 100 } });
+
+// Args: number of hashes, on a filter past the LLC where every probe of a
+// hit is a cache miss.
+static void BM_contains_hash_count(benchmark::State& state)
+{
+    auto       bf   = half_full_filter(64 << 20, state.range(0));
+    const auto keys = random_keys();
+    for (std::uint64_t i = 0; i < KEY_COUNT; i += 2)
+        bf.add(&keys[i], sizeof(keys[i])); // half hits
+
+    std::uint64_t i = 0;
+    for (auto _ : state)
+    {
+        for (std::uint64_t j = 0; j < BATCH; ++j, ++i)
+            benchmark::DoNotOptimize(bf.contains(&keys[i % KEY_COUNT], sizeof(std::uint64_t)));
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+}
+
+BENCHMARK(BM_contains_hash_count)->Arg(1)->Arg(2)->Arg(4)->Arg(7)->Arg(10)->Arg(16);
+
+// Latency percentiles of single lookups. Every sample includes the cost of
+// reading the clock twice(~20-40 ns), compare between runs rather than
+// reading them as absolute numbers. The allocator decides the page size of
+// the bits, see huge_page_allocator.
+template <typename allocator>
+static void BM_contains_latency(benchmark::State& state)
+{
+    using clock = std::chrono::steady_clock;
+
+    const auto          bf   = half_full_filter<modulo_index, allocator>(state.range(0));
+    const auto          keys = random_keys();
+    std::vector<double> samples(1 << 20);
+
+    std::uint64_t i = 0;
+    for (auto _ : state)
+    {
+        for (std::uint64_t j = 0; j < BATCH; ++j, ++i)
+        {
+            const auto start = clock::now();
+            benchmark::DoNotOptimize(bf.contains(&keys[i % KEY_COUNT], sizeof(std::uint64_t)));
+            samples[i % samples.size()] = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+
+    samples.resize(std::min<std::uint64_t>(i, samples.size()));
+    std::sort(samples.begin(), samples.end());
+    for (const auto& [name, quantile] : { std::make_pair("p50_ns", 0.5), std::make_pair("p99_ns", 0.99), std::make_pair("p999_ns", 0.999) })
+        state.counters[name] = samples.empty() ? 0.0 : samples[static_cast<std::uint64_t>(quantile * (samples.size() - 1))];
+}
+
+// 4 KB pages, transparent huge pages and explicit 2 MB and 1 GB pages, which
+// fall back to transparent ones when none are reserved
+BENCHMARK_TEMPLATE(BM_contains_latency, aligned_allocator<std::uint64_t, 64>) BF_FILTER_SIZES;
+BENCHMARK_TEMPLATE(BM_contains_latency, huge_page_allocator<std::uint64_t>) BF_FILTER_SIZES;
+BENCHMARK_TEMPLATE(BM_contains_latency, huge_page_allocator<std::uint64_t, huge_pages::explicit_2mb>) BF_FILTER_SIZES;
+BENCHMARK_TEMPLATE(BM_contains_latency, huge_page_allocator<std::uint64_t, huge_pages::explicit_1gb>)->Arg(1 << 30);
+
+// Measured vs configured false positive rate for n keys. The timed part is
+// the lookup of keys that were never added, the rates and the memory per
+// key are reported as counters.
+static void BM_false_positive(benchmark::State& state)
+{
+    constexpr std::uint64_t N   = 1000000;
+    const double            fpr = 1.0 / state.range(0);
+
+    bloom_filter<> bf;
+    bf.config(N, fpr);
+    for (std::uint64_t i = 0; i < N; ++i)
+        bf.add(&i, sizeof(i));
+
+    std::uint64_t false_positive = 0;
+    for (std::uint64_t i = N; i < 2 * N; ++i)
+        false_positive += bf.contains(&i, sizeof(i));
+
+    std::uint64_t i = N;
+    for (auto _ : state)
+    {
+        for (std::uint64_t j = 0; j < BATCH; ++j, ++i)
+            benchmark::DoNotOptimize(bf.contains(&i, sizeof(i)));
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+    state.counters["configured_fpr"] = bf.false_positive();
+    state.counters["measured_fpr"]   = static_cast<double>(false_positive) / N;
+    state.counters["bits_per_key"]   = static_cast<double>(bf.bit_count()) / N;
+    state.counters["filter_bytes"]   = bf.size();
+}
+
+BENCHMARK(BM_false_positive)->Arg(10)->Arg(100)->Arg(1000)->Arg(10000);
+
+static void BM_murmur3_loop(benchmark::State& state)
+{
+    const std::uint64_t       len = state.range(0);
+    std::vector<std::uint8_t> keys(len * BATCH, 0xAB);
+    std::vector<hash128>      out(BATCH);
+    murmur3                   h;
+    for (auto _ : state)
+    {
+        for (std::uint64_t i = 0; i < BATCH; ++i)
+            out[i] = h(keys.data() + i * len, len);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+}
+
+static void BM_murmur3_hash_many(benchmark::State& state)
+{
+    const std::uint64_t       len = state.range(0);
+    std::vector<std::uint8_t> keys(len * BATCH, 0xAB);
+    std::vector<hash128>      out(BATCH);
+    murmur3                   h;
+    for (auto _ : state)
+    {
+        h.hash_many(keys.data(), len, BATCH, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+}
+
+BENCHMARK(BM_murmur3_loop)->Arg(8)->Arg(16)->Arg(32);
+BENCHMARK(BM_murmur3_hash_many)->Arg(8)->Arg(16)->Arg(32);
+
+// The hashers against each other on short keys, one key at a time
+template <typename hasher>
+static void BM_hash(benchmark::State& state)
+{
+    const std::uint64_t  len  = state.range(0);
+    const auto           keys = random_bytes(len, BATCH);
+    std::vector<hash128> out(BATCH);
+    hasher               h;
+    for (auto _ : state)
+    {
+        for (std::uint64_t i = 0; i < BATCH; ++i)
+            out[i] = h(keys.data() + i * len, len);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+}
+
+template <typename hasher>
+static void BM_hash_u64(benchmark::State& state)
+{
+    const auto           keys = random_keys();
+    std::vector<hash128> out(BATCH);
+    hasher               h;
+    for (auto _ : state)
+    {
+        for (std::uint64_t i = 0; i < BATCH; ++i)
+            out[i] = h.hash_u64(keys[i]);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+}
+
+// add(key, len) against add(uint64_t) on a filter that fits in L2, so the
+// hashing is what is measured
+template <typename hasher, bool u64>
+static void BM_add_hasher(benchmark::State& state)
+{
+    bloom_filter<hasher> bf;
+    bf.config(state.range(0) * 8, HASH_COUNT, state.range(0));
+    const auto keys = random_keys();
+
+    std::uint64_t i = 0;
+    for (auto _ : state)
+    {
+        for (std::uint64_t j = 0; j < BATCH; ++j, ++i)
+        {
+            if constexpr (u64)
+                bf.add(keys[i % KEY_COUNT]);
+            else
+                bf.add(&keys[i % KEY_COUNT], sizeof(std::uint64_t));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+}
+
+#define BF_SHORT_KEYS ->Arg(4)->Arg(8)->Arg(16)->Arg(32)->Arg(64)
+
+BENCHMARK_TEMPLATE(BM_hash, murmur3) BF_SHORT_KEYS;
+BENCHMARK_TEMPLATE(BM_hash, xxh3) BF_SHORT_KEYS;
+BENCHMARK_TEMPLATE(BM_hash, wyhash) BF_SHORT_KEYS;
+BENCHMARK_TEMPLATE(BM_hash_u64, murmur3);
+BENCHMARK_TEMPLATE(BM_hash_u64, xxh3);
+BENCHMARK_TEMPLATE(BM_hash_u64, wyhash);
+BENCHMARK_TEMPLATE(BM_add_hasher, murmur3, false)->Arg(256 << 10);
+BENCHMARK_TEMPLATE(BM_add_hasher, murmur3, true)->Arg(256 << 10);
+BENCHMARK_TEMPLATE(BM_add_hasher, xxh3, false)->Arg(256 << 10);
+BENCHMARK_TEMPLATE(BM_add_hasher, xxh3, true)->Arg(256 << 10);
+BENCHMARK_TEMPLATE(BM_add_hasher, wyhash, false)->Arg(256 << 10);
+BENCHMARK_TEMPLATE(BM_add_hasher, wyhash, true)->Arg(256 << 10);
+
+static void BM_mutex_add_contains(benchmark::State& state)
+{
+    static bloom_filter<> bf;
+    static std::mutex     lock;
+    if (state.thread_index() == 0)
+        bf.config(state.range(0), 0.01);
+
+    std::uint64_t i = state.thread_index() * state.range(0);
+    for (auto _ : state)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        bf.add(&i, sizeof(i));
+        benchmark::DoNotOptimize(bf.contains(&i, sizeof(i)));
+        ++i;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_concurrent_add_contains(benchmark::State& state)
+{
+    static concurrent_bloom_filter<> bf;
+    if (state.thread_index() == 0)
+        bf.config(state.range(0), 0.01);
+
+    std::uint64_t i = state.thread_index() * state.range(0);
+    for (auto _ : state)
+    {
+        bf.add(&i, sizeof(i));
+        benchmark::DoNotOptimize(bf.contains(&i, sizeof(i)));
+        ++i;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// One filter shared by 1 to N threads. It is sized for 50M keys(~57 MB) so
+// that the threads do not just fight over a few cache lines.
+#define BF_SCALING ->Arg(50000000)->ThreadRange(1, std::thread::hardware_concurrency())->UseRealTime()
+
+BENCHMARK(BM_mutex_add_contains) BF_SCALING;
+BENCHMARK(BM_concurrent_add_contains) BF_SCALING;
+
+// binary_fuse_filter vs split_block_bloom_filter vs bloom_filter at the same
+// false positive rate(1/256 and 1/65536) for 1M and 10M keys. The timed part is the lookup of keys that
+// are half in the set, bits per key and the measured rate are counters.
+template <typename filter>
+static void report_static_set(benchmark::State& state, const filter& bf, std::uint64_t count, double bits)
+{
+    std::uint64_t false_positive = 0;
+    for (std::uint64_t i = count; i < count + 1000000; ++i)
+        false_positive += bf.contains(i);
+
+    std::uint64_t i = 0;
+    for (auto _ : state)
+    {
+        for (std::uint64_t j = 0; j < BATCH; ++j, ++i)
+            benchmark::DoNotOptimize(bf.contains((i * 0x9e3779b97f4a7c15ULL) % (2 * count)));
+    }
+    state.SetItemsProcessed(state.iterations() * BATCH);
+    state.counters["measured_fpr"] = false_positive / 1000000.0;
+    state.counters["bits_per_key"] = bits;
+}
+
+template <unsigned fingerprint_bits>
+static void BM_static_set_fuse(benchmark::State& state)
+{
+    std::vector<std::uint64_t> keys(state.range(0));
+    for (std::uint64_t i = 0; i < keys.size(); ++i)
+        keys[i] = i;
+
+    binary_fuse_filter<murmur3, fingerprint_bits> bf;
+    bf.build(keys);
+    report_static_set(state, bf, keys.size(), bf.bits_per_key());
+}
+
+template <unsigned fingerprint_bits>
+static void BM_static_set_bloom(benchmark::State& state)
+{
+    const std::uint64_t count = state.range(0);
+    bloom_filter<>      bf;
+    bf.config(count, 1.0 / (1 << fingerprint_bits));
+    for (std::uint64_t i = 0; i < count; ++i)
+        bf.add(i);
+    report_static_set(state, bf, count, static_cast<double>(bf.bit_count()) / count);
+}
+
+template <unsigned fingerprint_bits>
+static void BM_static_set_split_block(benchmark::State& state)
+{
+    const std::uint64_t      count = state.range(0);
+    split_block_bloom_filter bf;
+    bf.config(count, 1.0 / (1 << fingerprint_bits));
+    for (std::uint64_t i = 0; i < count; ++i)
+        bf.add(i);
+    report_static_set(state, bf, count, static_cast<double>(bf.bit_count()) / count);
+}
+
+BENCHMARK_TEMPLATE(BM_static_set_fuse, 8)->Arg(1000000)->Arg(10000000);
+BENCHMARK_TEMPLATE(BM_static_set_split_block, 8)->Arg(1000000)->Arg(10000000);
+BENCHMARK_TEMPLATE(BM_static_set_bloom, 8)->Arg(1000000)->Arg(10000000);
+BENCHMARK_TEMPLATE(BM_static_set_fuse, 16)->Arg(1000000)->Arg(10000000);
+BENCHMARK_TEMPLATE(BM_static_set_split_block, 16)->Arg(1000000)->Arg(10000000);
+BENCHMARK_TEMPLATE(BM_static_set_bloom, 16)->Arg(1000000)->Arg(10000000);
+
+// Bulk build of 10M keys into one bloom_filter vs a partitioned_bloom_filter
+// of 64 shards built by 1 to N threads.
+static void BM_build_single(benchmark::State& state)
+{
+    const std::uint64_t count = state.range(0);
+    for (auto _ : state)
+    {
+        bloom_filter<> bf;
+        bf.config(count, 0.01);
+        for (std::uint64_t i = 0; i < count; ++i)
+            bf.add(i);
+        benchmark::DoNotOptimize(bf.raw());
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+
+static void BM_build_partitioned(benchmark::State& state)
+{
+    std::vector<std::uint64_t> keys(state.range(0));
+    for (std::uint64_t i = 0; i < keys.size(); ++i)
+        keys[i] = i;
+
+    const unsigned threads = state.range(1);
+    for (auto _ : state)
+    {
+        partitioned_bloom_filter<> bf;
+        bf.config(keys.size(), 0.01, 64, threads);
+        bf.build(keys, threads);
+        benchmark::DoNotOptimize(bf.shard(0).raw());
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+BENCHMARK(BM_build_single)->Arg(10000000)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_build_partitioned)->ArgsProduct({ { 10000000 }, benchmark::CreateRange(1, std::thread::hardware_concurrency(), 2) })->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// compress()/decompress() and compressed_bloom_filter against bloom_filter on
+// a filter sized for 1M keys that holds Arg per mille of them, e.g. one sized
+// for a peak seen off-peak. compression_ratio is raw() over the compressed
+// form, lookups are half hits.
+static bloom_filter<> partly_filled_filter(std::uint64_t per_mille)
+{
+    bloom_filter<> bf;
+    bf.config(1000000, 0.01);
+    for (std::uint64_t i = 0; i < per_mille * 1000; ++i)
+        bf.add(i);
+    return bf;
+}
+
+static void BM_compress(benchmark::State& state)
+{
+    const auto bf    = partly_filled_filter(state.range(0));
+    double     ratio = 0.0;
+    for (auto _ : state)
+    {
+        const std::vector<std::uint8_t> form = compress(bf);
+        ratio                                = static_cast<double>(bf.size()) / form.size();
+        benchmark::DoNotOptimize(form.data());
+    }
+    state.SetBytesProcessed(state.iterations() * bf.size());
+    state.counters["compression_ratio"] = ratio;
+    state.counters["fill_ratio"]        = bf.fill_ratio();
+}
+
+static void BM_decompress(benchmark::State& state)
+{
+    const auto                      bf   = partly_filled_filter(state.range(0));
+    const std::vector<std::uint8_t> form = compress(bf);
+    for (auto _ : state)
+    {
+        bloom_filter<> copy;
+        decompress(copy, form.data(), form.size());
+        benchmark::DoNotOptimize(copy.raw());
+    }
+    state.SetBytesProcessed(state.iterations() * bf.size());
+}
+
+template <typename filter>
+static void lookup_half_hits(benchmark::State& state, const filter& bf, std::uint64_t count)
+{
+    std::uint64_t i = 0, found = 0;
+    for (auto _ : state)
+    {
+        for (std::uint64_t j = 0; j < BATCH; ++j, ++i)
+            found += bf.contains((i * 0x9e3779b97f4a7c15ULL) % (2 * count));
+    }
+    benchmark::DoNotOptimize(found);
+    state.SetItemsProcessed(state.iterations() * BATCH);
+}
+
+static void BM_compressed_contains(benchmark::State& state)
+{
+    const auto                      bf   = partly_filled_filter(state.range(0));
+    const std::vector<std::uint8_t> form = compress(bf);
+    compressed_bloom_filter<>       compressed;
+    compressed.from(form.data(), form.size());
+    lookup_half_hits(state, compressed, state.range(0) * 1000);
+    state.counters["compression_ratio"] = compressed.compression_ratio();
+}
+
+static void BM_uncompressed_contains(benchmark::State& state)
+{
+    const auto bf = partly_filled_filter(state.range(0));
+    lookup_half_hits(state, bf, state.range(0) * 1000);
+}
+
+#define BF_FILL_LEVELS ->Arg(10)->Arg(50)->Arg(100)->Arg(250)
+
+BENCHMARK(BM_compress) BF_FILL_LEVELS;
+BENCHMARK(BM_decompress) BF_FILL_LEVELS;
+BENCHMARK(BM_compressed_contains) BF_FILL_LEVELS;
+BENCHMARK(BM_uncompressed_contains) BF_FILL_LEVELS;
+
+// "which of Arg filters contain the key": bit_sliced_index against asking
+// every filter in turn. The filters are sized for 10000 keys and hold 1000
+// of their own, matches is the average number of filters a key is found in.
+static std::vector<bloom_filter<>> segment_filters(std::uint64_t count)
+{
+    std::vector<bloom_filter<>> filters(count);
+    for (std::uint64_t f = 0; f < count; ++f)
+    {
+        filters[f].config(10000, 0.01);
+        for (std::uint64_t i = 0; i < 1000; ++i)
+            filters[f].add(f * 1000 + i);
+    }
+    return filters;
+}
+
+static void BM_fan_out_filters(benchmark::State& state)
+{
+    const auto    filters = segment_filters(state.range(0));
+    std::uint64_t i = 0, found = 0;
+    for (auto _ : state)
+    {
+        const std::uint64_t key = (i++ * 0x9e3779b97f4a7c15ULL) % (filters.size() * 1000);
+        for (const auto& bf : filters)
+            found += bf.contains(key);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["matches"] = static_cast<double>(found) / state.iterations();
+}
+
+static void BM_fan_out_index(benchmark::State& state)
+{
+    const auto         filters = segment_filters(state.range(0));
+    bit_sliced_index<> index;
+    for (const auto& bf : filters)
+        index.append(bf);
+
+    std::vector<std::uint64_t> bitmap(index.bitmap_words());
+    std::uint64_t              i = 0, found = 0;
+    for (auto _ : state)
+    {
+        const std::uint64_t key = (i++ * 0x9e3779b97f4a7c15ULL) % (filters.size() * 1000);
+        index.contains(key, bitmap.data());
+        for (const std::uint64_t word : bitmap)
+            found += std::popcount(word);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["matches"] = static_cast<double>(found) / state.iterations();
+}
+
+BENCHMARK(BM_fan_out_filters)->Arg(64)->Arg(1024)->Arg(8192);
+BENCHMARK(BM_fan_out_index)->Arg(64)->Arg(1024)->Arg(8192);
+
+// the sizes are powers of two, so all index policies use the same m
+#define BF_INDEX_POLICIES(bm)                                \
+    BENCHMARK_TEMPLATE(bm, modulo_index) BF_FILTER_SIZES;    \
+    BENCHMARK_TEMPLATE(bm, pow2_index) BF_FILTER_SIZES;      \
+    BENCHMARK_TEMPLATE(bm, fastrange_index) BF_FILTER_SIZES;
+
+BF_INDEX_POLICIES(BM_contains_loop)
+BF_INDEX_POLICIES(BM_contains_many)
+BF_INDEX_POLICIES(BM_add_loop)
+BF_INDEX_POLICIES(BM_add_many)
+
+} // BF
+
+BENCHMARK_MAIN();
@@ -1,4 +1,7 @@
 #include "bloom_filter.hpp"
+#include "huge_page_allocator.hpp"
+#include <array>
+#include <bit>
 #include <cstdlib>
 #include <cstring>
 #include <gtest/gtest.h>
@@ -195,6 +198,124 @@ TEST(bf_test, hasher_sanity_check)
     }
 }
 
+TEST(bf_test, probe_sequence)
+{
+    BF::murmur3       hasher;
+    const std::string input_text("Lorem ipsum dolor sit amet");
+    for (std::uint64_t k = 1; k < 64; ++k)
+    {
+        BF::hashes out;
+        hasher(input_text.data(), input_text.size(), k, out);
+        ASSERT_EQ(out.size(), k);
+
+        // the allocation free path has to produce exactly the same probes
+        BF::probe_sequence probes(hasher(input_text.data(), input_text.size()));
+        for (std::uint64_t i = 0; i < k; ++i)
+            EXPECT_EQ(probes.next(), out[i]);
+    }
+
+    const BF::hash128 seeded = hasher(input_text.data(), input_text.size(), 0x12345678);
+    BF::hashes        out;
+    hasher(input_text.data(), input_text.size(), 2, out, 0x12345678);
+    EXPECT_EQ(seeded.h1, out[0]);
+    EXPECT_EQ(seeded.h2, out[1]);
+}
+
+TEST(bf_test, legacy_hasher)
+{
+    // hashers written against the hashes& signature keep working
+    class legacy_murmur3
+    {
+    public:
+        void operator()(const void* key, const std::uint64_t len, std::uint64_t k, hashes& out) const
+        {
+            BF::murmur3()(key, len, k, out);
+        }
+    };
+
+    BF::bloom_filter                 bf;
+    BF::bloom_filter<legacy_murmur3> legacy;
+    ASSERT_TRUE(bf.config(1000, 0.01));
+    ASSERT_TRUE(legacy.config(1000, 0.01));
+    for (std::uint64_t i = 0; i < 1000; ++i)
+    {
+        ASSERT_TRUE(bf.add(&i, sizeof(i)));
+        ASSERT_TRUE(legacy.add(&i, sizeof(i)));
+        EXPECT_TRUE(legacy.contains(&i, sizeof(i)));
+    }
+    ASSERT_EQ(bf.size(), legacy.size());
+    EXPECT_EQ(std::memcmp(bf.raw(), legacy.raw(), bf.size()), 0);
+
+    // a hasher that returns the wrong number of hashes is rejected
+    class broken_hash
+    {
+    public:
+        void operator()(const void*, const std::uint64_t, std::uint64_t, hashes& out) const
+        {
+            out.push_back(1);
+        }
+    };
+    BF::bloom_filter<broken_hash> broken;
+    ASSERT_TRUE(broken.config(1000, 0.01));
+    std::uint64_t key = 1;
+    EXPECT_FALSE(broken.add(&key, sizeof(key)));
+    EXPECT_FALSE(broken.contains(&key, sizeof(key)));
+}
+
+TEST(bf_test, hash_many)
+{
+    BF::murmur3               hasher;
+    std::vector<std::uint8_t> keys(37 * 64);
+    for (std::uint64_t i = 0; i < keys.size(); ++i)
+        keys[i] = static_cast<std::uint8_t>(i * 131 + 7);
+
+    std::vector<BF::simd::level> levels = { BF::simd::level::scalar };
+    if (BF::simd::detect() != BF::simd::level::scalar)
+        levels.push_back(BF::simd::level::avx2);
+    if (BF::simd::detect() == BF::simd::level::avx512)
+        levels.push_back(BF::simd::level::avx512);
+
+    // the vector kernels only kick in for multiples of 8, the others check the fallback
+    for (const std::uint64_t len : { 8, 16, 24, 32, 64, 5, 13 })
+    {
+        for (const auto level : levels)
+        {
+            for (const std::uint32_t seed : { 0xbeefeebbu, 0x12345678u })
+            {
+                const std::uint64_t  count = keys.size() / len < 37 ? keys.size() / len : 37;
+                std::vector<hash128> out(count);
+                hasher.hash_many(keys.data(), len, count, out.data(), seed, level);
+                for (std::uint64_t i = 0; i < count; ++i)
+                {
+                    const hash128 expected = hasher(keys.data() + i * len, len, seed);
+                    EXPECT_EQ(out[i].h1, expected.h1) << "len " << len << " key " << i;
+                    EXPECT_EQ(out[i].h2, expected.h2) << "len " << len << " key " << i;
+                }
+            }
+        }
+    }
+
+    // fixed width batches go through hash_many and must agree with the single key path
+    BF::bloom_filter bf, single;
+    ASSERT_TRUE(bf.config(1000, 0.01));
+    ASSERT_TRUE(single.config(1000, 0.01));
+    std::vector<std::uint64_t> ids(1000);
+    for (std::uint64_t i = 0; i < ids.size(); ++i)
+    {
+        ids[i] = i * 0x9E3779B97F4A7C15LLU;
+        ASSERT_TRUE(single.add(&ids[i], sizeof(ids[i])));
+    }
+    ASSERT_TRUE(bf.add_many(ids.data(), sizeof(std::uint64_t), ids.size() / 2));
+    ASSERT_TRUE(bf.add_many(ids.data() + ids.size() / 2, sizeof(std::uint64_t), ids.size() / 2));
+    EXPECT_EQ(std::memcmp(bf.raw(), single.raw(), bf.size()), 0);
+
+    std::uint8_t bitmap[1000 / 8];
+    ASSERT_TRUE(bf.contains_many(ids.data(), sizeof(std::uint64_t), ids.size(), bitmap));
+    for (std::uint64_t i = 0; i < sizeof(bitmap); ++i)
+        EXPECT_EQ(bitmap[i], 0xFF);
+    EXPECT_FALSE(bf.contains_many(nullptr, sizeof(std::uint64_t), ids.size(), bitmap));
+}
+
 TEST(bf_test, add)
 {
 
@@ -280,6 +401,165 @@ TEST(bf_test, contains)
     }
 }
 
+template <typename index>
+void check_index_policy(std::uint64_t element_count, double fpr)
+{
+    BF::bloom_filter<BF::murmur3, index> bf;
+    ASSERT_TRUE(bf.config(element_count, fpr));
+    EXPECT_EQ(index::round_m(bf.bit_count()), bf.bit_count());
+    EXPECT_LE(bf.false_positive(), fpr);
+
+    for (std::uint64_t i = 0; i < element_count; ++i)
+        ASSERT_TRUE(bf.add(&i, sizeof(i)));
+    for (std::uint64_t i = 0; i < element_count; ++i)
+        ASSERT_TRUE(bf.contains(&i, sizeof(i)));
+
+    std::uint64_t false_positive = 0;
+    for (std::uint64_t i = element_count; i < 2 * element_count; ++i)
+        false_positive += bf.contains(&i, sizeof(i));
+    // the reported rate is the one of the real m
+    EXPECT_TRUE(is_close_enough(static_cast<double>(false_positive) / element_count, bf.false_positive(), bf.false_positive() * 0.1));
+}
+
+TEST(bf_test, typed_keys)
+{
+    static_assert(trivial_key<int> && trivial_key<double> && trivial_key<std::array<std::uint32_t, 3>>);
+    static_assert(!trivial_key<const char*> && !trivial_key<std::string_view> && !trivial_key<std::string>);
+
+    BF::bloom_filter bf;
+    ASSERT_TRUE(bf.config(4000, 0.01));
+
+    // typed keys are their bytes
+    for (std::uint32_t i = 0; i < 1000; ++i)
+        ASSERT_TRUE(bf.add(i));
+    for (std::uint32_t i = 0; i < 1000; ++i)
+    {
+        EXPECT_TRUE(bf.contains(i));
+        EXPECT_TRUE(bf.contains(&i, sizeof(i)));
+    }
+
+    const std::array<std::uint64_t, 3> id = { 1, 2, 3 };
+    ASSERT_TRUE(bf.add(id));
+    EXPECT_TRUE(bf.contains(id.data(), sizeof(id)));
+
+    // strings by their characters, not by their address
+    const std::string name = "bloom";
+    ASSERT_TRUE(bf.add("bloom"));
+    EXPECT_TRUE(bf.contains(name));
+    EXPECT_TRUE(bf.contains(std::string_view(name)));
+    EXPECT_TRUE(bf.contains(name.data(), name.size()));
+
+    const std::byte bytes[] = { std::byte(0xde), std::byte(0xad), std::byte(0xbe), std::byte(0xef), std::byte(0x01) };
+    ASSERT_TRUE(bf.add(std::span<const std::byte>(bytes)));
+    EXPECT_TRUE(bf.contains(bytes, sizeof(bytes)));
+
+    std::uint64_t false_positive = 0;
+    for (std::uint32_t i = 1000; i < 101000; ++i)
+        false_positive += bf.contains(i);
+    EXPECT_LE(false_positive / 100000.0, 0.015);
+}
+
+TEST(bf_test, index_policies)
+{
+    {
+        BF::bloom_filter<BF::murmur3, BF::pow2_index> bf;
+        EXPECT_TRUE(bf.config(1000, 3, 10));
+        EXPECT_EQ(bf.bit_count(), 1024);
+        EXPECT_EQ(bf.size(), 128);
+        EXPECT_TRUE(is_close_enough(bf.false_positive(), BF::compute_p(1024, 3, 10), 1e-12));
+
+        // 9586 bits for 1000 keys at 1%
+        EXPECT_TRUE(bf.config(1000, 0.01));
+        EXPECT_EQ(bf.bit_count(), 16384);
+        EXPECT_EQ(bf.hash_count(), BF::compute_k(16384, 1000));
+        EXPECT_LT(bf.false_positive(), 0.01);
+
+        std::vector<std::uint8_t> raw(125, 0);
+        EXPECT_FALSE(bf.from(1000, 3, 10, 0.1, raw.data(), raw.size()));
+        raw.resize(128);
+        EXPECT_TRUE(bf.from(1024, 3, 10, 0.1, raw.data(), raw.size()));
+
+        EXPECT_EQ(BF::pow2_index::round_m(1), 1);
+        EXPECT_EQ(BF::pow2_index::round_m(std::uint64_t(1) << 63), std::uint64_t(1) << 63);
+        EXPECT_EQ(BF::pow2_index::round_m((std::uint64_t(1) << 63) + 1), 0);
+    }
+
+    {
+        BF::bloom_filter<BF::murmur3, BF::fastrange_index> bf;
+        EXPECT_TRUE(bf.config(1000, 0.01));
+        EXPECT_EQ(bf.bit_count(), BF::compute_m(1000, 0.01));
+        EXPECT_EQ(bf.false_positive(), 0.01);
+
+        const BF::fastrange_index index;
+        EXPECT_EQ(index(0, 1000), 0);
+        EXPECT_EQ(index(~std::uint64_t(0), 1000), 999);
+        EXPECT_EQ(index(std::uint64_t(1) << 63, 1000), 500);
+    }
+
+    check_index_policy<BF::modulo_index>(200000, 0.01);
+    check_index_policy<BF::pow2_index>(200000, 0.01);
+    check_index_policy<BF::fastrange_index>(200000, 0.01);
+}
+
+TEST(bf_test, batch)
+{
+    constexpr std::uint64_t ELEMENT_COUNT = 1000;
+    std::vector<std::string> storage;
+    for (std::uint64_t i = 0; i < 2 * ELEMENT_COUNT + 13; ++i)
+        storage.push_back("key number " + std::to_string(i));
+
+    std::vector<const void*>   keys;
+    std::vector<std::uint64_t> lens;
+    for (const auto& key : storage)
+    {
+        keys.push_back(key.data());
+        lens.push_back(key.size());
+    }
+
+    BF::bloom_filter bf, single;
+    ASSERT_TRUE(bf.config(ELEMENT_COUNT, 0.01));
+    ASSERT_TRUE(single.config(ELEMENT_COUNT, 0.01));
+
+    std::uint8_t bitmap[(2 * ELEMENT_COUNT + 13) / 8 + 1];
+    EXPECT_FALSE(bf.contains_many(keys.data(), lens.data(), keys.size(), nullptr));
+    EXPECT_FALSE(BF::bloom_filter<>().contains_many(keys.data(), lens.data(), keys.size(), bitmap));
+    EXPECT_FALSE(BF::bloom_filter<>().add_many(keys.data(), lens.data(), keys.size()));
+
+    ASSERT_TRUE(bf.add_many(keys.data(), lens.data(), ELEMENT_COUNT));
+    for (std::uint64_t i = 0; i < ELEMENT_COUNT; ++i)
+        ASSERT_TRUE(single.add(keys[i], lens[i]));
+    EXPECT_EQ(std::memcmp(bf.raw(), single.raw(), bf.size()), 0);
+
+    ASSERT_TRUE(bf.contains_many(keys.data(), lens.data(), keys.size(), bitmap));
+    for (std::uint64_t i = 0; i < keys.size(); ++i)
+    {
+        const bool in_bitmap = bitmap[i / 8] & (1u << (i & 7));
+        EXPECT_EQ(in_bitmap, bf.contains(keys[i], lens[i]));
+        if (i < ELEMENT_COUNT)
+        {
+            EXPECT_TRUE(in_bitmap);
+        }
+    }
+
+    // hashers with the hashes& signature take the one key at a time path
+    class legacy_murmur3
+    {
+    public:
+        void operator()(const void* key, const std::uint64_t len, std::uint64_t k, hashes& out) const
+        {
+            BF::murmur3()(key, len, k, out);
+        }
+    };
+    BF::bloom_filter<legacy_murmur3> legacy;
+    ASSERT_TRUE(legacy.config(ELEMENT_COUNT, 0.01));
+    ASSERT_TRUE(legacy.add_many(keys.data(), lens.data(), ELEMENT_COUNT));
+    EXPECT_EQ(std::memcmp(bf.raw(), legacy.raw(), bf.size()), 0);
+
+    std::uint8_t legacy_bitmap[sizeof(bitmap)];
+    ASSERT_TRUE(legacy.contains_many(keys.data(), lens.data(), keys.size(), legacy_bitmap));
+    EXPECT_EQ(std::memcmp(bitmap, legacy_bitmap, sizeof(bitmap)), 0);
+}
+
 TEST(bf_test, merge)
 {
     constexpr std::uint64_t byte_count = 1234;
@@ -323,6 +603,199 @@ TEST(bf_test, merge)
     const auto bf_raw = bf.raw();
     for (std::uint64_t i = 0; i < byte_count; ++i)
         EXPECT_EQ(bf_raw[i], 0xAA | 0x55);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(bf.raw()) % 64, 0);
+
+    EXPECT_TRUE(bf.intersect(other));
+    for (std::uint64_t i = 0; i < byte_count; ++i)
+        EXPECT_EQ(bf_raw[i], 0x55);
+
+    BF::bloom_filter mismatch;
+    EXPECT_TRUE(mismatch.config(m, k + 1, n));
+    EXPECT_FALSE(bf.merge(mismatch));
+    EXPECT_FALSE(bf.intersect(mismatch));
+}
+
+TEST(bf_test, word_kernels)
+{
+    std::vector<BF::simd::level> levels = { BF::simd::level::scalar };
+    if (BF::simd::detect() != BF::simd::level::scalar)
+        levels.push_back(BF::simd::level::avx2);
+    if (BF::simd::detect() == BF::simd::level::avx512)
+        levels.push_back(BF::simd::level::avx512);
+
+    // odd lengths leave a tail for the scalar loops
+    for (const std::uint64_t count : { 0, 1, 3, 4, 7, 8, 13, 64, 101 })
+    {
+        std::vector<std::uint64_t> a(count), b(count);
+        std::uint64_t              expected_popcount = 0;
+        for (std::uint64_t i = 0; i < count; ++i)
+        {
+            a[i] = i * 0x9E3779B97F4A7C15LLU;
+            b[i] = ~i * 0xC2B2AE3D27D4EB4FLLU;
+            expected_popcount += std::popcount(a[i]);
+        }
+
+        for (const auto level : levels)
+        {
+            EXPECT_EQ(BF::simd::popcount_words(a.data(), count, level), expected_popcount) << count;
+
+            std::vector<std::uint64_t> ored = a, anded = a;
+            BF::simd::or_words(ored.data(), b.data(), count, level);
+            BF::simd::and_words(anded.data(), b.data(), count, level);
+            for (std::uint64_t i = 0; i < count; ++i)
+            {
+                EXPECT_EQ(ored[i], a[i] | b[i]);
+                EXPECT_EQ(anded[i], a[i] & b[i]);
+            }
+        }
+    }
+}
+
+TEST(bf_test, approx_size)
+{
+    {
+        BF::bloom_filter bf;
+        EXPECT_EQ(bf.popcount(), 0);
+        EXPECT_EQ(bf.fill_ratio(), 0.0);
+        EXPECT_EQ(bf.approx_size(), 0);
+    }
+
+    {
+        // set bits past m are not counted
+        std::uint8_t raw[2] = { 0xFF, 0xFF };
+        BF::bloom_filter bf;
+        ASSERT_TRUE(bf.from(12, 3, 1, 0.5, raw, sizeof(raw)));
+        EXPECT_EQ(bf.popcount(), 12);
+        EXPECT_EQ(bf.fill_ratio(), 1.0);
+        EXPECT_EQ(bf.approx_size(), std::numeric_limits<std::uint64_t>::max());
+    }
+
+    BF::bloom_filter bf;
+    ASSERT_TRUE(bf.config(100000, 0.01));
+    for (const std::uint64_t added : { 1000, 10000, 50000, 100000 })
+    {
+        for (std::uint64_t i = 0; i < added; ++i)
+            ASSERT_TRUE(bf.add(&i, sizeof(i)));
+        EXPECT_NEAR(static_cast<double>(bf.approx_size()), added, added * 0.03);
+    }
+    // the expected fill of a filter at capacity
+    EXPECT_NEAR(bf.fill_ratio(), 1.0 - std::exp(-static_cast<double>(bf.hash_count()) * 100000 / bf.bit_count()), 0.005);
+
+    // duplicates do not count
+    for (std::uint64_t i = 0; i < 100000; ++i)
+        ASSERT_TRUE(bf.add(&i, sizeof(i)));
+    EXPECT_NEAR(static_cast<double>(bf.approx_size()), 100000, 3000);
+}
+
+TEST(bf_test, allocators)
+{
+    // small filters come from operator new, large ones are mapped on huge page
+    // boundaries, with a fallback when there are no explicit huge pages.
+    // std::allocator promises no more than the alignment of the words.
+    auto check = []<typename allocator>(allocator, std::uintptr_t small_alignment, std::uintptr_t large_alignment) {
+        for (const std::uint64_t n : { 1000, 2000000 })
+        {
+            BF::bloom_filter<BF::murmur3, BF::modulo_index, BF::no_stats, allocator> bf;
+            ASSERT_TRUE(bf.config(n, 0.01));
+            EXPECT_EQ(reinterpret_cast<std::uintptr_t>(bf.raw()) % (bf.size() < (2 << 20) ? small_alignment : large_alignment), 0);
+            for (std::uint64_t i = 0; i < n; i += 97)
+                ASSERT_TRUE(bf.add(i));
+
+            auto copy = bf;
+            EXPECT_EQ(std::memcmp(copy.raw(), bf.raw(), bf.size()), 0);
+            const auto moved = std::move(copy);
+            for (std::uint64_t i = 0; i < n; i += 97)
+                EXPECT_TRUE(moved.contains(i));
+
+            BF::bloom_filter plain;
+            ASSERT_TRUE(plain.from(bf.bit_count(), bf.hash_count(), bf.expected_elements(), bf.false_positive(), bf.raw(), bf.size()));
+            EXPECT_TRUE(plain.contains(std::uint64_t(97)));
+        }
+    };
+    check(BF::aligned_allocator<std::uint64_t, 64>(), 64, 64);
+    check(BF::huge_page_allocator<std::uint64_t>(), 64, 2 << 20);
+    check(BF::huge_page_allocator<std::uint64_t, BF::huge_pages::explicit_2mb>(), 64, 2 << 20);
+    check(BF::huge_page_allocator<std::uint8_t, BF::huge_pages::explicit_1gb>(), 64, 2 << 20); // rebound to words
+    check(std::allocator<std::uint64_t>(), alignof(std::uint64_t), alignof(std::uint64_t));
+}
+
+TEST(bf_test, stats)
+{
+    // no_stats takes no space in the filter
+    static_assert(std::is_empty_v<BF::no_stats>);
+
+    {
+        BF::bloom_filter<BF::murmur3, BF::modulo_index, BF::counting_stats> bf;
+        const BF::filter_stats empty = bf.stats();
+        EXPECT_EQ(empty.inserts, 0);
+        EXPECT_EQ(empty.set_bits, 0);
+        EXPECT_EQ(empty.estimated_false_positive, 0.0);
+    }
+
+    BF::bloom_filter<BF::murmur3, BF::modulo_index, BF::counting_stats> bf;
+    ASSERT_TRUE(bf.config(10000, 0.01));
+    for (std::uint64_t i = 0; i < 5000; ++i)
+        ASSERT_TRUE(bf.add(i));
+    for (std::uint64_t i = 0; i < 1000; ++i)
+        ASSERT_TRUE(bf.add(&i, sizeof(i))); // duplicates are inserts, not elements
+
+    std::uint64_t positives = 0;
+    for (std::uint64_t i = 0; i < 20000; ++i)
+        positives += bf.contains(i);
+
+    BF::filter_stats stats = bf.stats();
+    EXPECT_EQ(stats.inserts, 6000);
+    EXPECT_EQ(stats.queries, 20000);
+    EXPECT_EQ(stats.positives, positives);
+    EXPECT_EQ(stats.positive_rate, positives / 20000.0);
+    EXPECT_EQ(stats.set_bits, bf.popcount());
+    EXPECT_EQ(stats.fill_ratio, bf.fill_ratio());
+    EXPECT_EQ(stats.estimated_elements, bf.approx_size());
+    EXPECT_NEAR(static_cast<double>(stats.estimated_elements), 5000, 150);
+    // half full, far below the configured rate
+    EXPECT_LT(stats.estimated_false_positive, bf.false_positive() / 4);
+    EXPECT_NEAR(stats.estimated_false_positive, (positives - 5000) / 15000.0, 0.001);
+
+    // batches count per key, the popcount is redone after a write
+    std::vector<std::uint64_t> more(10000);
+    for (std::uint64_t i = 0; i < more.size(); ++i)
+        more[i] = 5000 + i;
+    ASSERT_TRUE(bf.add_many(more.data(), sizeof(std::uint64_t), more.size()));
+    std::vector<std::uint8_t> bitmap(more.size() / 8);
+    ASSERT_TRUE(bf.contains_many(more.data(), sizeof(std::uint64_t), more.size(), bitmap.data()));
+    stats = bf.stats();
+    EXPECT_EQ(stats.inserts, 16000);
+    EXPECT_EQ(stats.queries, 30000);
+    EXPECT_EQ(stats.positives, positives + 10000);
+    EXPECT_EQ(stats.set_bits, bf.popcount());
+    // overfilled: the estimate follows the bits, not the configured p
+    EXPECT_GT(stats.estimated_false_positive, bf.false_positive());
+
+    BF::bloom_filter<BF::murmur3, BF::modulo_index, BF::counting_stats> other;
+    ASSERT_TRUE(other.config(10000, 0.01));
+    for (std::uint64_t i = 100000; i < 101000; ++i)
+        ASSERT_TRUE(other.add_hash(BF::murmur3 {}.hash_u64(i)));
+    ASSERT_TRUE(bf.merge(other));
+    EXPECT_EQ(bf.stats().set_bits, bf.popcount());
+
+    // moving takes the counters along, config and from start over
+    BF::bloom_filter<BF::murmur3, BF::modulo_index, BF::counting_stats> moved(std::move(bf));
+    EXPECT_EQ(moved.stats().inserts, 16000);
+    EXPECT_EQ(bf.stats().inserts, 0);
+    ASSERT_TRUE(moved.config(100, 0.01));
+    EXPECT_EQ(moved.stats().queries, 0);
+    EXPECT_EQ(moved.stats().set_bits, 0);
+
+    // without a policy only the counters are missing
+    BF::bloom_filter plain;
+    ASSERT_TRUE(plain.config(10000, 0.01));
+    for (std::uint64_t i = 0; i < 5000; ++i)
+        ASSERT_TRUE(plain.add(i));
+    ASSERT_TRUE(plain.contains(std::uint64_t(1)));
+    EXPECT_EQ(plain.stats().inserts, 0);
+    EXPECT_EQ(plain.stats().queries, 0);
+    EXPECT_EQ(plain.stats().set_bits, plain.popcount());
+    EXPECT_EQ(plain.stats().estimated_elements, plain.approx_size());
 }
 
 } // BF
@@ -0,0 +1,387 @@
+#ifndef BINARY_FUSE_FILTER_HPP
+#define BINARY_FUSE_FILTER_HPP
+
+#include "bloom_filter.hpp"
+#include <ranges>
+
+namespace BF
+{
+
+// Binary fuse filter(Graf, Lemire: "Binary Fuse Filters: Fast and Smaller Than
+// Xor Filters") for sets that are known up front and never change. Every key
+// maps to three slots in neighbouring segments of a fingerprint array and
+// build() picks the fingerprints so that the three slots of every key xor to
+// the key's own fingerprint. A lookup is three loads and a compare, and the
+// filter takes about 1.13 * fingerprint_bits bits per key(9 for a false
+// positive rate of 1/256, a bloom_filter needs ~11.5 bits for that rate) for
+// sets of more than a few million keys, a little more for smaller ones.
+//
+// Keys are hashed once by the hasher. A build that does not work out retries
+// with a new seed that is mixed into the hashes, so keys are not hashed again.
+template <bloom_hasher hasher = murmur3, unsigned fingerprint_bits = 8>
+class binary_fuse_filter
+{
+    static_assert(fingerprint_bits == 8 || fingerprint_bits == 16, "fingerprints are 8 or 16 bits wide");
+    static_assert(requires(const hasher& h, const void* key, std::uint64_t len) { { h(key, len) } -> std::convertible_to<hash128>; },
+                  "the hasher has to return hash128");
+
+    typedef std::conditional_t<fingerprint_bits == 16, std::uint16_t, std::uint8_t> fingerprint;
+
+public:
+    // seeds tried before build() gives up, each try fails with a probability
+    // well below 1%
+    static constexpr std::uint64_t MAX_ATTEMPTS = 100;
+    // the slots are indexed with 32 bits
+    static constexpr std::uint64_t MAX_KEYS = std::numeric_limits<std::uint32_t>::max() / 2;
+
+    binary_fuse_filter()
+        : n(0)
+        , seed(0)
+        , segment_length(0)
+        , segment_count_length(0)
+    {
+    }
+
+    binary_fuse_filter(const binary_fuse_filter& other) = default;
+
+    binary_fuse_filter& operator=(const binary_fuse_filter& other) = default;
+
+    binary_fuse_filter(binary_fuse_filter&& other)
+        : n(other.n)
+        , seed(other.seed)
+        , segment_length(other.segment_length)
+        , segment_count_length(other.segment_count_length)
+    {
+        if (!other.fingerprints.empty())
+            std::swap(fingerprints, other.fingerprints);
+        other.n = other.seed = other.segment_length = other.segment_count_length = 0;
+    }
+
+    binary_fuse_filter& operator=(binary_fuse_filter&& other)
+    {
+        if (this != &other)
+        {
+            n                    = other.n;
+            seed                 = other.seed;
+            segment_length       = other.segment_length;
+            segment_count_length = other.segment_count_length;
+
+            if (!other.fingerprints.empty())
+            {
+                std::swap(fingerprints, other.fingerprints);
+                other.fingerprints.clear(); // in case it is not empty
+            }
+            other.n = other.seed = other.segment_length = other.segment_count_length = 0;
+        }
+        return *this;
+    }
+
+    // Builds the filter of a range of typed keys or strings, replacing what
+    // was there before. Duplicate keys are fine. Fails for more than MAX_KEYS
+    // keys or, with a vanishing probability, when no seed worked.
+    template <std::ranges::input_range range>
+        requires range_key<std::ranges::range_value_t<range>>
+    bool build(const range& keys)
+    {
+        std::vector<std::uint64_t> hashes;
+        if constexpr (std::ranges::sized_range<range>)
+            hashes.reserve(std::ranges::size(keys));
+        for (const auto& key : keys)
+            hashes.push_back(hash_range_key(h, key).h1);
+        return build_hashes(hashes);
+    }
+
+    // Same as above for count keys of lens[i] bytes at keys[i].
+    bool build(const void* const* keys, const std::uint64_t* lens, std::uint64_t count)
+    {
+        if (!keys || !lens)
+            return false;
+
+        std::vector<std::uint64_t> hashes(count);
+        for (std::uint64_t i = 0; i < count; ++i)
+            hashes[i] = h(keys[i], lens[i]).h1;
+        return build_hashes(hashes);
+    }
+
+    // Create a filter from the components of an existing one: the number of
+    // keys it was built from, its seed and its raw() bytes, which are deep
+    // copied.
+    bool from(std::uint64_t n, std::uint64_t seed, const std::uint8_t* raw, std::uint64_t raw_size)
+    {
+        if (n == 0 || n > MAX_KEYS || !raw)
+            return false;
+
+        layout(n);
+        if (raw_size != fingerprints.size() * sizeof(fingerprint))
+        {
+            clear();
+            return false;
+        }
+
+        this->seed = seed;
+        std::memcpy(fingerprints.data(), raw, raw_size);
+        return true;
+    }
+
+    std::uint64_t element_count() const { return n; } // keys given to build, duplicates included
+
+    std::uint64_t seed_value() const { return seed; }
+
+    double false_positive() const { return 1.0 / (std::uint64_t(1) << fingerprint_bits); }
+
+    std::size_t size() const { return fingerprints.size() * sizeof(fingerprint); } // in bytes
+
+    double bits_per_key() const
+    {
+        if (n == 0)
+            return 0.0;
+        return static_cast<double>(size()) * 8 / n;
+    }
+
+    // The fingerprints in the byte order of the machine.
+    const std::uint8_t* raw() const
+    {
+        if (fingerprints.empty())
+            return nullptr;
+        return reinterpret_cast<const std::uint8_t*>(fingerprints.data());
+    }
+
+    bool contains(const void* key, const std::uint64_t len) const
+    {
+        if (fingerprints.empty())
+            return false;
+        return contains_hash(h(key, len).h1);
+    }
+
+    // Typed keys, see bloom_filter.
+    template <trivial_key T>
+    bool contains(const T& key) const
+    {
+        if (fingerprints.empty())
+            return false;
+        return contains_hash(hash_key<sizeof(T)>(h, &key).h1);
+    }
+
+    bool contains(std::string_view key) const { return contains(key.data(), key.size()); }
+
+    bool contains(std::span<const std::byte> key) const { return contains(key.data(), key.size()); }
+
+private:
+    std::uint64_t            n; // number of keys the filter was built from
+    std::uint64_t            seed;
+    std::uint64_t            segment_length; // a power of two
+    std::uint64_t            segment_count_length;
+    std::vector<fingerprint> fingerprints;
+    hasher                   h;
+
+    void clear()
+    {
+        n = seed = segment_length = segment_count_length = 0;
+        fingerprints.clear();
+    }
+
+    // The segment length and the number of slots for n keys, as proposed by
+    // the paper for three slots per key, with the constants of its reference
+    // implementation(xor_singleheader). The array is sized a little larger
+    // for small n, which otherwise would hardly ever build.
+    void layout(std::uint64_t n)
+    {
+        const std::uint64_t length_bits = n == 0 ? 2 : static_cast<std::uint64_t>(std::floor(std::log(static_cast<double>(n)) / std::log(3.33) + 2.25));
+        segment_length                  = std::uint64_t(1) << std::min<std::uint64_t>(length_bits, 18);
+
+        const double        size_factor   = n <= 1 ? 0.0 : std::max(1.125, 0.875 + 0.25 * std::log(1000000.0) / std::log(static_cast<double>(n)));
+        const std::uint64_t capacity      = std::llround(n * size_factor);
+        const std::uint64_t segment_count = std::max<std::uint64_t>(capacity / segment_length + static_cast<bool>(capacity % segment_length), 3) - 2;
+
+        this->n              = n;
+        segment_count_length = segment_count * segment_length;
+        fingerprints.assign((segment_count + 2) * segment_length, 0);
+    }
+
+    static std::uint64_t mix(std::uint64_t hash)
+    {
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    static fingerprint fingerprint_of(std::uint64_t hash) { return static_cast<fingerprint>(hash ^ (hash >> 32)); }
+
+    // Slot i(0, 1 or 2) of a mixed hash: the first one is anywhere in the
+    // first segment_count segments, the next ones in the following segments.
+    std::uint32_t slot(std::uint64_t i, std::uint64_t hash) const
+    {
+        __extension__ typedef unsigned __int128 uint128;
+        std::uint64_t slot = static_cast<std::uint64_t>((static_cast<uint128>(hash) * segment_count_length) >> 64);
+        slot += i * segment_length;
+        // slot 0 is not moved, slot 1 takes bits 18-35 and slot 2 bits 0-17
+        slot ^= ((hash & ((std::uint64_t(1) << 36) - 1)) >> (36 - 18 * i)) & (segment_length - 1);
+        return static_cast<std::uint32_t>(slot);
+    }
+
+    bool contains_hash(std::uint64_t key_hash) const
+    {
+        const std::uint64_t hash = mix(key_hash + seed);
+        return (fingerprint_of(hash) ^ fingerprints[slot(0, hash)] ^ fingerprints[slot(1, hash)] ^ fingerprints[slot(2, hash)]) == 0;
+    }
+
+    static std::uint64_t next_seed(std::uint64_t& state)
+    {
+        // splitmix64
+        std::uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z               = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z               = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    // Peels the three-slot hypergraph of the keys: a slot with a single key
+    // left is assigned to that key, which is then removed from its other two
+    // slots, until no key is left. The fingerprints are filled in reverse
+    // peeling order, so every key's slot is written after the other two are
+    // final. Follows the reference implementation of the paper.
+    bool build_hashes(std::vector<std::uint64_t>& keys)
+    {
+        clear();
+        if (keys.size() > MAX_KEYS)
+            return false;
+
+        layout(keys.size());
+        if (keys.empty())
+            return true;
+
+        const std::uint64_t capacity = fingerprints.size();
+        std::uint64_t       size     = keys.size();
+
+        // slots are grouped by the top bits of the hashes before they are
+        // counted, which keeps the counting passes local
+        std::uint64_t block_bits = 1;
+        while ((std::uint64_t(1) << block_bits) < segment_count_length / segment_length)
+            ++block_bits;
+        const std::uint64_t block = std::uint64_t(1) << block_bits;
+
+        std::vector<std::uint64_t> order(size + 1, 0); // the hashes grouped, later in peeling order
+        std::vector<std::uint8_t>  found(size);        // which of its slots a peeled key got
+        std::vector<std::uint32_t> alone(capacity);
+        std::vector<std::uint8_t>  slot_count(capacity, 0); // keys in a slot << 2 | xor of their slot numbers
+        std::vector<std::uint64_t> slot_hash(capacity, 0);  // xor of the hashes in a slot
+        std::vector<std::uint64_t> start(block);
+        std::uint64_t              rng    = 0x726b2b9d438b9d4dULL;
+        std::uint64_t              peeled = 0;
+
+        order[size] = 1;
+        for (std::uint64_t attempt = 0;; ++attempt)
+        {
+            if (attempt == MAX_ATTEMPTS)
+            {
+                clear();
+                return false;
+            }
+            seed = next_seed(rng);
+
+            for (std::uint64_t i = 0; i < block; ++i)
+                start[i] = (i * size) >> block_bits;
+            for (std::uint64_t i = 0; i < size; ++i)
+            {
+                const std::uint64_t hash  = mix(keys[i] + seed);
+                std::uint64_t       group = hash >> (64 - block_bits);
+                while (order[start[group]] != 0)
+                    group = (group + 1) & (block - 1);
+                order[start[group]++] = hash;
+            }
+
+            bool          error      = false;
+            std::uint64_t duplicates = 0;
+            for (std::uint64_t i = 0; i < size; ++i)
+            {
+                const std::uint64_t hash = order[i];
+                const std::uint32_t h0   = slot(0, hash);
+                const std::uint32_t h1   = slot(1, hash);
+                const std::uint32_t h2   = slot(2, hash);
+                slot_count[h0] += 4;
+                slot_hash[h0] ^= hash;
+                slot_count[h1] = (slot_count[h1] + 4) ^ 1;
+                slot_hash[h1] ^= hash;
+                slot_count[h2] = (slot_count[h2] + 4) ^ 2;
+                slot_hash[h2] ^= hash;
+
+                // a key that cancelled out a slot it shares with an equal hash
+                if ((slot_hash[h0] & slot_hash[h1] & slot_hash[h2]) == 0
+                    && ((slot_hash[h0] == 0 && slot_count[h0] == 8) || (slot_hash[h1] == 0 && slot_count[h1] == 8)
+                        || (slot_hash[h2] == 0 && slot_count[h2] == 8)))
+                {
+                    ++duplicates;
+                    slot_count[h0] -= 4;
+                    slot_hash[h0] ^= hash;
+                    slot_count[h1] = (slot_count[h1] - 4) ^ 1;
+                    slot_hash[h1] ^= hash;
+                    slot_count[h2] = (slot_count[h2] - 4) ^ 2;
+                    slot_hash[h2] ^= hash;
+                }
+                // the 8 bit counts overflowed
+                error |= slot_count[h0] < 4 || slot_count[h1] < 4 || slot_count[h2] < 4;
+            }
+
+            if (!error)
+            {
+                std::uint64_t queued = 0;
+                for (std::uint64_t i = 0; i < capacity; ++i)
+                {
+                    alone[queued] = i;
+                    queued += (slot_count[i] >> 2) == 1;
+                }
+
+                peeled = 0;
+                while (queued > 0)
+                {
+                    const std::uint32_t index = alone[--queued];
+                    if ((slot_count[index] >> 2) != 1)
+                        continue;
+
+                    const std::uint64_t hash     = slot_hash[index];
+                    const std::uint8_t  key_slot = slot_count[index] & 3;
+                    const std::uint32_t slots[3] = { slot(0, hash), slot(1, hash), slot(2, hash) };
+                    found[peeled]                = key_slot;
+                    order[peeled++]              = hash;
+
+                    for (const std::uint8_t other : { (key_slot + 1) % 3, (key_slot + 2) % 3 })
+                    {
+                        const std::uint32_t other_index = slots[other];
+                        alone[queued]                   = other_index;
+                        queued += (slot_count[other_index] >> 2) == 2;
+                        slot_count[other_index] = (slot_count[other_index] - 4) ^ other;
+                        slot_hash[other_index] ^= hash;
+                    }
+                }
+
+                if (peeled + duplicates == size)
+                    break;
+
+                if (duplicates > 0)
+                {
+                    std::sort(keys.begin(), keys.end());
+                    size = std::unique(keys.begin(), keys.end()) - keys.begin();
+                }
+            }
+
+            std::fill(order.begin(), order.begin() + size, 0);
+            order[size] = 1; // keeps the grouping from running past the last group
+            std::fill(slot_count.begin(), slot_count.end(), 0);
+            std::fill(slot_hash.begin(), slot_hash.end(), 0);
+        }
+
+        for (std::uint64_t i = peeled; i-- > 0;)
+        {
+            const std::uint64_t hash     = order[i];
+            const std::uint32_t slots[3] = { slot(0, hash), slot(1, hash), slot(2, hash) };
+            const std::uint8_t  key_slot = found[i];
+            fingerprints[slots[key_slot]] = fingerprint_of(hash) ^ fingerprints[slots[(key_slot + 1) % 3]] ^ fingerprints[slots[(key_slot + 2) % 3]];
+        }
+        return true;
+    }
+};
+
+} // BF
+#endif // BINARY_FUSE_FILTER_HPP
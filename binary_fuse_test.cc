@@ -0,0 +1,108 @@
+#include "binary_fuse_filter.hpp"
+#include "hashers.hpp"
+#include <gtest/gtest.h>
+#include <string>
+
+namespace BF
+{
+
+template <typename filter>
+void check_keys(std::uint64_t count, double max_fpr, double max_bits_per_key)
+{
+    std::vector<std::uint64_t> keys(count);
+    for (std::uint64_t i = 0; i < count; ++i)
+        keys[i] = i * 0x9e3779b97f4a7c15ULL;
+
+    filter bf;
+    ASSERT_TRUE(bf.build(keys));
+    EXPECT_EQ(bf.element_count(), count);
+    for (const std::uint64_t key : keys)
+    {
+        EXPECT_TRUE(bf.contains(key));
+        EXPECT_TRUE(bf.contains(&key, sizeof(key)));
+    }
+
+    std::uint64_t false_positive = 0;
+    for (std::uint64_t i = 0; i < 1000000; ++i)
+        false_positive += bf.contains(i * 0x9e3779b97f4a7c15ULL + 1);
+    EXPECT_LE(false_positive / 1000000.0, max_fpr) << count;
+    EXPECT_LE(bf.bits_per_key(), max_bits_per_key) << count;
+}
+
+TEST(binary_fuse_test, membership)
+{
+    for (const std::uint64_t count : { 1, 2, 10, 1000, 100000, 1000000 })
+    {
+        check_keys<BF::binary_fuse_filter<>>(count, 1.5 / 256, count < 100000 ? 1000.0 : 10.5);
+        check_keys<BF::binary_fuse_filter<BF::murmur3, 16>>(count, 5.0 / 65536, count < 100000 ? 2000.0 : 21.0);
+    }
+
+    // ~1.13 times the fingerprint size per key for large sets, small sets take more
+    BF::binary_fuse_filter<BF::xxh3> bf;
+    std::vector<std::uint32_t>       keys(2000000);
+    for (std::uint32_t i = 0; i < keys.size(); ++i)
+        keys[i] = i;
+    ASSERT_TRUE(bf.build(keys));
+    EXPECT_LT(bf.bits_per_key(), 9.2);
+    EXPECT_EQ(bf.false_positive(), 1.0 / 256);
+}
+
+TEST(binary_fuse_test, strings_and_duplicates)
+{
+    const std::vector<std::string> keys = { "alpha", "beta", "gamma", "alpha", "delta", "beta", "" };
+
+    BF::binary_fuse_filter<BF::murmur3, 16> bf;
+    ASSERT_TRUE(bf.build(keys));
+    for (const auto& key : keys)
+    {
+        EXPECT_TRUE(bf.contains(key));
+        EXPECT_TRUE(bf.contains(key.data(), key.size()));
+    }
+    EXPECT_FALSE(bf.contains("epsilon"));
+
+    // many copies of the same keys
+    std::vector<std::uint64_t> repeated(100000);
+    for (std::uint64_t i = 0; i < repeated.size(); ++i)
+        repeated[i] = i % 1000;
+    ASSERT_TRUE(bf.build(repeated));
+    for (std::uint64_t i = 0; i < 1000; ++i)
+        EXPECT_TRUE(bf.contains(i));
+
+    const void*         pointers[] = { "one", "three" };
+    const std::uint64_t lens[]     = { 3, 5 };
+    ASSERT_TRUE(bf.build(pointers, lens, 2));
+    EXPECT_TRUE(bf.contains("one"));
+    EXPECT_TRUE(bf.contains("three"));
+    EXPECT_FALSE(bf.build(nullptr, lens, 2));
+}
+
+TEST(binary_fuse_test, from_existing_data)
+{
+    std::vector<std::uint64_t> keys(50000);
+    for (std::uint64_t i = 0; i < keys.size(); ++i)
+        keys[i] = i;
+
+    BF::binary_fuse_filter<> bf;
+    EXPECT_FALSE(bf.contains(std::uint64_t(1)));
+    EXPECT_EQ(bf.raw(), nullptr);
+    ASSERT_TRUE(bf.build(keys));
+
+    BF::binary_fuse_filter<> copy;
+    EXPECT_FALSE(copy.from(keys.size(), bf.seed_value(), bf.raw(), bf.size() - 1));
+    EXPECT_FALSE(copy.from(0, bf.seed_value(), bf.raw(), bf.size()));
+    ASSERT_TRUE(copy.from(keys.size(), bf.seed_value(), bf.raw(), bf.size()));
+    EXPECT_EQ(std::memcmp(copy.raw(), bf.raw(), bf.size()), 0);
+    for (const std::uint64_t key : keys)
+        EXPECT_TRUE(copy.contains(key));
+
+    BF::binary_fuse_filter<> moved = std::move(copy);
+    EXPECT_EQ(copy.size(), 0);
+    EXPECT_FALSE(copy.contains(std::uint64_t(1)));
+    EXPECT_TRUE(moved.contains(std::uint64_t(1)));
+
+    // an empty set contains nothing
+    ASSERT_TRUE(moved.build(std::vector<std::uint64_t>()));
+    EXPECT_FALSE(moved.contains(std::uint64_t(1)));
+}
+
+} // BF
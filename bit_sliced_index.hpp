@@ -0,0 +1,223 @@
+#ifndef BIT_SLICED_INDEX_HPP
+#define BIT_SLICED_INDEX_HPP
+
+#include "bloom_filter.hpp"
+
+namespace BF
+{
+
+// Answers "which of these filters might contain the key" for many
+// bloom_filters of the same m and k, the bit sliced signature layout of
+// BitFunnel. The filters are stored transposed: row i holds bit i of every
+// filter, bit f of the row being filter f. A query hashes the key once and
+// ANDs the k rows of its probes, which leaves a bitmap of the matching
+// filters. That reads k rows of N / 8 bytes each, instead of hashing the key
+// N times and touching N * k scattered cache lines.
+//
+// Filters are appended one at a time and keep their position. The rows are
+// padded to a power of two words and grow by doubling, so appends cost
+// O(m) amortized on top of visiting the set bits of the filter.
+template <bloom_hasher hasher = murmur3, typename index = modulo_index>
+class bit_sliced_index
+{
+public:
+    bit_sliced_index()
+        : m(0)
+        , k(0)
+        , count(0)
+        , stride(0)
+    {
+    }
+
+    bit_sliced_index(const bit_sliced_index& other) = default;
+
+    bit_sliced_index& operator=(const bit_sliced_index& other) = default;
+
+    bit_sliced_index(bit_sliced_index&& other)
+        : m(other.m)
+        , k(other.k)
+        , count(other.count)
+        , stride(other.stride)
+        , rows(std::move(other.rows))
+    {
+        other.rows.clear();
+        other.m = other.k = other.count = other.stride = 0;
+    }
+
+    bit_sliced_index& operator=(bit_sliced_index&& other)
+    {
+        if (this != &other)
+        {
+            m      = other.m;
+            k      = other.k;
+            count  = other.count;
+            stride = other.stride;
+            rows   = std::move(other.rows);
+
+            other.rows.clear();
+            other.m = other.k = other.count = other.stride = 0;
+        }
+        return *this;
+    }
+
+    // Makes room for filters filters without growing the rows, e.g. when the
+    // number of segments is known up front.
+    void reserve(std::uint64_t filters)
+    {
+        const std::uint64_t words = std::bit_ceil(filters / 64 + static_cast<bool>(filters & 63));
+        if (words > stride)
+            grow(words);
+    }
+
+    // Adds bf as filter filter_count(). The first filter sets m and k, the
+    // others need the same(and the same hasher and index policy, which the
+    // type checks). The stats policy and allocator do not matter.
+    template <typename stats_policy, typename allocator>
+    bool append(const bloom_filter<hasher, index, stats_policy, allocator>& bf)
+    {
+        if (!bf.raw())
+            return false;
+
+        if (m == 0)
+        {
+            m = bf.bit_count();
+            k = bf.hash_count();
+            rows.assign(m * stride, 0);
+        }
+        else if (bf.bit_count() != m || bf.hash_count() != k)
+            return false;
+
+        if (count == stride * 64)
+            grow(std::max<std::uint64_t>(1, stride * 2));
+
+        // only the set bits of the filter are visited, those past m(from()
+        // may have been handed some) have no row
+        const std::uint64_t* words  = reinterpret_cast<const std::uint64_t*>(bf.raw());
+        const std::uint64_t  column = count / 64;
+        const std::uint64_t  mask   = std::uint64_t(1) << (count & 63);
+        for (std::uint64_t w = 0; w < m / 64 + static_cast<bool>(m & 63); ++w)
+        {
+            std::uint64_t bits = words[w];
+            if (w == m / 64)
+                bits &= (std::uint64_t(1) << (m & 63)) - 1;
+            for (; bits; bits &= bits - 1)
+                rows[(w * 64 + std::countr_zero(bits)) * stride + column] |= mask;
+        }
+        ++count;
+        return true;
+    }
+
+    // Drops all filters, m and k are set again by the next append.
+    void clear()
+    {
+        rows.clear();
+        m = k = count = stride = 0;
+    }
+
+    std::uint64_t filter_count() const { return count; }
+
+    std::uint64_t bit_count() const { return m; }
+
+    std::uint64_t hash_count() const { return k; }
+
+    // The number of words a query writes to its bitmap.
+    std::uint64_t bitmap_words() const { return count / 64 + static_cast<bool>(count & 63); }
+
+    std::size_t size() const { return rows.size() * sizeof(std::uint64_t); } // in bytes
+
+    // Writes bitmap_words() words to out_bitmap, bit f % 64 of word f / 64
+    // is set when filter f might contain the key, the same answer as its
+    // contains. Returns whether any filter might.
+    bool contains(const void* key, const std::uint64_t len, std::uint64_t* out_bitmap) const
+    {
+        if (count == 0 || !out_bitmap)
+            return false;
+
+        std::uint64_t probe = 0;
+        if (!for_each_hash(h, key, len, k, [&](std::uint64_t hash) { return and_row(hash, probe++, out_bitmap); }))
+            return none(out_bitmap);
+        return any(out_bitmap);
+    }
+
+    // Typed keys, hashed the way bloom_filter hashes them.
+    template <trivial_key T>
+    bool contains(const T& key, std::uint64_t* out_bitmap) const
+    {
+        if (count == 0 || !out_bitmap)
+            return false;
+
+        std::uint64_t probe = 0;
+        if (!for_each_hash<sizeof(T)>(h, &key, k, [&](std::uint64_t hash) { return and_row(hash, probe++, out_bitmap); }))
+            return none(out_bitmap);
+        return any(out_bitmap);
+    }
+
+    bool contains(std::string_view key, std::uint64_t* out_bitmap) const { return contains(key.data(), key.size(), out_bitmap); }
+
+    bool contains(std::span<const std::byte> key, std::uint64_t* out_bitmap) const { return contains(key.data(), key.size(), out_bitmap); }
+
+    // For keys whose base hashes the caller already has, see
+    // bloom_filter::contains_hash.
+    bool contains_hash(const hash128& base, std::uint64_t* out_bitmap) const
+    {
+        if (count == 0 || !out_bitmap)
+            return false;
+
+        probe_sequence probes(base);
+        for (std::uint64_t i = 0; i < k; ++i)
+            and_row(probes.next(), i, out_bitmap);
+        return any(out_bitmap);
+    }
+
+private:
+    std::uint64_t                                                    m; // bits per filter, the number of rows
+    std::uint64_t                                                    k; // number of hashes
+    std::uint64_t                                                    count; // filters appended
+    std::uint64_t                                                    stride; // words per row, a power of two
+    std::vector<std::uint64_t, aligned_allocator<std::uint64_t, 64>> rows; // bit f of row i is bit i of filter f
+    hasher                                                           h;
+    index                                                            idx;
+
+    // Copies the row of the first probe, ANDs the rows of the others.
+    bool and_row(std::uint64_t hash, std::uint64_t probe, std::uint64_t* out_bitmap) const
+    {
+        const std::uint64_t* row = rows.data() + idx(hash, m) * stride;
+        if (probe == 0)
+            std::memcpy(out_bitmap, row, bitmap_words() * sizeof(std::uint64_t));
+        else
+            simd::and_words(out_bitmap, row, bitmap_words());
+        return true;
+    }
+
+    bool any(const std::uint64_t* bitmap) const
+    {
+        std::uint64_t bits = 0;
+        for (std::uint64_t i = 0; i < bitmap_words(); ++i)
+            bits |= bitmap[i];
+        return bits != 0;
+    }
+
+    // a hasher that misbehaved matches nothing
+    bool none(std::uint64_t* bitmap) const
+    {
+        std::fill(bitmap, bitmap + bitmap_words(), 0);
+        return false;
+    }
+
+    void grow(std::uint64_t words)
+    {
+        if (m != 0 && stride != 0)
+        {
+            std::vector<std::uint64_t, aligned_allocator<std::uint64_t, 64>> wider(m * words, 0);
+            for (std::uint64_t i = 0; i < m; ++i)
+                std::memcpy(wider.data() + i * words, rows.data() + i * stride, stride * sizeof(std::uint64_t));
+            rows = std::move(wider);
+        }
+        else if (m != 0)
+            rows.assign(m * words, 0);
+        stride = words;
+    }
+};
+
+} // BF
+#endif // BIT_SLICED_INDEX_HPP
@@ -0,0 +1,144 @@
+#include "bit_sliced_index.hpp"
+#include "hashers.hpp"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace BF
+{
+
+TEST(bit_sliced_index_test, same_answers_as_the_filters)
+{
+    // 150 filters over three words of the bitmap, filter f holds the keys
+    // f * 1000 to f * 1000 + 199 and the ones of its residue mod 7
+    std::vector<BF::bloom_filter<>> filters(150);
+    BF::bit_sliced_index<>          index;
+    for (std::uint64_t f = 0; f < filters.size(); ++f)
+    {
+        ASSERT_TRUE(filters[f].config(1000, 0.01));
+        for (std::uint64_t i = f * 1000; i < f * 1000 + 200; ++i)
+            ASSERT_TRUE(filters[f].add(i));
+        ASSERT_TRUE(filters[f].add("residue " + std::to_string(f % 7)));
+        ASSERT_TRUE(index.append(filters[f]));
+        EXPECT_EQ(index.filter_count(), f + 1);
+    }
+    EXPECT_EQ(index.bit_count(), filters[0].bit_count());
+    EXPECT_EQ(index.hash_count(), filters[0].hash_count());
+    ASSERT_EQ(index.bitmap_words(), 3);
+
+    std::vector<std::uint64_t> bitmap(index.bitmap_words());
+    for (std::uint64_t key = 0; key < 160000; key += 11)
+    {
+        const bool found = index.contains(key, bitmap.data());
+        bool       any   = false;
+        for (std::uint64_t f = 0; f < filters.size(); ++f)
+        {
+            ASSERT_EQ((bitmap[f / 64] >> (f & 63)) & 1, filters[f].contains(key)) << key << " " << f;
+            any |= filters[f].contains(key);
+        }
+        ASSERT_EQ(found, any);
+    }
+
+    ASSERT_TRUE(index.contains("residue 3", bitmap.data()));
+    for (std::uint64_t f = 3; f < filters.size(); f += 7)
+        EXPECT_TRUE((bitmap[f / 64] >> (f & 63)) & 1) << f;
+    EXPECT_EQ(bitmap[2] >> (150 - 128), 0); // nothing past the last filter
+
+    // the same bitmap from the bytes, the base hashes and a span
+    const std::uint64_t        key = 4142;
+    std::vector<std::uint64_t> other(index.bitmap_words());
+    ASSERT_TRUE(index.contains(key, bitmap.data()));
+    ASSERT_TRUE(index.contains(&key, sizeof(key), other.data()));
+    EXPECT_EQ(bitmap, other);
+    std::fill(other.begin(), other.end(), 0);
+    ASSERT_TRUE(index.contains_hash(BF::murmur3()(&key, sizeof(key)), other.data()));
+    EXPECT_EQ(bitmap, other);
+    std::fill(other.begin(), other.end(), 0);
+    ASSERT_TRUE(index.contains(std::as_bytes(std::span(&key, 1)), other.data()));
+    EXPECT_EQ(bitmap, other);
+}
+
+TEST(bit_sliced_index_test, append_and_grow)
+{
+    BF::bit_sliced_index<BF::xxh3, BF::pow2_index> index;
+    std::vector<std::uint64_t>                     bitmap(4);
+    EXPECT_FALSE(index.contains(std::uint64_t(1), bitmap.data()));
+    EXPECT_EQ(index.bitmap_words(), 0);
+
+    // not configured, then another m or k than the first filter
+    BF::bloom_filter<BF::xxh3, BF::pow2_index> unset;
+    EXPECT_FALSE(index.append(unset));
+
+    BF::bloom_filter<BF::xxh3, BF::pow2_index, BF::counting_stats> first;
+    ASSERT_TRUE(first.config(4096, 4, 100));
+    ASSERT_TRUE(first.add("first"));
+    ASSERT_TRUE(index.append(first));
+    const std::uint64_t size = index.size();
+
+    BF::bloom_filter<BF::xxh3, BF::pow2_index> other_m, other_k;
+    ASSERT_TRUE(other_m.config(8192, 4, 100));
+    ASSERT_TRUE(other_k.config(4096, 5, 100));
+    EXPECT_FALSE(index.append(other_m));
+    EXPECT_FALSE(index.append(other_k));
+    EXPECT_EQ(index.filter_count(), 1);
+
+    // rows double past 64, 128 and 256 filters and keep their bits
+    for (std::uint64_t f = 1; f < 200; ++f)
+    {
+        BF::bloom_filter<BF::xxh3, BF::pow2_index> bf;
+        ASSERT_TRUE(bf.config(4096, 4, 100));
+        ASSERT_TRUE(bf.add(f));
+        ASSERT_TRUE(index.append(bf));
+    }
+    EXPECT_EQ(index.size(), size * 4);
+    ASSERT_TRUE(index.contains("first", bitmap.data()));
+    EXPECT_TRUE(bitmap[0] & 1);
+    for (std::uint64_t f = 1; f < 200; ++f)
+    {
+        ASSERT_TRUE(index.contains(f, bitmap.data()));
+        ASSERT_TRUE((bitmap[f / 64] >> (f & 63)) & 1) << f;
+    }
+
+    // reserve allocates up front, moves leave an empty index
+    BF::bit_sliced_index<BF::xxh3, BF::pow2_index> reserved;
+    reserved.reserve(200);
+    ASSERT_TRUE(reserved.append(first));
+    EXPECT_EQ(reserved.size(), index.size());
+
+    BF::bit_sliced_index<BF::xxh3, BF::pow2_index> moved(std::move(index));
+    EXPECT_EQ(index.filter_count(), 0);
+    EXPECT_FALSE(index.contains("first", bitmap.data()));
+    EXPECT_EQ(moved.filter_count(), 200);
+    EXPECT_TRUE(moved.contains("first", bitmap.data()));
+
+    moved.clear();
+    EXPECT_EQ(moved.size(), 0);
+    ASSERT_TRUE(moved.append(other_m));
+    EXPECT_EQ(moved.bit_count(), 8192);
+}
+
+TEST(bit_sliced_index_test, bits_past_m)
+{
+    // m is not a whole number of words and the bytes handed to from() have
+    // bits set past it, which have no row and are ignored
+    BF::bloom_filter<> bf;
+    ASSERT_TRUE(bf.config(1000, 0.01));
+    ASSERT_NE(bf.bit_count() & 7, 0);
+    ASSERT_TRUE(bf.add("key"));
+    std::vector<std::uint8_t> bytes(bf.raw(), bf.raw() + bf.size());
+    bytes.back() = 0xff;
+
+    BF::bloom_filter<> loaded;
+    ASSERT_TRUE(loaded.from(bf.bit_count(), bf.hash_count(), bf.expected_elements(), bf.false_positive(), bytes.data(), bytes.size()));
+
+    BF::bit_sliced_index<> index;
+    for (int f = 0; f < 3; ++f)
+        ASSERT_TRUE(index.append(f == 1 ? loaded : bf));
+    std::vector<std::uint64_t> bitmap(index.bitmap_words());
+    ASSERT_TRUE(index.contains("key", bitmap.data()));
+    EXPECT_EQ(bitmap[0], 0b111);
+    for (std::uint64_t key = 0; key < 10000; ++key)
+        ASSERT_EQ(index.contains(key, bitmap.data()), bf.contains(key) || loaded.contains(key)) << key;
+}
+
+} // BF
@@ -0,0 +1,143 @@
+#include "blocked_bloom_filter.hpp"
+#include <cstring>
+#include <gtest/gtest.h>
+
+namespace BF
+{
+
+TEST(blocked_bf_test, parameters)
+{
+    {
+        BF::blocked_bloom_filter bf;
+        EXPECT_TRUE(bf.config(1000, 3, 10));
+        EXPECT_EQ(bf.bit_count(), 1024); // rounded up to whole blocks
+        EXPECT_EQ(bf.hash_count(), 3);
+        EXPECT_EQ(bf.expected_elements(), 10);
+        EXPECT_GT(bf.false_positive(), 0.0);
+        EXPECT_LT(bf.false_positive(), 1.0);
+        EXPECT_EQ(bf.size(), 128);
+        EXPECT_NE(bf.raw(), nullptr);
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(bf.raw()) % 64, 0);
+    }
+
+    {
+        // the blocked layout needs more bits than the classic one for the same p
+        BF::bloom_filter         classic;
+        BF::blocked_bloom_filter bf;
+        EXPECT_TRUE(classic.config(553, 0.002));
+        EXPECT_TRUE(bf.config(553, 0.002));
+        EXPECT_GT(bf.bit_count(), classic.bit_count());
+        EXPECT_EQ(bf.bit_count() % BF::blocked_bloom_filter<>::BLOCK_BITS, 0);
+        EXPECT_EQ(bf.expected_elements(), 553);
+        EXPECT_EQ(bf.false_positive(), 0.002);
+        EXPECT_EQ(bf.size(), bf.bit_count() / 8);
+
+        // the selected m and k should actually reach the requested rate
+        BF::blocked_bloom_filter check;
+        EXPECT_TRUE(check.config(bf.bit_count(), bf.hash_count(), 553));
+        EXPECT_LE(check.false_positive(), 0.002);
+    }
+
+    {
+        BF::blocked_bloom_filter bf;
+        EXPECT_FALSE(bf.config(0, 0.5));
+        EXPECT_FALSE(bf.config(256, 1.0));
+        EXPECT_FALSE(bf.config(256, 0.0));
+        EXPECT_FALSE(bf.config(0, 256, 1024));
+        EXPECT_FALSE(bf.config(256, 0, 1024));
+        EXPECT_FALSE(bf.config(256, 1024, 0));
+    }
+}
+
+TEST(blocked_bf_test, single_block_per_key)
+{
+    BF::blocked_bloom_filter bf;
+    ASSERT_TRUE(bf.config(1 << 16, 8, 100));
+
+    const std::string key("one cache line");
+    ASSERT_TRUE(bf.add(key.data(), key.size()));
+
+    std::uint64_t touched_blocks = 0;
+    for (std::uint64_t block = 0; block < bf.size() / 64; ++block)
+    {
+        bool touched = false;
+        for (std::uint64_t i = 0; i < 64; ++i)
+            touched |= bf.raw()[block * 64 + i] != 0;
+        touched_blocks += touched;
+    }
+    EXPECT_EQ(touched_blocks, 1);
+    EXPECT_TRUE(bf.contains(key.data(), key.size()));
+}
+
+TEST(blocked_bf_test, contains)
+{
+    {
+        BF::blocked_bloom_filter bf;
+        std::string              temp("temp");
+        ASSERT_FALSE(bf.contains(temp.data(), temp.size()));
+        ASSERT_FALSE(bf.add(temp.data(), temp.size()));
+    }
+
+    for (const double FPR : { 0.1, 0.01, 0.001 })
+    {
+        BF::blocked_bloom_filter bf;
+        constexpr std::uint64_t  ELEMENT_COUNT = 200000;
+        ASSERT_TRUE(bf.config(ELEMENT_COUNT, FPR));
+
+        for (std::uint64_t i = 0; i < ELEMENT_COUNT; ++i)
+            ASSERT_TRUE(bf.add(&i, sizeof(i)));
+        for (std::uint64_t i = 0; i < ELEMENT_COUNT; ++i)
+            ASSERT_TRUE(bf.contains(&i, sizeof(i)));
+
+        std::uint64_t false_positive = 0;
+        for (std::uint64_t i = ELEMENT_COUNT; i < 2 * ELEMENT_COUNT; ++i)
+        {
+            if (bf.contains(&i, sizeof(i)))
+                false_positive++;
+        }
+        // the calculator is a bound the measured rate should come close to
+        const double measured = static_cast<double>(false_positive) / ELEMENT_COUNT;
+        EXPECT_LE(measured, FPR * 1.15);
+        EXPECT_GE(measured, FPR * 0.6);
+    }
+}
+
+TEST(blocked_bf_test, from_and_merge)
+{
+    constexpr std::uint64_t byte_count = 1024;
+    std::uint8_t            raw_bytes[byte_count];
+    constexpr std::uint64_t n = 1023;
+    constexpr std::uint64_t m = byte_count * 8;
+    constexpr std::uint64_t k = 2;
+    constexpr double        p = 0.003322;
+
+    for (std::uint64_t i = 0; i < byte_count; ++i)
+        raw_bytes[i] = 0xAA;
+
+    BF::blocked_bloom_filter bf;
+    EXPECT_FALSE(bf.from(m + 8, k, n, p, raw_bytes, byte_count + 1)); // not a whole block
+    EXPECT_FALSE(bf.from(m, k, n, p, raw_bytes, byte_count - 1));
+    EXPECT_TRUE(bf.from(m, k, n, p, raw_bytes, byte_count));
+    EXPECT_EQ(bf.bit_count(), m);
+    EXPECT_EQ(bf.size(), byte_count);
+    EXPECT_NE(bf.raw(), raw_bytes);
+    EXPECT_EQ(std::memcmp(bf.raw(), raw_bytes, bf.size()), 0);
+
+    for (std::uint64_t i = 0; i < byte_count; ++i)
+        raw_bytes[i] = 0x55;
+
+    BF::blocked_bloom_filter other;
+    EXPECT_TRUE(other.from(m, k, n, p, raw_bytes, byte_count));
+    EXPECT_TRUE(bf.merge(other));
+    EXPECT_EQ(std::memcmp(other.raw(), raw_bytes, other.size()), 0);
+    for (std::uint64_t i = 0; i < byte_count; ++i)
+        EXPECT_EQ(bf.raw()[i], 0xAA | 0x55);
+
+    BF::blocked_bloom_filter moved = std::move(bf);
+    EXPECT_EQ(bf.bit_count(), 0);
+    EXPECT_EQ(bf.raw(), nullptr);
+    EXPECT_EQ(moved.bit_count(), m);
+    EXPECT_FALSE(moved.merge(bf));
+}
+
+} // BF
@@ -0,0 +1,276 @@
+#ifndef BLOCKED_BLOOM_FILTER_HPP
+#define BLOCKED_BLOOM_FILTER_HPP
+
+#include "bloom_filter.hpp"
+
+namespace BF
+{
+
+// Cache-line-blocked bloom filter(Putze, Sanders, Singler: "Cache-, Hash- and
+// Space-Efficient Bloom Filters").
+// The first hash selects one 64 byte block and all k probes are placed inside
+// of it, so a lookup costs at most one cache miss. The price is a slightly
+// higher false positive rate for the same m, which is accounted for when
+// sizing the filter.
+template <bloom_hasher hasher = murmur3>
+class blocked_bloom_filter
+{
+public:
+    static constexpr std::uint64_t BLOCK_BYTES = 64;
+    static constexpr std::uint64_t BLOCK_BITS  = BLOCK_BYTES * 8;
+
+    blocked_bloom_filter()
+        : m(0)
+        , k(0)
+        , n(0)
+        , p(0.0)
+    {
+    }
+
+    blocked_bloom_filter(const blocked_bloom_filter& other) = default;
+
+    blocked_bloom_filter& operator=(const blocked_bloom_filter& other) = default;
+
+    blocked_bloom_filter(blocked_bloom_filter&& other)
+        : m(other.m)
+        , k(other.k)
+        , n(other.n)
+        , p(other.p)
+    {
+        if (!other.bits.empty())
+            std::swap(bits, other.bits);
+        other.m = other.k = other.n = other.p = 0;
+    }
+
+    blocked_bloom_filter& operator=(blocked_bloom_filter&& other)
+    {
+        if (this != &other)
+        {
+            m = other.m;
+            k = other.k;
+            n = other.n;
+            p = other.p;
+
+            if (!other.bits.empty())
+            {
+                std::swap(bits, other.bits);
+                other.bits.clear(); // in case it is not empty
+            }
+            other.m = other.k = other.n = other.p = 0;
+        }
+        return *this;
+    }
+
+    // m is rounded up to a whole number of blocks.
+    bool config(std::uint64_t m, std::uint64_t k, std::uint64_t n)
+    {
+        if (m == 0 || k == 0 || n == 0)
+            return false;
+
+        this->m = (m / BLOCK_BITS + static_cast<bool>(m % BLOCK_BITS)) * BLOCK_BITS;
+        this->k = k;
+        this->n = n;
+        this->p = compute_p(this->m, k, n);
+
+        bits.clear();
+        bits.resize(this->m / 8, 0);
+
+        return true;
+    }
+
+    bool config(std::uint64_t n, double p)
+    {
+        if (p >= 1.0 || p <= 0.0 || n == 0)
+            return false;
+
+        this->n = n;
+        this->p = p;
+        compute_m_k(n, p, m, k);
+
+        bits.clear();
+        bits.resize(m / 8, 0);
+
+        return true;
+    }
+
+    // Create a bf from the components of an existing one.
+    // Deep copies the values from the raw byte pointer.
+    bool from(std::uint64_t       m,
+              std::uint64_t       k,
+              std::uint64_t       n,
+              double              p,
+              const std::uint8_t* raw,
+              std::uint64_t       raw_size)
+    {
+        if (p >= 1.0 || p <= 0.0 || n == 0 || k == 0)
+            return false;
+
+        if (m == 0 || m % BLOCK_BITS != 0)
+            return false;
+
+        if (!raw || raw_size == 0 || m / 8 != raw_size)
+            return false;
+
+        this->n = n;
+        this->p = p;
+        this->m = m;
+        this->k = k;
+
+        bits.clear();
+        bits.reserve(raw_size);
+        std::copy(raw, raw + raw_size, std::back_inserter(bits));
+
+        return true;
+    }
+
+    std::uint64_t bit_count() const { return m; }
+
+    std::uint64_t hash_count() const { return k; }
+
+    std::uint64_t expected_elements() const { return n; }
+
+    double false_positive() const { return p; }
+
+    std::size_t size() const { return bits.size(); } // in bytes
+
+    const std::uint8_t* raw() const
+    {
+        if (bits.empty())
+            return nullptr;
+        return bits.data();
+    }
+
+    bool add(const void* key, const std::uint64_t len)
+    {
+        if (m == 0 || k == 0 || n == 0 || p == 0.0)
+            return false;
+
+        // one extra hash is used to select the block
+        std::uint8_t* block = nullptr;
+        return for_each_hash(h, key, len, k + 1, [this, &block](std::uint64_t hash) {
+            if (!block)
+            {
+                block = bits.data() + (hash % (m / BLOCK_BITS)) * BLOCK_BYTES;
+                return true;
+            }
+            const std::uint64_t bit_id = hash >> 55; // high 9 bits, they are the best mixed
+            block[bit_id / 8] |= BIT_POS[bit_id & 7];
+            return true;
+        });
+    }
+
+    bool contains(const void* key, const std::uint64_t len) const
+    {
+        if (m == 0 || k == 0 || n == 0 || p == 0.0)
+            return false;
+
+        const std::uint8_t* block = nullptr;
+        return for_each_hash(h, key, len, k + 1, [this, &block](std::uint64_t hash) {
+            if (!block)
+            {
+                block = bits.data() + (hash % (m / BLOCK_BITS)) * BLOCK_BYTES;
+                return true;
+            }
+            const std::uint64_t bit_id = hash >> 55;
+            return (block[bit_id / 8] & BIT_POS[bit_id & 7]) != 0;
+        });
+    }
+
+    bool merge(const blocked_bloom_filter& other)
+    {
+        if (m == 0 || k == 0 || n == 0 || p == 0.0)
+            return false;
+
+        if (m != other.m || k != other.k || n != other.n
+            || p != other.p || bits.size() != other.bits.size())
+            return false;
+
+        for (std::uint64_t i = 0; i < bits.size(); ++i)
+            bits[i] |= other.bits[i];
+
+        return true;
+    }
+
+private:
+    static constexpr std::uint8_t BIT_POS[8] = { 0x1u, 0x2u, 0x4u, 0x8u, 0x10u, 0x20u, 0x40u, 0x80u };
+
+    std::uint64_t                                                 m; // size in bits, a multiple of BLOCK_BITS
+    std::uint64_t                                                 k; // number of hashes per block
+    std::uint64_t                                                 n; // expected number of elements
+    double                                                        p; // false positive probability(> 0 && < 1)
+    std::vector<std::uint8_t, aligned_allocator<std::uint8_t, 64>> bits;
+    hasher                                                        h;
+
+    // The number of keys that land in a block follows a Poisson distribution
+    // with mean n / blocks. Each block is then a classic bloom filter of
+    // BLOCK_BITS bits, so the overall rate is the expectation of the classic
+    // rate over the block load.
+    static double compute_p(std::uint64_t m, std::uint64_t k, std::uint64_t n)
+    {
+        const double lambda = static_cast<double>(n) / (m / BLOCK_BITS);
+        const double spread = 10.0 * std::sqrt(lambda) + 10.0;
+        const double lo     = std::max(0.0, std::floor(lambda - spread));
+        const double hi     = std::ceil(lambda + spread);
+        const double miss   = std::log1p(-1.0 / BLOCK_BITS);
+
+        double fpr = 0.0;
+        for (double i = std::max(lo, 1.0); i <= hi; ++i)
+        {
+            const double poisson = std::exp(i * std::log(lambda) - lambda - std::lgamma(i + 1.0));
+            const double inner   = std::pow(1.0 - std::exp(i * k * miss), static_cast<double>(k));
+            fpr += poisson * inner;
+        }
+        return std::min(fpr, 1.0);
+    }
+
+    // Smallest m(in whole blocks) for which some k reaches p, together with
+    // the k that minimizes the rate for that m.
+    static void compute_m_k(std::uint64_t n, double p, std::uint64_t& m, std::uint64_t& k)
+    {
+        constexpr std::uint64_t MAX_BLOCKS = std::uint64_t(1) << 54;
+
+        auto best = [n](std::uint64_t blocks, std::uint64_t& best_k) {
+            const std::uint64_t classic_k = std::max<std::uint64_t>(1, std::round((static_cast<double>(blocks * BLOCK_BITS) / n) * std::log(2.0)));
+            double              best_p    = 1.0;
+            best_k                        = 1;
+            for (std::uint64_t i = 1; i <= std::min<std::uint64_t>(2 * classic_k + 1, 64); ++i)
+            {
+                const double candidate = compute_p(blocks * BLOCK_BITS, i, n);
+                if (candidate < best_p)
+                {
+                    best_p = candidate;
+                    best_k = i;
+                }
+            }
+            return best_p;
+        };
+
+        // the classic sizing is a lower bound for the blocked layout
+        const double  classic_m = BF::compute_m(n, p);
+        std::uint64_t hi        = std::max<std::uint64_t>(1, std::ceil(classic_m / BLOCK_BITS));
+        std::uint64_t lo        = hi;
+        std::uint64_t best_k    = 1;
+
+        while (best(hi, best_k) > p && hi < MAX_BLOCKS)
+        {
+            lo = hi + 1;
+            hi *= 2;
+        }
+
+        while (lo < hi)
+        {
+            const std::uint64_t mid = lo + (hi - lo) / 2;
+            if (best(mid, best_k) > p)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        best(hi, best_k);
+        m = hi * BLOCK_BITS;
+        k = best_k;
+    }
+};
+
+} // BF
+#endif // BLOCKED_BLOOM_FILTER_HPP
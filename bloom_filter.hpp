@@ -2,36 +2,234 @@
 #define BLOOM_FILTER_HPP
 
 #include <algorithm>
+#include <bit>
 #include <cmath>
+#include <cstddef>
+#include <concepts>
 #include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "simd.hpp"
+
+// raw() hands out the 64 bit words of a filter as bytes, they are only in
+// the documented byte order on little endian machines.
+static_assert(std::endian::native == std::endian::little, "bloom_filter needs a little endian machine");
+
 namespace BF
 {
 typedef std::vector<std::uint64_t> hashes;
 
+// The two 64 bit base hashes of a key, all k probes are derived from them.
+struct hash128
+{
+    std::uint64_t h1;
+    std::uint64_t h2;
+};
+
+// Expands the base hashes into the Kirsch-Mitzenmacher probe sequence one
+// value at a time: h1, h2, then g(i) = g(i - 2) + i * g(i - 1).
+class probe_sequence
+{
+public:
+    constexpr probe_sequence()
+        : probe_sequence(hash128 { 0, 0 })
+    {
+    }
+
+    constexpr explicit probe_sequence(const hash128& base)
+        : current(base.h1)
+        , following(base.h2)
+        , i(3)
+    {
+    }
+
+    constexpr std::uint64_t next()
+    {
+        const std::uint64_t out = current;
+        const std::uint64_t g   = current + i++ * following;
+        current                 = following;
+        following               = g;
+        return out;
+    }
+
+private:
+    std::uint64_t current;
+    std::uint64_t following;
+    std::uint64_t i;
+};
+
+// What the filters need from a hasher, either
+//   hash128 operator()(const void* key, std::uint64_t len)
+// returning the two base hashes of the probe sequence, or the older
+//   void operator()(const void* key, std::uint64_t len, std::uint64_t k, hashes& out)
+// appending k hashes to out. Further parameters need defaults(e.g. a seed).
+// A hasher may also have an id and default_seed to be persisted(see
+// mapped_bloom_filter.hpp), hash_many for batches and hash_u64(u64_hasher).
+template <typename H>
+concept bloom_hasher = std::default_initializable<H>
+                       && (requires(H& h, const void* key, std::uint64_t len) {
+                              { h(key, len) } -> std::convertible_to<hash128>;
+                          } || requires(H& h, const void* key, std::uint64_t len, std::uint64_t k, hashes& out) { h(key, len, k, out); });
+
+// A hasher with a version for keys of a length known at compile time.
+// hash_fixed<len>(key) must be equal to operator()(key, len).
+template <typename H, std::uint64_t len>
+concept fixed_hasher = bloom_hasher<H> && requires(const H& h, const void* key) {
+    { h.template hash_fixed<len>(key) } -> std::convertible_to<hash128>;
+};
+
+// A hasher with a fast path for 64 bit integer keys. hash_u64(key) must be
+// equal to operator()(&key, sizeof(key)), so keys added one way are found
+// the other way.
+template <typename H>
+concept u64_hasher = bloom_hasher<H> && requires(const H& h, std::uint64_t key) {
+    { h.hash_u64(key) } -> std::convertible_to<hash128>;
+};
+
+// A hasher that also works in constant expressions. hash_string(key) must be
+// constexpr and equal to operator()(key.data(), key.size()).
+template <typename H>
+concept constexpr_hasher = bloom_hasher<H> && requires(const H& h, std::string_view key) {
+    { h.hash_string(key) } -> std::convertible_to<hash128>;
+};
+
 class murmur3
 {
 public:
-    // taken from: https://github.com/aappleby/smhasher/blob/master/src/MurmurHash3.cpp
-    void operator()(const void* key, const std::uint64_t len, std::uint64_t k, hashes& out, const std::uint32_t seed = 0xbeefeebb) const
+    // identify the hash function in persisted filters(see mapped_bloom_filter.hpp)
+    static constexpr std::uint32_t id           = 1;
+    static constexpr std::uint32_t default_seed = 0xbeefeebb;
+
+    hash128 operator()(const void* key, const std::uint64_t len, const std::uint32_t seed = default_seed) const
+    {
+        return hash((const std::uint8_t*)key, len, seed);
+    }
+
+    // Same as operator()(key, len, seed) for a len known at compile time, the
+    // block loop and the tail switch are unrolled for it.
+    template <std::uint64_t len>
+    hash128 hash_fixed(const void* key, const std::uint32_t seed = default_seed) const
+    {
+        return hash((const std::uint8_t*)key, len, seed);
+    }
+
+    // Same as operator()(key.data(), key.size(), seed) and also usable in
+    // constant expressions(constexpr_hasher).
+    constexpr hash128 hash_string(std::string_view key, const std::uint32_t seed = default_seed) const
+    {
+        return hash(key.data(), key.size(), seed);
+    }
+
+    // Same as operator()(&key, 8, seed) with the single block folded in.
+    constexpr hash128 hash_u64(std::uint64_t key, const std::uint32_t seed = default_seed) const
+    {
+        const std::uint64_t c1 = 0x87c37b91114253d5LLU;
+        const std::uint64_t c2 = 0x4cf5ad432745937fLLU;
+
+        key *= c1;
+        key = ROTL64(key, 31);
+        key *= c2;
+
+        std::uint64_t h1 = (seed ^ key) ^ 8;
+        std::uint64_t h2 = seed ^ 8;
+        h1 += h2;
+        h2 += h1;
+        h1 = fmix64(h1);
+        h2 = fmix64(h2);
+        h1 += h2;
+        h2 += h1;
+
+        return { h1, h2 };
+    }
+
+    // Kept for callers of the vector based interface, allocates through out.
+    void operator()(const void* key, const std::uint64_t len, std::uint64_t k, hashes& out, const std::uint32_t seed = default_seed) const
     {
         // do not do any work if it is not needed...
         if (k == 0)
             return;
 
-        const std::uint8_t*  data    = (const std::uint8_t*)key;
-        const std::uint64_t  nblocks = len / 16;
-        std::uint64_t        h1      = seed;
-        std::uint64_t        h2      = seed;
-        const std::uint64_t  c1      = 0x87c37b91114253d5LLU;
-        const std::uint64_t  c2      = 0x4cf5ad432745937fLLU;
-        const std::uint64_t* blocks  = (const std::uint64_t*)(data);
+        // apply the Kirsch-Mitzenmacher-Optimization
+        probe_sequence probes((*this)(key, len, seed));
+        for (std::uint64_t i = 0; i < k; ++i)
+            out.push_back(probes.next());
+    }
+
+    // Hashes count keys of len bytes each, stored back to back at keys. When
+    // len is a multiple of 8(8/16/32 byte ids) 8 or 4 keys are hashed at a
+    // time with AVX-512 or AVX2, whichever the cpu supports. The output is
+    // identical to calling operator() on every key.
+    void hash_many(const void* keys, const std::uint64_t len, std::uint64_t count, hash128* out, const std::uint32_t seed = default_seed) const
+    {
+        hash_many(keys, len, count, out, seed, simd::detect());
+    }
+
+    // Same as above with the instruction set picked by the caller, it must be
+    // supported by the cpu.
+    void hash_many(const void*         keys,
+                   const std::uint64_t len,
+                   std::uint64_t       count,
+                   hash128*            out,
+                   const std::uint32_t seed,
+                   simd::level         isa) const
+    {
+        const std::uint8_t* data = (const std::uint8_t*)keys;
+        std::uint64_t       i    = 0;
+#if defined(__x86_64__)
+        if (len > 0 && len % 8 == 0)
+        {
+            std::uint64_t h1[8], h2[8];
+            if (isa == simd::level::avx512)
+            {
+                for (; i + 8 <= count; i += 8)
+                {
+                    simd::murmur3_x8(data + i * len, len, seed, h1, h2);
+                    for (std::uint64_t j = 0; j < 8; ++j)
+                        out[i + j] = { h1[j], h2[j] };
+                }
+            }
+            if (isa != simd::level::scalar)
+            {
+                for (; i + 4 <= count; i += 4)
+                {
+                    simd::murmur3_x4(data + i * len, len, seed, h1, h2);
+                    for (std::uint64_t j = 0; j < 4; ++j)
+                        out[i + j] = { h1[j], h2[j] };
+                }
+            }
+        }
+#else
+        static_cast<void>(isa);
+#endif
+        for (; i < count; ++i)
+            out[i] = (*this)(data + i * len, len, seed);
+    }
+
+private:
+    // taken from: https://github.com/aappleby/smhasher/blob/master/src/MurmurHash3.cpp
+    // byte is std::uint8_t, or char in constant expressions, which cannot
+    // read the key through a cast pointer.
+    template <typename byte>
+    [[gnu::always_inline]] constexpr hash128 hash(const byte* data, const std::uint64_t len, const std::uint32_t seed) const
+    {
+        const std::uint64_t nblocks = len / 16;
+        std::uint64_t       h1      = seed;
+        std::uint64_t       h2      = seed;
+        const std::uint64_t c1      = 0x87c37b91114253d5LLU;
+        const std::uint64_t c2      = 0x4cf5ad432745937fLLU;
 
         for (std::uint64_t i = 0; i < nblocks; i++)
         {
-            std::uint64_t k1 = getblock64(blocks, i * 2 + 0);
-            std::uint64_t k2 = getblock64(blocks, i * 2 + 1);
+            std::uint64_t k1 = getblock64(data, i * 2 + 0);
+            std::uint64_t k2 = getblock64(data, i * 2 + 1);
 
             k1 *= c1;
             k1 = ROTL64(k1, 31);
@@ -49,46 +247,46 @@ public:
             h2 = h2 * 5 + 0x38495ab5;
         }
 
-        const std::uint8_t* tail = (const std::uint8_t*)(data + nblocks * 16);
-        std::uint64_t       k1   = 0;
-        std::uint64_t       k2   = 0;
+        const byte*   tail = data + nblocks * 16;
+        std::uint64_t k1   = 0;
+        std::uint64_t k2   = 0;
 
         switch (len & 15)
         {
         case 15:
-            k2 ^= ((std::uint64_t)tail[14]) << 48;
+            k2 ^= ((std::uint64_t)(std::uint8_t)tail[14]) << 48;
         case 14:
-            k2 ^= ((std::uint64_t)tail[13]) << 40;
+            k2 ^= ((std::uint64_t)(std::uint8_t)tail[13]) << 40;
         case 13:
-            k2 ^= ((std::uint64_t)tail[12]) << 32;
+            k2 ^= ((std::uint64_t)(std::uint8_t)tail[12]) << 32;
         case 12:
-            k2 ^= ((std::uint64_t)tail[11]) << 24;
+            k2 ^= ((std::uint64_t)(std::uint8_t)tail[11]) << 24;
         case 11:
-            k2 ^= ((std::uint64_t)tail[10]) << 16;
+            k2 ^= ((std::uint64_t)(std::uint8_t)tail[10]) << 16;
         case 10:
-            k2 ^= ((std::uint64_t)tail[9]) << 8;
+            k2 ^= ((std::uint64_t)(std::uint8_t)tail[9]) << 8;
         case 9:
-            k2 ^= ((std::uint64_t)tail[8]) << 0;
+            k2 ^= ((std::uint64_t)(std::uint8_t)tail[8]) << 0;
             k2 *= c2;
             k2 = ROTL64(k2, 33);
             k2 *= c1;
             h2 ^= k2;
         case 8:
-            k1 ^= ((std::uint64_t)tail[7]) << 56;
+            k1 ^= ((std::uint64_t)(std::uint8_t)tail[7]) << 56;
         case 7:
-            k1 ^= ((std::uint64_t)tail[6]) << 48;
+            k1 ^= ((std::uint64_t)(std::uint8_t)tail[6]) << 48;
         case 6:
-            k1 ^= ((std::uint64_t)tail[5]) << 40;
+            k1 ^= ((std::uint64_t)(std::uint8_t)tail[5]) << 40;
         case 5:
-            k1 ^= ((std::uint64_t)tail[4]) << 32;
+            k1 ^= ((std::uint64_t)(std::uint8_t)tail[4]) << 32;
         case 4:
-            k1 ^= ((std::uint64_t)tail[3]) << 24;
+            k1 ^= ((std::uint64_t)(std::uint8_t)tail[3]) << 24;
         case 3:
-            k1 ^= ((std::uint64_t)tail[2]) << 16;
+            k1 ^= ((std::uint64_t)(std::uint8_t)tail[2]) << 16;
         case 2:
-            k1 ^= ((std::uint64_t)tail[1]) << 8;
+            k1 ^= ((std::uint64_t)(std::uint8_t)tail[1]) << 8;
         case 1:
-            k1 ^= ((std::uint64_t)tail[0]) << 0;
+            k1 ^= ((std::uint64_t)(std::uint8_t)tail[0]) << 0;
             k1 *= c1;
             k1 = ROTL64(k1, 31);
             k1 *= c2;
@@ -104,30 +302,15 @@ public:
         h1 += h2;
         h2 += h1;
 
-        if (k == 1)
-            out.push_back(h1);
-        else if (k > 1)
-        {
-            out.push_back(h1);
-            out.push_back(h2);
-            // apply the Kirsch-Mitzenmacher-Optimization
-            for (std::uint64_t i = 3; i <= k; ++i)
-            {
-                auto g = h1 + i * h2;
-                out.push_back(g);
-                std::swap(h1, h2);
-                std::swap(h2, g);
-            }
-        }
+        return { h1, h2 };
     }
 
-private:
-    inline std::uint64_t ROTL64(std::uint64_t x, std::int8_t r) const
+    constexpr std::uint64_t ROTL64(std::uint64_t x, std::int8_t r) const
     {
         return (x << r) | (x >> (64 - r));
     }
 
-    inline std::uint64_t fmix64(std::uint64_t k) const
+    constexpr std::uint64_t fmix64(std::uint64_t k) const
     {
         k ^= k >> 33;
         k *= 0xff51afd7ed558ccdLLU;
@@ -138,13 +321,323 @@ private:
         return k;
     }
 
-    inline std::uint64_t getblock64(const std::uint64_t* p, std::uint64_t i) const
+    template <typename byte>
+    constexpr std::uint64_t getblock64(const byte* p, std::uint64_t i) const
     {
-        return p[i];
+        std::uint64_t block = 0;
+        if (std::is_constant_evaluated())
+        {
+            for (std::uint64_t j = 8; j-- > 0;)
+                block = (block << 8) | (std::uint8_t)p[i * 8 + j];
+        }
+        else
+            std::memcpy(&block, p + i * 8, sizeof(block));
+        return block;
     }
 };
 
-template <typename hasher = murmur3>
+// Classic bloom filter sizing: the number of bits for n elements at a false
+// positive rate p, the optimal number of hashes for m bits and the false
+// positive rate of m bits, k hashes and n elements.
+inline std::uint64_t compute_m(std::uint64_t n, double p)
+{
+    return std::ceil((n * std::log(p)) / std::log(1.0 / std::pow(2.0, std::log(2.0))));
+}
+
+inline std::uint64_t compute_k(std::uint64_t m, std::uint64_t n)
+{
+    return std::round((static_cast<double>(m) / n) * std::log(2.0));
+}
+
+inline double compute_p(std::uint64_t m, std::uint64_t k, std::uint64_t n)
+{
+    return std::pow(1.0 - std::exp((-static_cast<double>(k) * n) / m), k);
+}
+
+// Calls visit(hash) for the first count probe hashes of a key and stops as
+// soon as visit returns false. Hashers returning hash128 are expanded in place
+// without touching the heap. Hashers written against the older
+// (key, len, k, hashes&) signature are adapted through a reused thread local
+// buffer. Returns false if visit stopped early or the hasher misbehaved.
+template <typename H, typename visitor>
+inline bool for_each_hash(H& h, const void* key, const std::uint64_t len, std::uint64_t count, visitor&& visit)
+{
+    if constexpr (requires { { h(key, len) } -> std::convertible_to<hash128>; })
+    {
+        probe_sequence probes(h(key, len));
+        for (std::uint64_t i = 0; i < count; ++i)
+        {
+            if (!visit(probes.next()))
+                return false;
+        }
+        return true;
+    }
+    else
+    {
+        thread_local hashes hash_values;
+        hash_values.clear();
+        h(key, len, count, hash_values);
+
+        if (count != hash_values.size())
+            return false;
+
+        for (std::uint64_t i = 0; i < count; ++i)
+        {
+            if (!visit(hash_values[i]))
+                return false;
+        }
+        return true;
+    }
+}
+
+// for_each_hash for a 64 bit integer key, same as passing &key and
+// sizeof(key). u64_hasher hashers skip the bytes of the key.
+template <typename H, typename visitor>
+inline bool for_each_hash(H& h, std::uint64_t key, std::uint64_t count, visitor&& visit)
+{
+    if constexpr (requires { { h.hash_u64(key) } -> std::convertible_to<hash128>; })
+    {
+        probe_sequence probes(h.hash_u64(key));
+        for (std::uint64_t i = 0; i < count; ++i)
+        {
+            if (!visit(probes.next()))
+                return false;
+        }
+        return true;
+    }
+    else
+        return for_each_hash(h, &key, sizeof(key), count, std::forward<visitor>(visit));
+}
+
+// The base hashes of a key of a length known at compile time. 8 byte keys go
+// through hash_u64 and other lengths through hash_fixed<len> when the hasher
+// has them, otherwise it has to return hash128.
+template <std::uint64_t len, typename H>
+    requires(requires(H& h, const void* key) { { h(key, len) } -> std::convertible_to<hash128>; }
+             || requires(H& h, const void* key) { { h.template hash_fixed<len>(key) } -> std::convertible_to<hash128>; }
+             || (len == sizeof(std::uint64_t) && requires(H& h, std::uint64_t value) { { h.hash_u64(value) } -> std::convertible_to<hash128>; }))
+inline hash128 hash_key(H& h, const void* key)
+{
+    if constexpr (len == sizeof(std::uint64_t) && requires(std::uint64_t value) { { h.hash_u64(value) } -> std::convertible_to<hash128>; })
+    {
+        std::uint64_t value;
+        std::memcpy(&value, key, sizeof(value));
+        return h.hash_u64(value);
+    }
+    else if constexpr (requires { { h.template hash_fixed<len>(key) } -> std::convertible_to<hash128>; })
+        return h.template hash_fixed<len>(key);
+    else
+        return h(key, len);
+}
+
+// for_each_hash for keys of a length known at compile time, see hash_key.
+template <std::uint64_t len, typename H, typename visitor>
+inline bool for_each_hash(H& h, const void* key, std::uint64_t count, visitor&& visit)
+{
+    if constexpr (requires { { hash_key<len>(h, key) } -> std::convertible_to<hash128>; })
+    {
+        probe_sequence probes(hash_key<len>(h, key));
+        for (std::uint64_t i = 0; i < count; ++i)
+        {
+            if (!visit(probes.next()))
+                return false;
+        }
+        return true;
+    }
+    else
+        return for_each_hash(h, key, len, count, std::forward<visitor>(visit));
+}
+
+// Keys that add/contains hash by their bytes. Pointers, arrays and views
+// are left out, they would hash an address instead of what it points to,
+// and so are types with padding, whose padding bytes are unspecified.
+template <typename T>
+concept trivial_key = std::is_trivially_copyable_v<T> && !std::is_pointer_v<T> && !std::is_array_v<T>
+                      && (std::has_unique_object_representations_v<T> || std::is_floating_point_v<T>)
+                      && !std::convertible_to<T, std::string_view> && !std::convertible_to<T, std::span<const std::byte>>;
+
+// The element types of the key ranges the filters are built from: typed keys
+// and strings.
+template <typename T>
+concept range_key = trivial_key<T> || std::convertible_to<const T&, std::string_view>;
+
+// The base hashes of a range_key, the same add/contains compute for it.
+template <typename H, range_key T>
+inline hash128 hash_range_key(H& h, const T& key)
+{
+    if constexpr (std::convertible_to<const T&, std::string_view>)
+    {
+        const std::string_view chars(key);
+        return h(chars.data(), chars.size());
+    }
+    else
+        return hash_key<sizeof(T)>(h, &key);
+}
+
+// Minimal allocator that hands out storage aligned to `alignment` bytes,
+// e.g. to keep a 64 byte block inside a single cache line.
+template <typename T, std::size_t alignment>
+class aligned_allocator
+{
+public:
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind
+    {
+        typedef aligned_allocator<U, alignment> other;
+    };
+
+    aligned_allocator() = default;
+
+    template <typename U>
+    aligned_allocator(const aligned_allocator<U, alignment>&)
+    {
+    }
+
+    T* allocate(std::size_t count)
+    {
+        return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(alignment)));
+    }
+
+    void deallocate(T* ptr, std::size_t)
+    {
+        ::operator delete(ptr, std::align_val_t(alignment));
+    }
+
+    template <typename U>
+    bool operator==(const aligned_allocator<U, alignment>&) const
+    {
+        return true;
+    }
+};
+
+// Index policies map a 64 bit probe hash onto [0, m). round_m(m) returns the
+// m the policy works with for a requested m(0 if there is none) and id
+// identifies the policy in persisted filters.
+
+// hash % m, works for any m but costs a 64 bit division per probe.
+struct modulo_index
+{
+    static constexpr std::uint32_t id = 0;
+
+    static std::uint64_t round_m(std::uint64_t m) { return m; }
+
+    std::uint64_t operator()(std::uint64_t hash, std::uint64_t m) const { return hash % m; }
+};
+
+// m is rounded up to a power of two and the low bits of the hash are masked
+// out, which may take up to twice the memory.
+struct pow2_index
+{
+    static constexpr std::uint32_t id = 1;
+
+    static std::uint64_t round_m(std::uint64_t m)
+    {
+        if (m > (std::uint64_t(1) << 63))
+            return 0;
+        return m <= 1 ? m : std::uint64_t(1) << (64 - __builtin_clzll(m - 1));
+    }
+
+    std::uint64_t operator()(std::uint64_t hash, std::uint64_t m) const { return hash & (m - 1); }
+};
+
+// Lemire's multiply-shift range reduction: the high 64 bits of hash * m. It
+// works for any m and uses the high bits of the hash.
+struct fastrange_index
+{
+    static constexpr std::uint32_t id = 2;
+
+    static std::uint64_t round_m(std::uint64_t m) { return m; }
+
+    std::uint64_t operator()(std::uint64_t hash, std::uint64_t m) const
+    {
+        __extension__ typedef unsigned __int128 uint128;
+        return static_cast<std::uint64_t>((static_cast<uint128>(hash) * m) >> 64);
+    }
+};
+
+// The m and k config(n, p) uses under an index policy and the false positive
+// rate to report for them. When the policy rounds m up, k is chosen for the
+// rounded m and the rate is the one that m and k actually give.
+template <typename index>
+inline bool compute_m_k(std::uint64_t n, double p, std::uint64_t& m, std::uint64_t& k, double& real_p)
+{
+    const std::uint64_t min_m = compute_m(n, p);
+    if (index::round_m(min_m) == 0)
+        return false;
+
+    m      = index::round_m(min_m);
+    k      = compute_k(m, n);
+    real_p = m == min_m ? p : compute_p(m, k, n);
+    return true;
+}
+
+// What bloom_filter::stats() reports. inserts and queries count the keys
+// passed to add and contains(batches included) since the last config or
+// from, positives the queries that returned true. The rest is derived from
+// the bits: estimated_false_positive is fill_ratio^k, the rate a query for a
+// key that was never added sees right now, and estimated_elements is
+// approx_size().
+struct filter_stats
+{
+    std::uint64_t inserts                  = 0;
+    std::uint64_t queries                  = 0;
+    std::uint64_t positives                = 0;
+    double        positive_rate            = 0.0; // positives / queries
+    std::uint64_t set_bits                 = 0;
+    double        fill_ratio               = 0.0;
+    double        estimated_false_positive = 0.0;
+    std::uint64_t estimated_elements       = 0;
+};
+
+// Stats policies are the third template parameter of bloom_filter. They are
+// told about every insert, query and write to the bits:
+//   inserted(count), queried(count, positives), written()
+// and either keep nothing(no_stats, the default) or count them
+// (counting_stats). The filter stores the policy with [[no_unique_address]],
+// so no_stats takes no space and its empty calls compile away.
+struct no_stats
+{
+    static constexpr bool enabled = false;
+
+    void inserted(std::uint64_t) {}
+    void queried(std::uint64_t, std::uint64_t) {}
+    void written() {}
+};
+
+// Counts inserts, queries and positives and caches the popcount of the bits.
+// The cache is dropped on every write and recounted by the next stats(), so
+// scraping a filter that is not written to costs no pass over its bits.
+// Like the filter itself it is not thread safe.
+struct counting_stats
+{
+    static constexpr bool enabled = true;
+
+    std::uint64_t inserts        = 0;
+    std::uint64_t queries        = 0;
+    std::uint64_t positives      = 0;
+    std::uint64_t set_bits       = 0;
+    bool          set_bits_valid = false;
+
+    void inserted(std::uint64_t count)
+    {
+        inserts += count;
+        set_bits_valid = false;
+    }
+
+    void queried(std::uint64_t count, std::uint64_t hits)
+    {
+        queries += count;
+        positives += hits;
+    }
+
+    void written() { set_bits_valid = false; }
+};
+
+// The bits are stored in 64 bit words allocated by allocator, rebound to
+// std::uint64_t(see huge_page_allocator.hpp for large filters).
+template <bloom_hasher hasher = murmur3, typename index = modulo_index, typename stats_policy = no_stats, typename allocator = aligned_allocator<std::uint64_t, 64>>
 class bloom_filter
 {
 public:
@@ -160,18 +653,21 @@ public:
 
     bloom_filter& operator=(const bloom_filter& other) = default;
 
-    bloom_filter(bloom_filter&& other)
+    bloom_filter(bloom_filter&& other) noexcept
         : m(other.m)
         , k(other.k)
         , n(other.n)
         , p(other.p)
+        , counters(other.counters)
     {
-        if (!other.bits.empty())
-            std::swap(bits, other.bits);
+        if (!other.words.empty())
+            std::swap(words, other.words);
+        std::swap(changed, other.changed);
         other.m = other.k = other.n = other.p = 0;
+        other.counters = stats_policy {};
     }
 
-    bloom_filter& operator=(bloom_filter&& other)
+    bloom_filter& operator=(bloom_filter&& other) noexcept
     {
         if (this != &other)
         {
@@ -179,47 +675,52 @@ public:
             k = other.k;
             n = other.n;
             p = other.p;
+            counters = other.counters;
 
-            if (!other.bits.empty())
+            if (!other.words.empty())
             {
-                std::swap(bits, other.bits);
-                other.bits.clear(); // in case it is not empty
+                std::swap(words, other.words);
+                other.words.clear(); // in case it is not empty
             }
+            changed = std::move(other.changed);
+            other.changed.clear();
             other.m = other.k = other.n = other.p = 0;
+            other.counters = stats_policy {};
         }
         return *this;
     }
 
+    // m is rounded up to what the index policy supports.
     bool config(std::uint64_t m, std::uint64_t k, std::uint64_t n)
     {
-        if (m == 0 || k == 0 || n == 0)
+        if (index::round_m(m) == 0 || k == 0 || n == 0)
             return false;
 
-        this->m = m;
+        this->m = index::round_m(m);
         this->k = k;
         this->n = n;
-        this->p = compute_p(m, k, n);
+        this->p = compute_p(this->m, k, n);
 
-        const std::uint64_t byte_count = m / 8 + static_cast<bool>(m & 7);
-        bits.clear();
-        bits.resize(byte_count > 0 ? byte_count : 1, 0);
+        words.assign(this->m / 64 + static_cast<bool>(this->m & 63), 0);
+        counters = stats_policy {};
+        reset_changes();
 
         return true;
     }
 
+    // false_positive() may be lower than p, see compute_m_k.
     bool config(std::uint64_t n, double p)
     {
         if (p >= 1.0 || p <= 0.0 || n == 0)
             return false;
 
+        if (!compute_m_k<index>(n, p, m, k, this->p))
+            return false;
         this->n = n;
-        this->p = p;
-        m       = compute_m(n, p);
-        k       = compute_k(m, n);
 
-        const std::uint64_t byte_count = m / 8 + static_cast<bool>(m & 7);
-        bits.clear();
-        bits.resize(byte_count > 0 ? byte_count : 1, 0);
+        words.assign(m / 64 + static_cast<bool>(m & 63), 0);
+        counters = stats_policy {};
+        reset_changes();
 
         return true;
     }
@@ -233,7 +734,7 @@ public:
               const std::uint8_t* raw,
               std::uint64_t       raw_size)
     {
-        if (p >= 1.0 || p <= 0.0 || n == 0)
+        if (p >= 1.0 || p <= 0.0 || n == 0 || index::round_m(m) != m)
             return false;
 
         const std::uint64_t byte_count = m / 8 + static_cast<bool>(m & 7);
@@ -245,9 +746,29 @@ public:
         this->m = m;
         this->k = k;
 
-        bits.clear();
-        bits.reserve(raw_size);
-        std::copy(raw, raw + raw_size, std::back_inserter(bits));
+        words.assign(m / 64 + static_cast<bool>(m & 63), 0);
+        std::memcpy(words.data(), raw, raw_size);
+        counters = stats_policy {};
+        reset_changes();
+
+        return true;
+    }
+
+    // Create an empty bf with the components of an existing one, e.g. to fill
+    // it block by block with merge_block instead of from a copy of raw().
+    bool from(std::uint64_t m, std::uint64_t k, std::uint64_t n, double p)
+    {
+        if (p >= 1.0 || p <= 0.0 || n == 0 || k == 0 || m == 0 || index::round_m(m) != m)
+            return false;
+
+        this->n = n;
+        this->p = p;
+        this->m = m;
+        this->k = k;
+
+        words.assign(m / 64 + static_cast<bool>(m & 63), 0);
+        counters = stats_policy {};
+        reset_changes();
 
         return true;
     }
@@ -260,13 +781,19 @@ public:
 
     double false_positive() const { return p; }
 
-    std::size_t size() const { return bits.size(); } // in bytes
+    std::size_t size() const // in bytes
+    {
+        if (words.empty())
+            return 0;
+        return m / 8 + static_cast<bool>(m & 7);
+    }
 
+    // The words as size() bytes, bit i of the filter is bit i % 8 of byte i / 8.
     const std::uint8_t* raw() const
     {
-        if (bits.empty())
+        if (words.empty())
             return nullptr;
-        return bits.data();
+        return reinterpret_cast<const std::uint8_t*>(words.data());
     }
 
     bool add(const void* key, const std::uint64_t len)
@@ -274,19 +801,14 @@ public:
         if (m == 0 || k == 0 || n == 0 || p == 0.0)
             return false;
 
-        hashes hash_values;
-        hash_values.reserve(k);
-        h(key, len, k, hash_values);
-
-        if (k != hash_values.size())
+        if (!for_each_hash(h, key, len, k, [this](std::uint64_t hash) {
+                const std::uint64_t abs_bit_id = idx(hash, m);
+                set_bit(abs_bit_id);
+                return true;
+            }))
             return false;
 
-        for (std::uint64_t i = 0; i < k; ++i)
-        {
-            const std::uint64_t abs_bit_id = hash_values[i] % m;
-            const std::uint64_t byte_id    = abs_bit_id / 8;
-            bits[byte_id] |= BIT_POS[abs_bit_id & 7];
-        }
+        counters.inserted(1);
         return true;
     }
 
@@ -295,63 +817,534 @@ public:
         if (m == 0 || k == 0 || n == 0 || p == 0.0)
             return false;
 
-        hashes hash_values;
-        hash_values.reserve(k);
-        h(key, len, k, hash_values);
+        const bool found = for_each_hash(h, key, len, k, [this](std::uint64_t hash) {
+            const std::uint64_t abs_bit_id = idx(hash, m);
+            return (words[abs_bit_id / 64] >> (abs_bit_id & 63)) & 1;
+        });
+        counters.queried(1, found);
+        return found;
+    }
+
+    // Typed keys, the same as add(&key, sizeof(key)) but hashed with the
+    // length fixed at compile time(see for_each_hash<len>). Note that an int
+    // and a std::uint64_t with the same value are different keys.
+    template <trivial_key T>
+    bool add(const T& key)
+    {
+        if (m == 0 || k == 0 || n == 0 || p == 0.0)
+            return false;
+
+        if (!for_each_hash<sizeof(T)>(h, &key, k, [this](std::uint64_t hash) {
+                const std::uint64_t abs_bit_id = idx(hash, m);
+                set_bit(abs_bit_id);
+                return true;
+            }))
+            return false;
+
+        counters.inserted(1);
+        return true;
+    }
+
+    template <trivial_key T>
+    bool contains(const T& key) const
+    {
+        if (m == 0 || k == 0 || n == 0 || p == 0.0)
+            return false;
+
+        const bool found = for_each_hash<sizeof(T)>(h, &key, k, [this](std::uint64_t hash) {
+            const std::uint64_t abs_bit_id = idx(hash, m);
+            return (words[abs_bit_id / 64] >> (abs_bit_id & 63)) & 1;
+        });
+        counters.queried(1, found);
+        return found;
+    }
+
+    // The characters of a string, string literals included.
+    bool add(std::string_view key) { return add(key.data(), key.size()); }
+
+    bool contains(std::string_view key) const { return contains(key.data(), key.size()); }
+
+    bool add(std::span<const std::byte> key) { return add(key.data(), key.size()); }
+
+    bool contains(std::span<const std::byte> key) const { return contains(key.data(), key.size()); }
+
+    // For keys whose base hashes the caller already has, e.g. because they
+    // picked a filter by them. Same as add/contains of the key for hashers
+    // that return hash128.
+    bool add_hash(const hash128& base)
+    {
+        if (m == 0 || k == 0 || n == 0 || p == 0.0)
+            return false;
+
+        probe_sequence probes(base);
+        for (std::uint64_t i = 0; i < k; ++i)
+        {
+            const std::uint64_t abs_bit_id = idx(probes.next(), m);
+            set_bit(abs_bit_id);
+        }
+        counters.inserted(1);
+        return true;
+    }
 
-        if (k != hash_values.size())
+    bool contains_hash(const hash128& base) const
+    {
+        if (m == 0 || k == 0 || n == 0 || p == 0.0)
             return false;
 
+        probe_sequence probes(base);
         for (std::uint64_t i = 0; i < k; ++i)
         {
-            const std::uint64_t abs_bit_id = hash_values[i] % m;
-            const std::uint64_t byte_id    = abs_bit_id / 8;
-            if (!(bits[byte_id] & BIT_POS[abs_bit_id & 7]))
+            const std::uint64_t abs_bit_id = idx(probes.next(), m);
+            if (!((words[abs_bit_id / 64] >> (abs_bit_id & 63)) & 1))
+            {
+                counters.queried(1, 0);
                 return false;
+            }
         }
+        counters.queried(1, 1);
         return true;
     }
 
+    // Adds count keys in one go. The bit ids of as many keys as fit in
+    // BATCH_PROBES are computed and prefetched first and only then set, so the
+    // cache misses of neighbouring keys overlap.
+    bool add_many(const void* const* keys, const std::uint64_t* lens, std::uint64_t count)
+    {
+        if (!keys || !lens)
+            return false;
+
+        return add_batched(
+            count,
+            [keys, lens](std::uint64_t i) { return std::make_pair(keys[i], lens[i]); },
+            [this, keys, lens](std::uint64_t first, std::uint64_t batch_count, hash128* out) {
+                hash_each(keys + first, lens + first, batch_count, out);
+            });
+    }
+
+    // Same as above for count keys of len bytes each stored back to back,
+    // e.g. an array of fixed width ids. Hashers with a hash_many(murmur3) hash
+    // several keys per instruction.
+    bool add_many(const void* keys, std::uint64_t len, std::uint64_t count)
+    {
+        if (!keys)
+            return false;
+
+        const std::uint8_t* data = static_cast<const std::uint8_t*>(keys);
+        return add_batched(
+            count,
+            [data, len](std::uint64_t i) { return std::make_pair(static_cast<const void*>(data + i * len), len); },
+            [this, data, len](std::uint64_t first, std::uint64_t batch_count, hash128* out) {
+                hash_fixed(data + first * len, len, batch_count, out);
+            });
+    }
+
+    // Checks count keys in one go. Bit i of out_bitmap(LSB first, so
+    // (count + 7) / 8 bytes are written) is set when keys[i] might be in the
+    // filter. The keys are hashed a batch at a time and resolved in rounds:
+    // round i tests the i-th probe of every key still in the running and
+    // prefetches the next probe of the survivors, so the cache misses of
+    // neighbouring keys overlap and misses stop costing memory traffic as soon
+    // as they are decided.
+    bool contains_many(const void* const*    keys,
+                       const std::uint64_t* lens,
+                       std::uint64_t        count,
+                       std::uint8_t*        out_bitmap) const
+    {
+        if (!keys || !lens)
+            return false;
+
+        return contains_batched(
+            count,
+            [keys, lens](std::uint64_t i) { return std::make_pair(keys[i], lens[i]); },
+            [this, keys, lens](std::uint64_t first, std::uint64_t batch_count, hash128* out) {
+                hash_each(keys + first, lens + first, batch_count, out);
+            },
+            out_bitmap);
+    }
+
+    // Same as above for count keys of len bytes each stored back to back.
+    bool contains_many(const void*   keys,
+                       std::uint64_t len,
+                       std::uint64_t count,
+                       std::uint8_t* out_bitmap) const
+    {
+        if (!keys)
+            return false;
+
+        const std::uint8_t* data = static_cast<const std::uint8_t*>(keys);
+        return contains_batched(
+            count,
+            [data, len](std::uint64_t i) { return std::make_pair(static_cast<const void*>(data + i * len), len); },
+            [this, data, len](std::uint64_t first, std::uint64_t batch_count, hash128* out) {
+                hash_fixed(data + first * len, len, batch_count, out);
+            },
+            out_bitmap);
+    }
+
+    // Union: afterwards the filter contains the keys of both.
     bool merge(const bloom_filter& other)
     {
-        if (m == 0 || k == 0 || n == 0 || p == 0.0)
+        if (!compatible(other))
             return false;
 
-        if (m != other.m || k != other.k || n != other.n
-            || p != other.p || bits.size() != other.bits.size())
+        simd::or_words(words.data(), other.words.data(), words.size());
+        counters.written();
+        change_all();
+        return true;
+    }
+
+    // Intersection: afterwards the filter contains the keys that were in
+    // both. Its false positive rate is at most that of either filter, but
+    // higher than that of a filter built from the common keys only.
+    bool intersect(const bloom_filter& other)
+    {
+        if (!compatible(other))
             return false;
 
-        for (std::uint64_t i = 0; i < bits.size(); ++i)
-            bits[i] |= other.bits[i];
+        simd::and_words(words.data(), other.words.data(), words.size());
+        counters.written();
+        change_all();
+        return true;
+    }
 
+    // The number of bits that are set.
+    std::uint64_t popcount() const
+    {
+        if (words.empty())
+            return 0;
+
+        std::uint64_t count = simd::popcount_words(words.data(), words.size());
+        // from() may have been handed set bits past m
+        if (m & 63)
+            count -= std::popcount(words.back() >> (m & 63));
+        return count;
+    }
+
+    double fill_ratio() const
+    {
+        if (m == 0)
+            return 0.0;
+        return static_cast<double>(popcount()) / m;
+    }
+
+    // Estimated number of distinct keys that were added(Swamidass, Baldi:
+    // "Mathematical correction for fingerprint similarity measures"):
+    // -m / k * ln(1 - set bits / m). A filter with all bits set could hold
+    // any number of keys, that is reported as the largest uint64_t.
+    std::uint64_t approx_size() const
+    {
+        if (m == 0 || k == 0)
+            return 0;
+
+        return elements_for(popcount());
+    }
+
+    // The counters of the stats policy and what the bits say right now, see
+    // filter_stats. Under no_stats the counters stay 0 and the bits are
+    // counted on every call, under counting_stats only after a write.
+    filter_stats stats() const
+    {
+        filter_stats out;
+        if (m == 0 || k == 0)
+            return out;
+
+        if constexpr (stats_policy::enabled)
+        {
+            out.inserts   = counters.inserts;
+            out.queries   = counters.queries;
+            out.positives = counters.positives;
+            if (out.queries > 0)
+                out.positive_rate = static_cast<double>(out.positives) / out.queries;
+
+            if (!counters.set_bits_valid)
+            {
+                counters.set_bits       = popcount();
+                counters.set_bits_valid = true;
+            }
+            out.set_bits = counters.set_bits;
+        }
+        else
+            out.set_bits = popcount();
+
+        out.fill_ratio               = static_cast<double>(out.set_bits) / m;
+        out.estimated_false_positive = std::pow(out.fill_ratio, static_cast<double>(k));
+        out.estimated_elements       = elements_for(out.set_bits);
+        return out;
+    }
+
+    // Change tracking for replication(see bloom_filter_stream.hpp). The bits
+    // are cut into blocks of BLOCK_BYTES bytes of raw(), the last one may be
+    // shorter. Once track_changes() is called every block that add, merge,
+    // intersect or merge_block writes to is marked until clear_changes().
+    static constexpr std::uint64_t BLOCK_BYTES = 4096;
+
+    std::uint64_t block_count() const { return size() / BLOCK_BYTES + static_cast<bool>(size() % BLOCK_BYTES); }
+
+    // The number of bytes of block i.
+    std::uint64_t block_size(std::uint64_t i) const
+    {
+        if (i >= block_count())
+            return 0;
+        return std::min(BLOCK_BYTES, size() - i * BLOCK_BYTES);
+    }
+
+    // Starts tracking with every block unchanged. Costs a bit per block and
+    // a well predicted branch per probe while off.
+    bool track_changes()
+    {
+        if (words.empty())
+            return false;
+
+        changed.assign(block_count() / 64 + static_cast<bool>(block_count() & 63), 0);
+        return true;
+    }
+
+    bool tracking_changes() const { return !changed.empty(); }
+
+    bool block_changed(std::uint64_t i) const
+    {
+        if (i >= block_count() || changed.empty())
+            return false;
+        return (changed[i / 64] >> (i & 63)) & 1;
+    }
+
+    std::uint64_t changed_block_count() const
+    {
+        std::uint64_t count = 0;
+        for (const std::uint64_t word : changed)
+            count += std::popcount(word);
+        return count;
+    }
+
+    void clear_changes() { std::fill(changed.begin(), changed.end(), 0); }
+
+    // ORs size bytes into block i, size has to be block_size(i). The
+    // counterpart of reading block i out of raw() on another filter of the
+    // same shape.
+    bool merge_block(std::uint64_t i, const std::uint8_t* bytes, std::uint64_t size)
+    {
+        if (!bytes || size == 0 || size != block_size(i))
+            return false;
+
+        alignas(64) std::uint64_t block[BLOCK_BYTES / 8] = {};
+        std::memcpy(block, bytes, size);
+        simd::or_words(words.data() + i * (BLOCK_BYTES / 8), block, size / 8 + static_cast<bool>(size & 7));
+        counters.written();
+        if (!changed.empty())
+            changed[i / 64] |= std::uint64_t(1) << (i & 63);
         return true;
     }
 
 private:
     static constexpr std::uint8_t BIT_POS[8] = { 0x1u, 0x2u, 0x4u, 0x8u, 0x10u, 0x20u, 0x40u, 0x80u };
 
-    std::uint64_t             m; // size in bits
-    std::uint64_t             k; // number of hashes
-    std::uint64_t             n; // expected number of elements
-    double                    p; // false positive probability(> 0 && < 1)
-    std::vector<std::uint8_t> bits;
-    hasher                    h;
+    typedef typename std::allocator_traits<allocator>::template rebind_alloc<std::uint64_t> word_allocator;
+
+    std::uint64_t                                                    m; // size in bits
+    std::uint64_t                                                    k; // number of hashes
+    std::uint64_t                                                    n; // expected number of elements
+    double                                                           p; // false positive probability(> 0 && < 1)
+    std::vector<std::uint64_t, word_allocator>                       words; // bit i is bit i % 64 of word i / 64
+    hasher                                                           h;
+    index                                                            idx;
+    [[no_unique_address]] mutable stats_policy                       counters; // contains counts queries
+    std::vector<std::uint64_t>                                       changed; // bit i is set when block i was written, empty when not tracking
 
-    inline std::uint64_t compute_m(std::uint64_t n, double p) const
+    void set_bit(std::uint64_t bit_id)
     {
-        return std::ceil((n * std::log(p)) / std::log(1.0 / std::pow(2.0, std::log(2.0))));
+        words[bit_id / 64] |= std::uint64_t(1) << (bit_id & 63);
+        if (!changed.empty()) [[unlikely]]
+            changed[bit_id / (BLOCK_BYTES * 8 * 64)] |= std::uint64_t(1) << ((bit_id / (BLOCK_BYTES * 8)) & 63);
     }
 
-    inline std::uint64_t compute_k(std::uint64_t m, std::uint64_t n) const
+    void change_all()
     {
-        return std::round((static_cast<double>(m) / n) * std::log(2.0));
+        if (changed.empty())
+            return;
+        std::fill(changed.begin(), changed.end(), ~std::uint64_t(0));
+        if (block_count() & 63)
+            changed.back() = (std::uint64_t(1) << (block_count() & 63)) - 1;
     }
 
-    inline double compute_p(std::uint64_t m, std::uint64_t k, std::uint64_t n) const
+    // keeps tracking on for the new bits, if it was
+    void reset_changes()
     {
-        return std::pow(1.0 - std::exp((-static_cast<double>(k) * n) / m), k);
+        if (!changed.empty())
+            changed.assign(block_count() / 64 + static_cast<bool>(block_count() & 63), 0);
+    }
+
+    // approx_size for a number of set bits
+    std::uint64_t elements_for(std::uint64_t set) const
+    {
+        if (set >= m)
+            return std::numeric_limits<std::uint64_t>::max();
+        return std::llround(-static_cast<double>(m) / k * std::log1p(-static_cast<double>(set) / m));
+    }
+
+    bool compatible(const bloom_filter& other) const
+    {
+        if (m == 0 || k == 0 || n == 0 || p == 0.0)
+            return false;
+
+        return m == other.m && k == other.k && n == other.n
+            && p == other.p && words.size() == other.words.size();
+    }
+
+    // keys in flight in contains_many
+    static constexpr std::uint64_t BATCH_KEYS = 64;
+    // bit ids computed and prefetched ahead of resolving them in add_many
+    static constexpr std::uint64_t BATCH_PROBES = 256;
+
+    static constexpr bool returns_hash128 = requires(const hasher& h, const void* key, std::uint64_t len) {
+        { h(key, len) } -> std::convertible_to<hash128>;
+    };
+
+    // Only reached for hashers returning hash128, the checks keep the batch
+    // drivers compiling for the others.
+    void hash_each(const void* const* keys, const std::uint64_t* lens, std::uint64_t count, hash128* out) const
+    {
+        if constexpr (returns_hash128)
+        {
+            for (std::uint64_t i = 0; i < count; ++i)
+                out[i] = h(keys[i], lens[i]);
+        }
+    }
+
+    void hash_fixed(const std::uint8_t* keys, std::uint64_t len, std::uint64_t count, hash128* out) const
+    {
+        if constexpr (requires { h.hash_many(keys, len, count, out); })
+            h.hash_many(keys, len, count, out);
+        else if constexpr (returns_hash128)
+        {
+            for (std::uint64_t i = 0; i < count; ++i)
+                out[i] = h(keys + i * len, len);
+        }
+    }
+
+    // key_at(i) returns the (pointer, length) of the i-th key and is only used
+    // for hashers that cannot be batched, hash_batch(first, count, out) hashes
+    // count keys starting at first.
+    template <typename key_getter, typename batch_hasher>
+    bool add_batched(std::uint64_t count, key_getter&& key_at, batch_hasher&& hash_batch)
+    {
+        if (m == 0 || k == 0 || n == 0 || p == 0.0)
+            return false;
+
+        if constexpr (returns_hash128)
+        {
+            if (k <= BATCH_PROBES)
+            {
+                const std::uint64_t batch_size = BATCH_PROBES / k;
+                hash128             base[BATCH_PROBES];
+                std::uint64_t       bit_ids[BATCH_PROBES];
+                for (std::uint64_t first = 0; first < count; first += batch_size)
+                {
+                    const std::uint64_t batch_count = std::min(batch_size, count - first);
+                    hash_batch(first, batch_count, base);
+                    for (std::uint64_t j = 0; j < batch_count; ++j)
+                    {
+                        probe_sequence probes(base[j]);
+                        for (std::uint64_t i = 0; i < k; ++i)
+                        {
+                            bit_ids[j * k + i] = idx(probes.next(), m);
+                            __builtin_prefetch(words.data() + bit_ids[j * k + i] / 64, 1);
+                        }
+                    }
+
+                    for (std::uint64_t i = 0; i < batch_count * k; ++i)
+                        set_bit(bit_ids[i]);
+                }
+                counters.inserted(count);
+                return true;
+            }
+        }
+
+        bool ok = true;
+        for (std::uint64_t i = 0; i < count; ++i)
+        {
+            const auto [key, len] = key_at(i);
+            ok &= add(key, len);
+        }
+        return ok;
+    }
+
+    template <typename key_getter, typename batch_hasher>
+    bool contains_batched(std::uint64_t count, key_getter&& key_at, batch_hasher&& hash_batch, std::uint8_t* out_bitmap) const
+    {
+        if (!out_bitmap)
+            return false;
+
+        std::fill(out_bitmap, out_bitmap + count / 8 + static_cast<bool>(count & 7), 0);
+
+        if (m == 0 || k == 0 || n == 0 || p == 0.0)
+            return false;
+
+        if constexpr (returns_hash128)
+        {
+            struct pending
+            {
+                probe_sequence probes;
+                std::uint64_t  bit_id;
+                std::uint64_t  id;
+            };
+
+            hash128 base[BATCH_KEYS];
+            pending batch[BATCH_KEYS];
+            std::uint64_t positives = 0;
+            for (std::uint64_t first = 0; first < count; first += BATCH_KEYS)
+            {
+                std::uint64_t alive = std::min(BATCH_KEYS, count - first);
+                hash_batch(first, alive, base);
+                for (std::uint64_t j = 0; j < alive; ++j)
+                {
+                    batch[j] = { probe_sequence(base[j]), 0, first + j };
+                    batch[j].bit_id = idx(batch[j].probes.next(), m);
+                    __builtin_prefetch(words.data() + batch[j].bit_id / 64, 0);
+                }
+
+                for (std::uint64_t i = 1; i <= k && alive > 0; ++i)
+                {
+                    std::uint64_t survivors = 0;
+                    for (std::uint64_t j = 0; j < alive; ++j)
+                    {
+                        pending& key = batch[j];
+                        if (!((words[key.bit_id / 64] >> (key.bit_id & 63)) & 1))
+                            continue;
+
+                        if (i == k)
+                        {
+                            out_bitmap[key.id / 8] |= BIT_POS[key.id & 7];
+                            ++positives;
+                            continue;
+                        }
+
+                        key.bit_id = idx(key.probes.next(), m);
+                        __builtin_prefetch(words.data() + key.bit_id / 64, 0);
+                        batch[survivors++] = key;
+                    }
+                    alive = survivors;
+                }
+            }
+            counters.queried(count, positives);
+        }
+        else
+        {
+            // hashers that do not return hash128 cannot be batched
+            for (std::uint64_t i = 0; i < count; ++i)
+            {
+                const auto [key, len] = key_at(i);
+                if (contains(key, len))
+                    out_bitmap[i / 8] |= BIT_POS[i & 7];
+            }
+        }
+        return true;
     }
 };
 
+// Containers of filters(the stages of scalable_bloom_filter, the shards of
+// partitioned_bloom_filter) move them when they grow instead of copying the
+// bits, which needs the moves to be noexcept.
+static_assert(std::is_nothrow_move_constructible_v<bloom_filter<>> && std::is_nothrow_move_assignable_v<bloom_filter<>>);
+
 } // BF
 #endif // BLOOM_FILTER_HPP
@@ -0,0 +1,310 @@
+#ifndef BLOOM_FILTER_STREAM_HPP
+#define BLOOM_FILTER_STREAM_HPP
+
+#include "mapped_bloom_filter.hpp"
+
+namespace BF
+{
+
+// Streaming serialization of a bloom_filter, for shipping filters between
+// replicas without a second copy of the bits. Writers hand their output to a
+// sink, any callable
+//   bool sink(const std::uint8_t* data, std::size_t size)
+// that returns false to give up(e.g. a socket or file write). Readers pull
+// their input from a source, any callable
+//   std::size_t source(std::uint8_t* data, std::size_t size)
+// that fills up to size bytes and returns how many, 0 at the end of the input
+// or on an error. Besides the filter itself neither side holds more than a
+// block(bloom_filter::BLOCK_BYTES) at a time.
+
+// bytes handed to the sink at a time by write_filter
+constexpr std::uint64_t STREAM_CHUNK = 1 << 20;
+
+// A source that reads size bytes at data.
+struct memory_source
+{
+    const std::uint8_t* data;
+    std::size_t         size;
+
+    std::size_t operator()(std::uint8_t* out, std::size_t count)
+    {
+        count = std::min(count, size);
+        std::memcpy(out, data, count);
+        data += count;
+        size -= count;
+        return count;
+    }
+};
+
+// Reads exactly size bytes from in.
+template <typename source>
+bool read_exact(source& in, void* data, std::size_t size)
+{
+    std::uint8_t* bytes = static_cast<std::uint8_t*>(data);
+    while (size > 0)
+    {
+        const std::size_t count = in(bytes, size);
+        if (count == 0 || count > size)
+            return false;
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+// Writes bf as save() would write it to a file: the file_header followed by
+// raw(), chunk bytes at a time. What is written to a file can be opened by
+// mapped_bloom_filter.
+template <typename hasher, typename index, typename stats_policy, typename allocator, typename sink>
+bool write_filter(const bloom_filter<hasher, index, stats_policy, allocator>& bf, sink&& out, std::uint64_t chunk = STREAM_CHUNK)
+{
+    if (!bf.raw() || chunk == 0)
+        return false;
+
+    const file_header header = make_header(bf);
+    if (!out(reinterpret_cast<const std::uint8_t*>(&header), sizeof(header)))
+        return false;
+
+    for (std::uint64_t offset = 0; offset < bf.size(); offset += chunk)
+    {
+        if (!out(bf.raw() + offset, std::min<std::uint64_t>(chunk, bf.size() - offset)))
+            return false;
+    }
+    return true;
+}
+
+// Reads a filter written by write_filter or save() into bf. The bits go
+// straight into bf a block at a time, unlike from() there is no buffer of
+// the whole filter. On failure(a different hasher or index policy, a short
+// input or a checksum mismatch) bf is left empty.
+template <typename hasher, typename index, typename stats_policy, typename allocator, typename source>
+bool read_filter(bloom_filter<hasher, index, stats_policy, allocator>& bf, source&& in)
+{
+    // copied, moving an empty filter in keeps the bits
+    auto fail = [&bf]() {
+        const bloom_filter<hasher, index, stats_policy, allocator> empty;
+        bf = empty;
+        return false;
+    };
+
+    file_header header;
+    if (!read_exact(in, &header, sizeof(header)) || !readable_header<hasher, index>(header)
+        || !bf.from(header.m, header.k, header.n, header.p))
+        return fail();
+
+    std::uint8_t block[bloom_filter<hasher, index, stats_policy, allocator>::BLOCK_BYTES];
+    for (std::uint64_t i = 0; i < bf.block_count(); ++i)
+    {
+        if (!read_exact(in, block, bf.block_size(i)) || !bf.merge_block(i, block, bf.block_size(i)))
+            return fail();
+    }
+
+    if (file_checksum(bf.raw(), bf.size()) != header.checksum)
+        return fail();
+    return true;
+}
+
+// A delta is this header followed by block_count blocks, each a delta_block
+// and size bytes of payload. It carries the current contents of the blocks
+// that changed, so applying it ORs them in and applying it twice, or out of
+// order with other deltas, does no harm.
+struct delta_header
+{
+    char          magic[8]; // DELTA_MAGIC
+    std::uint32_t version;  // DELTA_VERSION
+    std::uint32_t hasher_id;
+    std::uint32_t seed;
+    std::uint32_t index_id; // id of the index policy
+    std::uint64_t m;
+    std::uint64_t k;
+    std::uint64_t block_count;
+};
+
+static_assert(sizeof(delta_header) == 48);
+
+enum class delta_encoding : std::uint32_t
+{
+    raw        = 0, // the bytes of the block
+    run_length = 1, // see encode_runs
+};
+
+struct delta_block
+{
+    std::uint64_t  index; // of the block in the filter
+    delta_encoding encoding;
+    std::uint32_t  size;     // of the payload
+    std::uint64_t  checksum; // file_checksum of the bytes of the block
+};
+
+static_assert(sizeof(delta_block) == 24);
+
+constexpr char          DELTA_MAGIC[8] = { 'B', 'F', 'D', 'E', 'L', 'T', 'A', '\0' };
+constexpr std::uint32_t DELTA_VERSION  = 1;
+
+// Run length encoding for the zeros of sparse blocks: a sequence of runs,
+// each a std::uint16_t count of zero bytes, a std::uint16_t count of literal
+// bytes and the literal bytes. Zero runs shorter than MIN_ZERO_RUN stay in
+// the literals. Returns the encoded size, or 0 if it would exceed capacity.
+constexpr std::size_t MIN_ZERO_RUN = 4;
+
+inline std::size_t encode_runs(const std::uint8_t* block, std::size_t size, std::uint8_t* out, std::size_t capacity)
+{
+    std::size_t read    = 0;
+    std::size_t written = 0;
+    while (read < size)
+    {
+        std::size_t zeros = 0;
+        while (read + zeros < size && block[read + zeros] == 0)
+            ++zeros;
+        read += zeros;
+
+        // the literals end at the next long enough run of zeros
+        std::size_t end = read;
+        while (end < size)
+        {
+            if (block[end] != 0)
+            {
+                ++end;
+                continue;
+            }
+
+            std::size_t run = 0;
+            while (end + run < size && run < MIN_ZERO_RUN && block[end + run] == 0)
+                ++run;
+            if (run == MIN_ZERO_RUN || end + run == size)
+                break;
+            end += run;
+        }
+
+        const std::uint16_t counts[2] = { static_cast<std::uint16_t>(zeros), static_cast<std::uint16_t>(end - read) };
+        if (written + sizeof(counts) + counts[1] > capacity)
+            return 0;
+        std::memcpy(out + written, counts, sizeof(counts));
+        std::memcpy(out + written + sizeof(counts), block + read, counts[1]);
+        written += sizeof(counts) + counts[1];
+        read = end;
+    }
+    return written;
+}
+
+// Decodes size bytes of runs into exactly block_size bytes at block.
+inline bool decode_runs(const std::uint8_t* runs, std::size_t size, std::uint8_t* block, std::size_t block_size)
+{
+    std::size_t read    = 0;
+    std::size_t written = 0;
+    while (read < size)
+    {
+        std::uint16_t counts[2];
+        if (size - read < sizeof(counts))
+            return false;
+        std::memcpy(counts, runs + read, sizeof(counts));
+        read += sizeof(counts);
+
+        if (counts[0] > block_size - written || counts[1] > block_size - written - counts[0] || counts[1] > size - read)
+            return false;
+        std::memset(block + written, 0, counts[0]);
+        written += counts[0];
+        std::memcpy(block + written, runs + read, counts[1]);
+        written += counts[1];
+        read += counts[1];
+    }
+    return written == block_size;
+}
+
+// Writes the blocks of bf that changed since track_changes() or the last
+// write_delta, each run length encoded when compress is set and that makes
+// it smaller. The changes are cleared once all of it was written, on
+// failure they are kept for the next try.
+template <typename hasher, typename index, typename stats_policy, typename allocator, typename sink>
+bool write_delta(bloom_filter<hasher, index, stats_policy, allocator>& bf, sink&& out, bool compress = true)
+{
+    if (!bf.tracking_changes())
+        return false;
+
+    delta_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, DELTA_MAGIC, sizeof(DELTA_MAGIC));
+    header.version     = DELTA_VERSION;
+    header.hasher_id   = hasher_id<hasher>();
+    header.seed        = hasher_seed<hasher>();
+    header.index_id    = index::id;
+    header.m           = bf.bit_count();
+    header.k           = bf.hash_count();
+    header.block_count = bf.changed_block_count();
+    if (!out(reinterpret_cast<const std::uint8_t*>(&header), sizeof(header)))
+        return false;
+
+    std::uint8_t runs[bloom_filter<hasher, index, stats_policy, allocator>::BLOCK_BYTES];
+    for (std::uint64_t i = 0; i < bf.block_count(); ++i)
+    {
+        if (!bf.block_changed(i))
+            continue;
+
+        const std::uint8_t* bytes  = bf.raw() + i * bf.BLOCK_BYTES;
+        delta_block         record = { i, delta_encoding::raw, static_cast<std::uint32_t>(bf.block_size(i)), file_checksum(bytes, bf.block_size(i)) };
+        const std::uint8_t* payload = bytes;
+        if (compress)
+        {
+            const std::size_t encoded = encode_runs(bytes, bf.block_size(i), runs, bf.block_size(i) - 1);
+            if (encoded > 0)
+            {
+                record.encoding = delta_encoding::run_length;
+                record.size     = encoded;
+                payload         = runs;
+            }
+        }
+
+        if (!out(reinterpret_cast<const std::uint8_t*>(&record), sizeof(record)) || !out(payload, record.size))
+            return false;
+    }
+
+    bf.clear_changes();
+    return true;
+}
+
+// ORs a delta written by write_delta into bf, which needs the same hasher,
+// index policy, m and k as the filter it was written from. Every block is
+// checked against its checksum before it is merged. On failure the blocks
+// before the bad one stay merged, which is harmless: they only add keys of
+// the source.
+template <typename hasher, typename index, typename stats_policy, typename allocator, typename source>
+bool apply_delta(bloom_filter<hasher, index, stats_policy, allocator>& bf, source&& in)
+{
+    delta_header header;
+    if (!bf.raw() || !read_exact(in, &header, sizeof(header)))
+        return false;
+
+    if (std::memcmp(header.magic, DELTA_MAGIC, sizeof(DELTA_MAGIC)) != 0 || header.version != DELTA_VERSION
+        || header.hasher_id != hasher_id<hasher>() || header.seed != hasher_seed<hasher>() || header.index_id != index::id
+        || header.m != bf.bit_count() || header.k != bf.hash_count())
+        return false;
+
+    std::uint8_t payload[bloom_filter<hasher, index, stats_policy, allocator>::BLOCK_BYTES];
+    std::uint8_t block[bloom_filter<hasher, index, stats_policy, allocator>::BLOCK_BYTES];
+    for (std::uint64_t b = 0; b < header.block_count; ++b)
+    {
+        delta_block record;
+        if (!read_exact(in, &record, sizeof(record)))
+            return false;
+
+        const std::uint64_t size = bf.block_size(record.index);
+        if (size == 0 || record.size > size || !read_exact(in, payload, record.size))
+            return false;
+
+        if (record.encoding == delta_encoding::raw)
+        {
+            if (record.size != size)
+                return false;
+            std::memcpy(block, payload, size);
+        }
+        else if (record.encoding != delta_encoding::run_length || !decode_runs(payload, record.size, block, size))
+            return false;
+
+        if (file_checksum(block, size) != record.checksum || !bf.merge_block(record.index, block, size))
+            return false;
+    }
+    return true;
+}
+
+} // BF
+#endif // BLOOM_FILTER_STREAM_HPP
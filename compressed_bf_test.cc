@@ -0,0 +1,167 @@
+#include "compressed_bloom_filter.hpp"
+#include "hashers.hpp"
+#include <gtest/gtest.h>
+#include <random>
+
+namespace BF
+{
+
+TEST(compressed_bf_test, rice_codes)
+{
+    std::mt19937_64 rng(7);
+    for (const unsigned r : { 0u, 1u, 5u, 20u, 56u })
+    {
+        std::vector<std::uint64_t> gaps;
+        for (int i = 0; i < 1000; ++i)
+            gaps.push_back(rng() >> (i % 3 == 0 ? 64 - r - 8 : 63 - r)); // some quotients past 64 zeros
+        gaps.push_back(0);
+
+        rice_writer writer(r);
+        for (const std::uint64_t gap : gaps)
+            writer.put(gap);
+        const std::uint64_t               bits  = writer.bit_count();
+        const std::vector<std::uint64_t>& words = writer.finish();
+        EXPECT_EQ(words.size(), (bits + 63) / 64 + 1);
+
+        rice_reader reader(reinterpret_cast<const std::uint8_t*>(words.data()), bits, r);
+        for (const std::uint64_t expected : gaps)
+        {
+            std::uint64_t gap = 0;
+            ASSERT_TRUE(reader.next(gap));
+            ASSERT_EQ(gap, expected) << "r " << r;
+        }
+        std::uint64_t gap = 0;
+        EXPECT_FALSE(reader.next(gap));
+    }
+}
+
+TEST(compressed_bf_test, sparse_filter)
+{
+    // sized for 100000 keys, holding 2000
+    BF::bloom_filter<> bf;
+    ASSERT_TRUE(bf.config(100000, 0.01));
+    for (std::uint64_t i = 0; i < 2000; ++i)
+        ASSERT_TRUE(bf.add(i));
+
+    const std::vector<std::uint8_t> form = compress(bf);
+    EXPECT_LT(form.size() * 5, bf.size());
+
+    BF::compressed_bloom_filter<> compressed;
+    ASSERT_TRUE(compressed.from(form.data(), form.size()));
+    EXPECT_TRUE(compressed.is_compressed());
+    EXPECT_EQ(compressed.size(), form.size());
+    EXPECT_GT(compressed.compression_ratio(), 5.0);
+    EXPECT_EQ(compressed.bit_count(), bf.bit_count());
+    EXPECT_EQ(compressed.hash_count(), bf.hash_count());
+    EXPECT_EQ(compressed.expected_elements(), 100000);
+    EXPECT_EQ(compressed.false_positive(), bf.false_positive());
+    EXPECT_EQ(compressed.popcount(), bf.popcount());
+    EXPECT_TRUE(compressed.verify());
+
+    // the same answers as the filter, false positives included
+    for (std::uint64_t i = 0; i < 2000; ++i)
+        ASSERT_TRUE(compressed.contains(i));
+    for (std::uint64_t i = 2000; i < 200000; ++i)
+        ASSERT_EQ(compressed.contains(&i, sizeof(i)), bf.contains(i)) << i;
+    ASSERT_TRUE(bf.add("key"));
+    EXPECT_FALSE(compressed.contains("key"));
+
+    BF::bloom_filter<> copy;
+    ASSERT_TRUE(decompress(copy, form.data(), form.size()));
+    EXPECT_EQ(copy.bit_count(), bf.bit_count());
+    EXPECT_EQ(copy.expected_elements(), 100000);
+    for (std::uint64_t i = 0; i < 2000; ++i)
+        ASSERT_TRUE(copy.contains(i));
+    EXPECT_FALSE(copy.contains("key"));
+
+    // fewer samples, a smaller form
+    const std::vector<std::uint8_t> coarse = compress(bf, 1024);
+    EXPECT_LT(coarse.size(), form.size());
+    ASSERT_TRUE(compressed.from(coarse.data(), coarse.size()));
+    for (std::uint64_t i = 0; i < 2000; ++i)
+        ASSERT_TRUE(compressed.contains(i));
+    EXPECT_TRUE(compressed.contains("key"));
+}
+
+TEST(compressed_bf_test, dense_and_empty)
+{
+    // a full filter is no smaller coded, it is sent as is
+    BF::bloom_filter<BF::murmur3, BF::pow2_index> full;
+    ASSERT_TRUE(full.config(1000, 0.01));
+    for (std::uint64_t i = 0; i < 1000; ++i)
+        ASSERT_TRUE(full.add(i));
+
+    std::vector<std::uint8_t> form = compress(full);
+    EXPECT_EQ(form.size(), sizeof(compressed_header) + full.size());
+
+    BF::compressed_bloom_filter<BF::murmur3, BF::pow2_index> compressed;
+    ASSERT_TRUE(compressed.from(form.data(), form.size()));
+    EXPECT_FALSE(compressed.is_compressed());
+    EXPECT_EQ(compressed.popcount(), full.popcount());
+    for (std::uint64_t i = 0; i < 1000; ++i)
+        ASSERT_TRUE(compressed.contains(i));
+
+    BF::bloom_filter<BF::murmur3, BF::pow2_index> copy;
+    ASSERT_TRUE(decompress(copy, form.data(), form.size()));
+    EXPECT_EQ(std::memcmp(copy.raw(), full.raw(), full.size()), 0);
+
+    // an m that is not a whole number of bytes, with no bits set
+    BF::bloom_filter<> empty;
+    ASSERT_TRUE(empty.config(1001, 3, 100));
+    form = compress(empty);
+    EXPECT_EQ(form.size(), sizeof(compressed_header) + 8 + 8); // one sample, the padding word
+
+    BF::compressed_bloom_filter<> none;
+    ASSERT_TRUE(none.from(form.data(), form.size()));
+    EXPECT_TRUE(none.is_compressed());
+    EXPECT_EQ(none.popcount(), 0);
+    EXPECT_FALSE(none.contains(std::uint64_t(1)));
+
+    BF::bloom_filter<> restored;
+    ASSERT_TRUE(decompress(restored, form.data(), form.size()));
+    EXPECT_EQ(restored.bit_count(), 1001);
+    EXPECT_EQ(restored.popcount(), 0);
+
+    BF::bloom_filter<> unset;
+    EXPECT_TRUE(compress(unset).empty());
+}
+
+TEST(compressed_bf_test, bad_input)
+{
+    BF::bloom_filter<> bf;
+    ASSERT_TRUE(bf.config(10000, 0.01));
+    for (std::uint64_t i = 0; i < 100; ++i)
+        ASSERT_TRUE(bf.add(i));
+    std::vector<std::uint8_t> form = compress(bf);
+
+    // a different hasher or a truncated form
+    BF::compressed_bloom_filter<BF::xxh3> other;
+    EXPECT_FALSE(other.from(form.data(), form.size()));
+    BF::compressed_bloom_filter<> compressed;
+    EXPECT_FALSE(compressed.from(form.data(), form.size() - 1));
+    EXPECT_FALSE(compressed.from(form.data(), 10));
+    EXPECT_FALSE(compressed.contains(std::uint64_t(1)));
+
+    BF::bloom_filter<> copy;
+    ASSERT_TRUE(copy.config(10, 0.01));
+    EXPECT_FALSE(decompress(copy, form.data(), form.size() - 8));
+    EXPECT_EQ(copy.raw(), nullptr);
+
+    // a flipped bit in the codes reads, but does not match the checksum
+    form[form.size() - 24] ^= 0x10;
+    ASSERT_TRUE(compressed.from(form.data(), form.size()));
+    EXPECT_FALSE(compressed.verify());
+    EXPECT_FALSE(decompress(copy, form.data(), form.size()));
+    EXPECT_EQ(copy.raw(), nullptr);
+
+    // samples out of order
+    form = compress(bf, 8);
+    std::uint64_t samples[2];
+    std::memcpy(samples, form.data() + sizeof(compressed_header), sizeof(samples));
+    ASSERT_LT(samples[0], samples[1]);
+    std::swap(samples[0], samples[1]);
+    std::memcpy(form.data() + sizeof(compressed_header), samples, sizeof(samples));
+    EXPECT_FALSE(compressed.from(form.data(), form.size()));
+}
+
+} // BF
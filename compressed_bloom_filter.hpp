@@ -0,0 +1,572 @@
+#ifndef COMPRESSED_BLOOM_FILTER_HPP
+#define COMPRESSED_BLOOM_FILTER_HPP
+
+#include "mapped_bloom_filter.hpp"
+
+namespace BF
+{
+
+// Compressed transport form of a bloom_filter. A filter configured for far
+// more keys than it holds is mostly zero bits; compress() codes the gaps
+// between its set bits with Golomb-Rice codes instead of shipping raw(),
+// and compressed_bloom_filter answers contains directly on that form.
+//
+// The form is a compressed_header followed by either the bytes of raw()
+// (compressed_encoding::raw, when coding would not make it smaller) or
+//   - a sample for every bucket of 2^sample_shift bits of raw(): the
+//     std::uint64_t offset in bits of the first code of that bucket, so a
+//     lookup indexes the samples with its bit and decodes from there
+//   - the gap codes, stream_bits bits in little endian 64 bit words plus one
+//     zero word of padding
+// A gap is the number of zero bits before a set bit since the previous one
+// or the start of its bucket. Its code is gap >> rice_bits in unary(that
+// many zero bits and a one) followed by the low rice_bits bits of the gap.
+enum class compressed_encoding : std::uint32_t
+{
+    raw  = 0, // the bytes of raw()
+    rice = 1, // samples and gap codes
+};
+
+struct compressed_header
+{
+    char                magic[8]; // COMPRESSED_MAGIC
+    std::uint32_t       version;  // COMPRESSED_VERSION
+    compressed_encoding encoding;
+    std::uint64_t       ones; // set bits
+    std::uint32_t       rice_bits;
+    std::uint32_t       sample_shift; // log2 of the bits per sample
+    std::uint64_t       stream_bits;
+    file_header         filter; // as save() writes it, the checksum is of raw()
+};
+
+static_assert(sizeof(compressed_header) == 104);
+
+constexpr char          COMPRESSED_MAGIC[8] = { 'B', 'F', 'R', 'I', 'C', 'E', '\0', '\0' };
+constexpr std::uint32_t COMPRESSED_VERSION  = 1;
+
+// set bits per sample on average: a lookup decodes about half of them, and
+// a sample costs 64 bits, spread over that many set bits
+constexpr std::uint64_t COMPRESSED_SAMPLE = 32;
+
+// Appends Golomb-Rice codes to a bit stream.
+class rice_writer
+{
+public:
+    explicit rice_writer(unsigned rice_bits)
+        : bits(0)
+        , r(rice_bits)
+    {
+    }
+
+    std::uint64_t bit_count() const { return bits; }
+
+    void put(std::uint64_t gap)
+    {
+        bits += gap >> r; // the zeros are already there
+        put_bits(1, 1);
+        if (r > 0)
+            put_bits(gap & ((std::uint64_t(1) << r) - 1), r);
+    }
+
+    // The stream with its padding word.
+    std::vector<std::uint64_t>& finish()
+    {
+        words.resize((bits + 63) / 64 + 1, 0);
+        return words;
+    }
+
+private:
+    std::vector<std::uint64_t> words;
+    std::uint64_t              bits;
+    unsigned                   r;
+
+    void put_bits(std::uint64_t value, unsigned count)
+    {
+        const std::uint64_t i     = bits / 64;
+        const unsigned      shift = bits & 63;
+        if (words.size() < i + 2)
+            words.resize(std::max(i + 2, words.size() * 2), 0);
+        words[i] |= value << shift;
+        if (shift + count > 64)
+            words[i + 1] |= value >> (64 - shift);
+        bits += count;
+    }
+};
+
+// Reads the codes rice_writer wrote from words(no alignment needed) of a
+// stream of bits bits plus the padding word.
+class rice_reader
+{
+public:
+    rice_reader(const std::uint8_t* words, std::uint64_t bits, unsigned rice_bits, std::uint64_t offset = 0)
+        : stream(words)
+        , bits(bits)
+        , offset(offset)
+        , r(rice_bits)
+    {
+    }
+
+    std::uint64_t bit_offset() const { return offset; }
+
+    // false past the end of the stream
+    bool next(std::uint64_t& gap)
+    {
+        if (offset >= bits)
+            return false;
+
+        // most codes fit in the next 64 bits
+        const std::uint64_t w = peek();
+        if (w != 0)
+        {
+            const unsigned zeros = std::countr_zero(w);
+            if (zeros + 1 + r <= 64)
+            {
+                const std::uint64_t low = r ? (w >> (zeros + 1)) & ((std::uint64_t(1) << r) - 1) : 0;
+                gap                     = (static_cast<std::uint64_t>(zeros) << r) | low;
+                offset += zeros + 1 + r;
+                return offset <= bits;
+            }
+        }
+
+        std::uint64_t q = 0;
+        while (true)
+        {
+            if (offset >= bits)
+                return false;
+            const std::uint64_t w = peek();
+            if (w != 0)
+            {
+                const unsigned zeros = std::countr_zero(w);
+                q += zeros;
+                offset += zeros + 1;
+                break;
+            }
+            q += 64;
+            offset += 64;
+        }
+        if (offset > bits)
+            return false;
+
+        std::uint64_t low = 0;
+        if (r > 0)
+        {
+            low = peek() & ((std::uint64_t(1) << r) - 1);
+            offset += r;
+        }
+        gap = (q << r) | low;
+        return offset <= bits;
+    }
+
+private:
+    const std::uint8_t* stream;
+    std::uint64_t       bits;
+    std::uint64_t       offset;
+    unsigned            r;
+
+    std::uint64_t word(std::uint64_t i) const
+    {
+        std::uint64_t v;
+        std::memcpy(&v, stream + i * 8, sizeof(v));
+        return v;
+    }
+
+    // the 64 bits at offset, offset < bits
+    std::uint64_t peek() const
+    {
+        const std::uint64_t i     = offset / 64;
+        const unsigned      shift = offset & 63;
+        const std::uint64_t low   = word(i) >> shift;
+        return shift ? low | (word(i + 1) << (64 - shift)) : low;
+    }
+};
+
+// The 8 bytes of raw() that hold bits [64 * i, 64 * i + 64), zero past size.
+inline std::uint64_t load_word(const std::uint8_t* bytes, std::uint64_t size, std::uint64_t i)
+{
+    std::uint64_t v = 0;
+    std::memcpy(&v, bytes + i * 8, std::min<std::uint64_t>(8, size - i * 8));
+    return v;
+}
+
+// The rice parameter for gaps between ones set bits out of universe. The
+// gaps are about geometric, for those 2^r close to ln(2) times the mean gap
+// is optimal.
+inline unsigned rice_bits_for(std::uint64_t universe, std::uint64_t ones)
+{
+    if (ones == 0)
+        return 0;
+    const double scaled = std::log(2.0) * universe / ones;
+    return scaled < 2.0 ? 0 : std::min<unsigned>(std::floor(std::log2(scaled)), 56);
+}
+
+// The sample shift for about per_sample of ones set bits out of universe
+// per bucket.
+inline unsigned sample_shift_for(std::uint64_t universe, std::uint64_t ones, std::uint64_t per_sample)
+{
+    if (ones == 0)
+        return 63;
+    return std::bit_width(std::max<std::uint64_t>(1, universe / ones * per_sample)) - 1;
+}
+
+// The number of samples that follow a header.
+inline std::uint64_t sample_count(const compressed_header& header)
+{
+    const std::uint64_t bytes = header.filter.m / 8 + static_cast<bool>(header.filter.m & 7);
+    return ((bytes * 8 - 1) >> header.sample_shift) + 1;
+}
+
+// The payload bytes that follow a header, 0 if it is not consistent.
+inline std::uint64_t compressed_payload(const compressed_header& header)
+{
+    const std::uint64_t bytes = header.filter.m / 8 + static_cast<bool>(header.filter.m & 7);
+    if (header.encoding == compressed_encoding::raw)
+        return bytes;
+    if (header.encoding != compressed_encoding::rice || header.ones > bytes * 8 || header.sample_shift > 63
+        || header.rice_bits > 56 || header.stream_bits > bytes * 8 * 64)
+        return 0;
+
+    return sample_count(header) * 8 + ((header.stream_bits + 63) / 64 + 1) * 8;
+}
+
+// Whether a filter of this hasher and index policy can read the form that
+// follows header, size is that of the whole form.
+template <typename hasher, typename index>
+bool readable_compressed(const compressed_header& header, std::uint64_t size)
+{
+    if (std::memcmp(header.magic, COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC)) != 0 || header.version != COMPRESSED_VERSION
+        || !readable_header<hasher, index>(header.filter))
+        return false;
+    const std::uint64_t payload = compressed_payload(header);
+    return payload != 0 && size - sizeof(header) == payload;
+}
+
+// The compressed form of bf. Raw bits when the codes would not be smaller,
+// e.g. past a fill ratio of about 15%. per_sample, the average number of set
+// bits per sample, trades size for lookup speed in compressed_bloom_filter.
+// Empty if bf is.
+template <typename hasher, typename index, typename stats_policy, typename allocator>
+std::vector<std::uint8_t> compress(const bloom_filter<hasher, index, stats_policy, allocator>& bf, std::uint64_t per_sample = COMPRESSED_SAMPLE)
+{
+    std::vector<std::uint8_t> out;
+    if (!bf.raw() || per_sample == 0)
+        return out;
+
+    const std::uint8_t* bytes = bf.raw();
+    const std::uint64_t size  = bf.size();
+    const std::uint64_t count = size / 8 + static_cast<bool>(size & 7);
+
+    compressed_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC));
+    header.version  = COMPRESSED_VERSION;
+    header.encoding = compressed_encoding::rice;
+    header.filter   = make_header(bf);
+    for (std::uint64_t i = 0; i < count; ++i)
+        header.ones += std::popcount(load_word(bytes, size, i));
+    header.rice_bits    = rice_bits_for(size * 8, header.ones);
+    header.sample_shift = sample_shift_for(size * 8, header.ones, per_sample);
+
+    // bits past m are coded too, so decoding gives back raw() byte for byte
+    std::vector<std::uint64_t> samples;
+    rice_writer                writer(header.rice_bits);
+    std::uint64_t              base  = 0;
+    std::uint64_t              coded = 0;
+    for (std::uint64_t i = 0; i < count; ++i)
+    {
+        for (std::uint64_t w = load_word(bytes, size, i); w != 0; w &= w - 1)
+        {
+            const std::uint64_t position = i * 64 + std::countr_zero(w);
+            while (samples.size() <= position >> header.sample_shift)
+            {
+                base = samples.size() << header.sample_shift;
+                samples.push_back(writer.bit_count());
+            }
+            writer.put(position - base);
+            base = position + 1;
+            ++coded;
+        }
+
+        // the codes are already as large as the bits, stop early
+        if (writer.bit_count() / 8 + samples.size() * 8 >= size)
+            break;
+    }
+    header.stream_bits = writer.bit_count();
+    samples.resize(sample_count(header), writer.bit_count());
+
+    const std::uint64_t coded_size = compressed_payload(header);
+    if (coded == header.ones && coded_size < size)
+    {
+        const std::vector<std::uint64_t>& words = writer.finish();
+        out.resize(sizeof(header) + coded_size);
+        std::memcpy(out.data(), &header, sizeof(header));
+        std::memcpy(out.data() + sizeof(header), samples.data(), samples.size() * 8);
+        std::memcpy(out.data() + sizeof(header) + samples.size() * 8, words.data(), words.size() * 8);
+    }
+    else
+    {
+        header.encoding    = compressed_encoding::raw;
+        header.stream_bits = 0;
+        out.resize(sizeof(header) + size);
+        std::memcpy(out.data(), &header, sizeof(header));
+        std::memcpy(out.data() + sizeof(header), bytes, size);
+    }
+    return out;
+}
+
+// Restores a filter from what compress() returned. The bits are decoded a
+// block(bloom_filter::BLOCK_BYTES) at a time straight into bf and checked
+// against the checksum of the original. On failure(a different hasher or
+// index policy, a truncated or corrupt form) bf is left empty.
+template <typename hasher, typename index, typename stats_policy, typename allocator>
+bool decompress(bloom_filter<hasher, index, stats_policy, allocator>& bf, const std::uint8_t* data, std::size_t size)
+{
+    // copied, moving an empty filter in keeps the bits
+    auto fail = [&bf]() {
+        const bloom_filter<hasher, index, stats_policy, allocator> empty;
+        bf = empty;
+        return false;
+    };
+
+    compressed_header header;
+    if (!data || size < sizeof(header))
+        return fail();
+    std::memcpy(&header, data, sizeof(header));
+    if (!readable_compressed<hasher, index>(header, size)
+        || !bf.from(header.filter.m, header.filter.k, header.filter.n, header.filter.p))
+        return fail();
+
+    const std::uint8_t* payload = data + sizeof(header);
+    if (header.encoding == compressed_encoding::raw)
+    {
+        for (std::uint64_t i = 0; i < bf.block_count(); ++i)
+        {
+            if (!bf.merge_block(i, payload + i * bf.BLOCK_BYTES, bf.block_size(i)))
+                return fail();
+        }
+    }
+    else
+    {
+        const std::uint64_t samples = sample_count(header);
+        rice_reader         reader(payload + samples * 8, header.stream_bits, header.rice_bits);
+
+        std::uint8_t  block[bloom_filter<hasher, index, stats_policy, allocator>::BLOCK_BYTES];
+        std::uint64_t position = 0;
+        std::uint64_t decoded  = 0;
+        std::uint64_t bucket   = 0;     // the next bucket to start
+        bool          pending  = false; // position is a set bit that is not written yet
+        for (std::uint64_t i = 0; i < bf.block_count(); ++i)
+        {
+            const std::uint64_t first = i * bf.BLOCK_BYTES * 8;
+            const std::uint64_t last  = first + bf.block_size(i) * 8;
+            std::memset(block, 0, bf.block_size(i));
+            while (true)
+            {
+                if (!pending)
+                {
+                    std::uint64_t gap = 0;
+                    if (decoded == header.ones)
+                        break;
+
+                    // the gaps of a bucket start at the bucket, empty buckets
+                    // have the same offset as the next one
+                    for (std::uint64_t offset = 0; bucket < samples; ++bucket)
+                    {
+                        std::memcpy(&offset, payload + bucket * 8, sizeof(offset));
+                        if (offset > reader.bit_offset())
+                            break;
+                        if ((bucket << header.sample_shift) < position)
+                            return fail();
+                        position = bucket << header.sample_shift;
+                    }
+                    if (!reader.next(gap) || gap > bf.size() * 8 - position)
+                        return fail();
+                    position += gap;
+                    ++decoded;
+                    pending = true;
+                }
+                if (position >= last)
+                    break;
+                block[(position - first) / 8] |= std::uint8_t(1) << (position & 7);
+                ++position;
+                pending = false;
+            }
+            if (!bf.merge_block(i, block, bf.block_size(i)))
+                return fail();
+        }
+        if (pending)
+            return fail();
+    }
+
+    if (file_checksum(bf.raw(), bf.size()) != header.filter.checksum)
+        return fail();
+    return true;
+}
+
+// Read only bloom filter on the form compress() returns, without
+// decompressing it. A probe picks the sample of the bucket its bit is in and
+// decodes forward from there until it reaches the bit, about half of the
+// codes of the bucket; a miss usually stops at the first or second probe.
+// A lookup costs far more than in bloom_filter, in exchange the filter
+// takes its compressed size in memory.
+template <bloom_hasher hasher = murmur3, typename index = modulo_index>
+class compressed_bloom_filter
+{
+public:
+    compressed_bloom_filter()
+    {
+        std::memset(&header, 0, sizeof(header));
+    }
+
+    // Copies the form, fails if it is not one or was written with a
+    // different hasher or index policy. The bits are not checked, call
+    // verify() for that.
+    bool from(const std::uint8_t* data, std::size_t size)
+    {
+        clear();
+        compressed_header read;
+        if (!data || size < sizeof(read))
+            return false;
+        std::memcpy(&read, data, sizeof(read));
+        if (!readable_compressed<hasher, index>(read, size))
+            return false;
+
+        const std::uint8_t* payload = data + sizeof(read);
+        std::uint64_t       stream  = size - sizeof(read);
+        if (read.encoding == compressed_encoding::rice)
+        {
+            samples.resize(sample_count(read));
+            std::memcpy(samples.data(), payload, samples.size() * 8);
+            payload += samples.size() * 8;
+            stream -= samples.size() * 8;
+
+            for (std::uint64_t i = 0; i < samples.size(); ++i)
+            {
+                if (samples[i] > read.stream_bits || (i == 0 ? samples[i] != 0 : samples[i] < samples[i - 1]))
+                {
+                    clear();
+                    return false;
+                }
+            }
+        }
+
+        words.assign(stream / 8 + static_cast<bool>(stream & 7), 0);
+        std::memcpy(words.data(), payload, stream);
+        header = read;
+        return true;
+    }
+
+    void clear()
+    {
+        std::memset(&header, 0, sizeof(header));
+        samples.clear();
+        words.clear();
+    }
+
+    // Decodes all of the bits, so it costs as much as decompress.
+    bool verify() const
+    {
+        if (words.empty())
+            return false;
+
+        bloom_filter<hasher, index>     bf;
+        const std::vector<std::uint8_t> form = to_bytes();
+        return decompress(bf, form.data(), form.size());
+    }
+
+    std::uint64_t bit_count() const { return header.filter.m; }
+
+    std::uint64_t hash_count() const { return header.filter.k; }
+
+    std::uint64_t expected_elements() const { return header.filter.n; }
+
+    double false_positive() const { return header.filter.p; }
+
+    std::uint64_t popcount() const { return header.encoding == compressed_encoding::rice ? header.ones : count_raw(); }
+
+    bool is_compressed() const { return header.encoding == compressed_encoding::rice; }
+
+    // of the compressed form, in bytes
+    std::size_t size() const { return words.empty() ? 0 : sizeof(header) + samples.size() * 8 + payload_size(); }
+
+    // The bytes of raw() over size().
+    double compression_ratio() const
+    {
+        if (words.empty())
+            return 0.0;
+        return static_cast<double>(header.filter.m / 8 + static_cast<bool>(header.filter.m & 7)) / size();
+    }
+
+    bool contains(const void* key, const std::uint64_t len) const
+    {
+        if (words.empty())
+            return false;
+
+        return for_each_hash(h, key, len, header.filter.k, [this](std::uint64_t hash) { return test(idx(hash, header.filter.m)); });
+    }
+
+    // Typed keys, see bloom_filter.
+    template <trivial_key T>
+    bool contains(const T& key) const
+    {
+        if (words.empty())
+            return false;
+
+        return for_each_hash<sizeof(T)>(h, &key, header.filter.k, [this](std::uint64_t hash) { return test(idx(hash, header.filter.m)); });
+    }
+
+    bool contains(std::string_view key) const { return contains(key.data(), key.size()); }
+
+    bool contains(std::span<const std::byte> key) const { return contains(key.data(), key.size()); }
+
+private:
+    compressed_header          header;
+    std::vector<std::uint64_t> samples; // offsets of the buckets in the stream
+    std::vector<std::uint64_t> words; // the gap codes or the bits
+    hasher                     h;
+    index                      idx;
+
+    bool test(std::uint64_t bit) const
+    {
+        if (header.encoding == compressed_encoding::raw)
+            return (words[bit / 64] >> (bit & 63)) & 1;
+
+        const std::uint64_t bucket = bit >> header.sample_shift;
+        const std::uint64_t end    = bucket + 1 < samples.size() ? samples[bucket + 1] : header.stream_bits;
+        std::uint64_t       base   = bucket << header.sample_shift;
+        rice_reader         reader(reinterpret_cast<const std::uint8_t*>(words.data()), header.stream_bits, header.rice_bits, samples[bucket]);
+        for (std::uint64_t gap = 0; reader.bit_offset() < end && reader.next(gap);)
+        {
+            if (base + gap >= bit)
+                return base + gap == bit;
+            base += gap + 1;
+        }
+        return false;
+    }
+
+    std::uint64_t count_raw() const
+    {
+        std::uint64_t count = 0;
+        for (const std::uint64_t w : words)
+            count += std::popcount(w);
+        return count;
+    }
+
+    std::vector<std::uint8_t> to_bytes() const
+    {
+        std::vector<std::uint8_t> out(sizeof(header) + samples.size() * 8 + payload_size());
+        std::memcpy(out.data(), &header, sizeof(header));
+        std::memcpy(out.data() + sizeof(header), samples.data(), samples.size() * 8);
+        std::memcpy(out.data() + sizeof(header) + samples.size() * 8, words.data(), payload_size());
+        return out;
+    }
+
+    std::uint64_t payload_size() const
+    {
+        if (header.encoding == compressed_encoding::raw)
+            return header.filter.m / 8 + static_cast<bool>(header.filter.m & 7);
+        return words.size() * 8;
+    }
+};
+
+} // BF
+#endif // COMPRESSED_BLOOM_FILTER_HPP
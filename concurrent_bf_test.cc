@@ -0,0 +1,109 @@
+#include "concurrent_bloom_filter.hpp"
+#include "huge_page_allocator.hpp"
+#include <cstring>
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace BF
+{
+
+TEST(concurrent_bf_test, matches_bloom_filter)
+{
+    BF::bloom_filter            bf;
+    BF::concurrent_bloom_filter cbf;
+    ASSERT_TRUE(bf.config(10000, 0.01));
+    ASSERT_TRUE(cbf.config(10000, 0.01));
+    EXPECT_EQ(cbf.bit_count(), bf.bit_count());
+    EXPECT_EQ(cbf.hash_count(), bf.hash_count());
+    EXPECT_EQ(cbf.size(), bf.size());
+
+    for (std::uint64_t i = 0; i < 10000; ++i)
+    {
+        ASSERT_TRUE(bf.add(&i, sizeof(i)));
+        ASSERT_TRUE(cbf.add(&i, sizeof(i)));
+    }
+    for (std::uint64_t i = 0; i < 20000; ++i)
+        EXPECT_EQ(cbf.contains(&i, sizeof(i)), bf.contains(&i, sizeof(i)));
+
+    const auto snapshot = cbf.snapshot();
+    ASSERT_EQ(snapshot.size(), bf.size());
+    EXPECT_EQ(std::memcmp(snapshot.raw(), bf.raw(), bf.size()), 0);
+
+    BF::concurrent_bloom_filter copy;
+    ASSERT_TRUE(copy.from(bf.bit_count(), bf.hash_count(), bf.expected_elements(), bf.false_positive(), bf.raw(), bf.size()));
+    EXPECT_EQ(std::memcmp(copy.snapshot().raw(), bf.raw(), bf.size()), 0);
+
+    BF::concurrent_bloom_filter moved = std::move(copy);
+    EXPECT_EQ(copy.bit_count(), 0);
+    EXPECT_FALSE(copy.contains("a", 1));
+    EXPECT_EQ(moved.bit_count(), bf.bit_count());
+
+    BF::concurrent_bloom_filter empty;
+    EXPECT_FALSE(empty.add("a", 1));
+    EXPECT_FALSE(empty.contains("a", 1));
+    EXPECT_FALSE(empty.merge(bf));
+    EXPECT_EQ(empty.snapshot().raw(), nullptr);
+
+    // filters with another stats policy or allocator merge the same way
+    BF::bloom_filter<BF::murmur3, BF::modulo_index, BF::counting_stats>                                   counted;
+    BF::bloom_filter<BF::murmur3, BF::modulo_index, BF::no_stats, BF::huge_page_allocator<std::uint64_t>> huge;
+    ASSERT_TRUE(counted.config(10000, 0.01));
+    ASSERT_TRUE(huge.config(10000, 0.01));
+    ASSERT_TRUE(counted.add("counted"));
+    ASSERT_TRUE(huge.add("huge"));
+    ASSERT_TRUE(cbf.merge(counted));
+    ASSERT_TRUE(cbf.merge(huge));
+    EXPECT_TRUE(cbf.contains("counted", 7));
+    EXPECT_TRUE(cbf.contains("huge", 4));
+}
+
+TEST(concurrent_bf_test, stress)
+{
+    constexpr std::uint64_t THREADS     = 8;
+    constexpr std::uint64_t PER_THREAD  = 50000;
+    constexpr std::uint64_t ALL_ELEMENTS = THREADS * PER_THREAD;
+
+    BF::concurrent_bloom_filter cbf;
+    ASSERT_TRUE(cbf.config(ALL_ELEMENTS, 0.01));
+
+    // the same keys merged in from outside while everybody is busy
+    BF::bloom_filter offline;
+    ASSERT_TRUE(offline.config(ALL_ELEMENTS, 0.01));
+    for (std::uint64_t i = ALL_ELEMENTS; i < ALL_ELEMENTS + PER_THREAD; ++i)
+        ASSERT_TRUE(offline.add(&i, sizeof(i)));
+
+    std::atomic<std::uint64_t> lost { 0 };
+    std::vector<std::thread>   threads;
+    for (std::uint64_t t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([&cbf, &lost, t] {
+            for (std::uint64_t i = t * PER_THREAD; i < (t + 1) * PER_THREAD; ++i)
+            {
+                cbf.add(&i, sizeof(i));
+                // our own adds have to be visible right away
+                if (!cbf.contains(&i, sizeof(i)))
+                    lost++;
+                // and a concurrent add on the same word must not wipe an older bit
+                const std::uint64_t older = t * PER_THREAD + (i - t * PER_THREAD) / 2;
+                if (!cbf.contains(&older, sizeof(older)))
+                    lost++;
+            }
+        });
+    }
+    threads.emplace_back([&cbf, &offline] { cbf.merge(offline); });
+    for (auto& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(lost.load(), 0);
+    for (std::uint64_t i = 0; i < ALL_ELEMENTS + PER_THREAD; ++i)
+        ASSERT_TRUE(cbf.contains(&i, sizeof(i)));
+
+    // the result does not depend on the interleaving
+    BF::bloom_filter sequential;
+    ASSERT_TRUE(sequential.config(ALL_ELEMENTS, 0.01));
+    for (std::uint64_t i = 0; i < ALL_ELEMENTS + PER_THREAD; ++i)
+        ASSERT_TRUE(sequential.add(&i, sizeof(i)));
+    EXPECT_EQ(std::memcmp(cbf.snapshot().raw(), sequential.raw(), sequential.size()), 0);
+}
+
+} // BF
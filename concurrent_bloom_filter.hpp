@@ -0,0 +1,249 @@
+#ifndef CONCURRENT_BLOOM_FILTER_HPP
+#define CONCURRENT_BLOOM_FILTER_HPP
+
+#include "bloom_filter.hpp"
+#include <atomic>
+#include <memory>
+
+namespace BF
+{
+
+// Bloom filter that can be shared between threads without a lock.
+// The bits live in 64 bit atomic words: add sets them with a relaxed
+// fetch_or, contains is wait-free and only loads, and merge ORs another
+// filter in word by word while readers and writers keep going. A key added
+// by a thread is visible to that thread immediately and to others once the
+// stores propagate, which is the same guarantee a bloom filter behind a
+// mutex gives to a reader that took the lock first.
+// config/from are not thread safe and must happen before the filter is
+// shared. The bit layout matches bloom_filter byte for byte.
+template <bloom_hasher hasher = murmur3, typename index = modulo_index>
+class concurrent_bloom_filter
+{
+public:
+    concurrent_bloom_filter()
+        : m(0)
+        , k(0)
+        , n(0)
+        , p(0.0)
+        , word_count(0)
+    {
+    }
+
+    concurrent_bloom_filter(const concurrent_bloom_filter& other) = delete;
+
+    concurrent_bloom_filter& operator=(const concurrent_bloom_filter& other) = delete;
+
+    concurrent_bloom_filter(concurrent_bloom_filter&& other)
+        : m(other.m)
+        , k(other.k)
+        , n(other.n)
+        , p(other.p)
+        , word_count(other.word_count)
+        , words(std::move(other.words))
+    {
+        other.m = other.k = other.n = other.p = other.word_count = 0;
+    }
+
+    concurrent_bloom_filter& operator=(concurrent_bloom_filter&& other)
+    {
+        if (this != &other)
+        {
+            m          = other.m;
+            k          = other.k;
+            n          = other.n;
+            p          = other.p;
+            word_count = other.word_count;
+            words      = std::move(other.words);
+
+            other.m = other.k = other.n = other.p = other.word_count = 0;
+        }
+        return *this;
+    }
+
+    // Sized exactly like bloom_filter::config.
+    bool config(std::uint64_t m, std::uint64_t k, std::uint64_t n)
+    {
+        if (index::round_m(m) == 0 || k == 0 || n == 0)
+            return false;
+
+        this->m = index::round_m(m);
+        this->k = k;
+        this->n = n;
+        this->p = compute_p(this->m, k, n);
+        allocate();
+
+        return true;
+    }
+
+    bool config(std::uint64_t n, double p)
+    {
+        if (p >= 1.0 || p <= 0.0 || n == 0)
+            return false;
+
+        if (!compute_m_k<index>(n, p, m, k, this->p))
+            return false;
+        this->n = n;
+        allocate();
+
+        return true;
+    }
+
+    // Create a bf from the components of an existing one.
+    // Deep copies the values from the raw byte pointer.
+    bool from(std::uint64_t       m,
+              std::uint64_t       k,
+              std::uint64_t       n,
+              double              p,
+              const std::uint8_t* raw,
+              std::uint64_t       raw_size)
+    {
+        if (p >= 1.0 || p <= 0.0 || n == 0 || index::round_m(m) != m)
+            return false;
+
+        const std::uint64_t byte_count = m / 8 + static_cast<bool>(m & 7);
+        if (!raw || raw_size == 0 || byte_count != raw_size)
+            return false;
+
+        this->n = n;
+        this->p = p;
+        this->m = m;
+        this->k = k;
+        allocate();
+
+        for (std::uint64_t i = 0; i < word_count; ++i)
+            words[i].store(load_word(raw, raw_size, i), std::memory_order_relaxed);
+
+        return true;
+    }
+
+    std::uint64_t bit_count() const { return m; }
+
+    std::uint64_t hash_count() const { return k; }
+
+    std::uint64_t expected_elements() const { return n; }
+
+    double false_positive() const { return p; }
+
+    std::size_t size() const { return m / 8 + static_cast<bool>(m & 7); } // in bytes
+
+    // A point in time copy of the bits as a plain bloom_filter, e.g. to
+    // serialize it through raw(). Concurrent adds may or may not be part of it.
+    bloom_filter<hasher, index> snapshot() const
+    {
+        bloom_filter<hasher, index> out;
+        if (m == 0 || !out.from(m, k, n, p))
+            return out;
+
+        // straight into the bits of out a block at a time, the block buffer
+        // stays in L1
+        constexpr std::uint64_t   BLOCK_WORDS = bloom_filter<hasher, index>::BLOCK_BYTES / 8;
+        alignas(64) std::uint64_t block[BLOCK_WORDS];
+        for (std::uint64_t b = 0; b < out.block_count(); ++b)
+        {
+            const std::uint64_t first = b * BLOCK_WORDS;
+            const std::uint64_t count = std::min(BLOCK_WORDS, word_count - first);
+            for (std::uint64_t i = 0; i < count; ++i)
+                block[i] = words[first + i].load(std::memory_order_relaxed);
+            out.merge_block(b, reinterpret_cast<const std::uint8_t*>(block), out.block_size(b));
+        }
+        return out;
+    }
+
+    bool add(const void* key, const std::uint64_t len)
+    {
+        if (m == 0 || k == 0 || n == 0 || p == 0.0)
+            return false;
+
+        return for_each_hash(h, key, len, k, [this](std::uint64_t hash) {
+            const std::uint64_t abs_bit_id = idx(hash, m);
+            const std::uint64_t mask       = std::uint64_t(1) << (abs_bit_id & 63);
+            std::atomic<std::uint64_t>& word = words[abs_bit_id / 64];
+            // a plain load keeps the cache line shared when the bit is already set
+            if (!(word.load(std::memory_order_relaxed) & mask))
+                word.fetch_or(mask, std::memory_order_relaxed);
+            return true;
+        });
+    }
+
+    bool contains(const void* key, const std::uint64_t len) const
+    {
+        if (m == 0 || k == 0 || n == 0 || p == 0.0)
+            return false;
+
+        return for_each_hash(h, key, len, k, [this](std::uint64_t hash) {
+            const std::uint64_t abs_bit_id = idx(hash, m);
+            return (words[abs_bit_id / 64].load(std::memory_order_relaxed) & (std::uint64_t(1) << (abs_bit_id & 63))) != 0;
+        });
+    }
+
+    // Safe to call while other threads add to or query this filter.
+    bool merge(const concurrent_bloom_filter& other)
+    {
+        if (m == 0 || k == 0 || n == 0 || p == 0.0)
+            return false;
+
+        if (m != other.m || k != other.k || n != other.n || p != other.p)
+            return false;
+
+        for (std::uint64_t i = 0; i < word_count; ++i)
+        {
+            const std::uint64_t word = other.words[i].load(std::memory_order_relaxed);
+            if (word)
+                words[i].fetch_or(word, std::memory_order_relaxed);
+        }
+
+        return true;
+    }
+
+    // Same as above for a filter that is not shared, e.g. one built offline,
+    // whatever its stats policy and allocator.
+    template <typename stats_policy, typename allocator>
+    bool merge(const bloom_filter<hasher, index, stats_policy, allocator>& other)
+    {
+        if (m == 0 || k == 0 || n == 0 || p == 0.0)
+            return false;
+
+        if (m != other.bit_count() || k != other.hash_count() || n != other.expected_elements()
+            || p != other.false_positive() || size() != other.size())
+            return false;
+
+        for (std::uint64_t i = 0; i < word_count; ++i)
+        {
+            const std::uint64_t word = load_word(other.raw(), other.size(), i);
+            if (word)
+                words[i].fetch_or(word, std::memory_order_relaxed);
+        }
+
+        return true;
+    }
+
+private:
+    std::uint64_t                                 m; // size in bits
+    std::uint64_t                                 k; // number of hashes
+    std::uint64_t                                 n; // expected number of elements
+    double                                        p; // false positive probability(> 0 && < 1)
+    std::uint64_t                                 word_count;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> words;
+    hasher                                        h;
+    index                                         idx;
+
+    void allocate()
+    {
+        word_count = m / 64 + static_cast<bool>(m & 63);
+        words      = std::make_unique<std::atomic<std::uint64_t>[]>(word_count); // zeroed
+    }
+
+    // the i-th little endian word of a byte array, zero padded at the end
+    static std::uint64_t load_word(const std::uint8_t* raw, std::uint64_t raw_size, std::uint64_t i)
+    {
+        std::uint64_t       word  = 0;
+        const std::uint64_t bytes = std::min<std::uint64_t>(8, raw_size - i * 8);
+        for (std::uint64_t j = 0; j < bytes; ++j)
+            word |= static_cast<std::uint64_t>(raw[i * 8 + j]) << (j * 8);
+        return word;
+    }
+};
+
+} // BF
+#endif // CONCURRENT_BLOOM_FILTER_HPP
@@ -0,0 +1,198 @@
+#include "counting_bloom_filter.hpp"
+#include <cstring>
+#include <gtest/gtest.h>
+
+namespace BF
+{
+
+TEST(counting_bf_test, parameters)
+{
+    {
+        BF::counting_bloom_filter bf;
+        EXPECT_TRUE(bf.config(1001, 3, 10));
+        EXPECT_EQ(bf.bit_count(), 1001);
+        EXPECT_EQ(bf.hash_count(), 3);
+        EXPECT_EQ(bf.size(), 501); // two counters per byte
+        EXPECT_NE(bf.raw(), nullptr);
+    }
+
+    {
+        BF::counting_bloom_filter<BF::murmur3, 8>  bf8;
+        BF::counting_bloom_filter<BF::murmur3, 16> bf16;
+        EXPECT_TRUE(bf8.config(1001, 3, 10));
+        EXPECT_TRUE(bf16.config(1001, 3, 10));
+        EXPECT_EQ(bf8.size(), 1001);
+        EXPECT_EQ(bf16.size(), 2002);
+        EXPECT_EQ((BF::counting_bloom_filter<BF::murmur3, 16>::MAX_COUNT), 65535);
+    }
+
+    {
+        BF::bloom_filter          classic;
+        BF::counting_bloom_filter bf;
+        EXPECT_TRUE(classic.config(553, 0.002));
+        EXPECT_TRUE(bf.config(553, 0.002));
+        EXPECT_EQ(bf.bit_count(), classic.bit_count());
+        EXPECT_EQ(bf.hash_count(), classic.hash_count());
+        EXPECT_EQ(bf.false_positive(), 0.002);
+    }
+
+    {
+        BF::counting_bloom_filter bf;
+        EXPECT_FALSE(bf.config(0, 0.5));
+        EXPECT_FALSE(bf.config(256, 1.0));
+        EXPECT_FALSE(bf.config(0, 256, 1024));
+        EXPECT_FALSE(bf.config(256, 0, 1024));
+        EXPECT_FALSE(bf.add("a", 1));
+        EXPECT_FALSE(bf.contains("a", 1));
+        EXPECT_FALSE(bf.remove("a", 1));
+        EXPECT_EQ(bf.raw(), nullptr);
+        EXPECT_EQ(bf.to_bloom_filter().raw(), nullptr);
+    }
+}
+
+template <typename counting>
+void check_add_remove()
+{
+    constexpr std::uint64_t ELEMENT_COUNT = 20000;
+
+    counting bf;
+    ASSERT_TRUE(bf.config(ELEMENT_COUNT, 0.01));
+    for (std::uint64_t i = 0; i < ELEMENT_COUNT; ++i)
+        ASSERT_TRUE(bf.add(&i, sizeof(i)));
+    for (std::uint64_t i = 0; i < ELEMENT_COUNT; ++i)
+        ASSERT_TRUE(bf.contains(&i, sizeof(i)));
+
+    // removing the odd keys keeps all of the even ones
+    for (std::uint64_t i = 1; i < ELEMENT_COUNT; i += 2)
+        ASSERT_TRUE(bf.remove(&i, sizeof(i)));
+    std::uint64_t still_there = 0;
+    for (std::uint64_t i = 0; i < ELEMENT_COUNT; ++i)
+    {
+        if (i % 2 == 0)
+            ASSERT_TRUE(bf.contains(&i, sizeof(i)));
+        else
+            still_there += bf.contains(&i, sizeof(i));
+    }
+    EXPECT_LT(still_there, ELEMENT_COUNT / 2 * 0.02);
+
+    for (std::uint64_t i = 0; i < ELEMENT_COUNT; i += 2)
+        ASSERT_TRUE(bf.remove(&i, sizeof(i)));
+    for (std::uint64_t i = 0; i < bf.size(); ++i)
+        ASSERT_EQ(bf.raw()[i], 0);
+}
+
+TEST(counting_bf_test, add_remove)
+{
+    check_add_remove<BF::counting_bloom_filter<BF::murmur3, 4>>();
+    check_add_remove<BF::counting_bloom_filter<BF::murmur3, 8>>();
+    check_add_remove<BF::counting_bloom_filter<BF::murmur3, 16>>();
+}
+
+TEST(counting_bf_test, saturation)
+{
+    // a single counter that every key hits
+    BF::counting_bloom_filter bf;
+    ASSERT_TRUE(bf.config(1, 1, 1));
+
+    const std::string key("key");
+    for (std::uint64_t i = 0; i < 20; ++i)
+        ASSERT_TRUE(bf.add(key.data(), key.size()));
+    EXPECT_EQ(bf.raw()[0], BF::counting_bloom_filter<>::MAX_COUNT);
+
+    // once saturated it never goes back to 0
+    for (std::uint64_t i = 0; i < 20; ++i)
+        ASSERT_TRUE(bf.remove(key.data(), key.size()));
+    EXPECT_TRUE(bf.contains(key.data(), key.size()));
+
+    // below the maximum it counts in both directions
+    BF::counting_bloom_filter<BF::murmur3, 8> wide;
+    ASSERT_TRUE(wide.config(1, 1, 1));
+    for (std::uint64_t i = 0; i < 20; ++i)
+        ASSERT_TRUE(wide.add(key.data(), key.size()));
+    EXPECT_EQ(wide.raw()[0], 20);
+    for (std::uint64_t i = 0; i < 20; ++i)
+        ASSERT_TRUE(wide.remove(key.data(), key.size()));
+    EXPECT_FALSE(wide.contains(key.data(), key.size()));
+    EXPECT_FALSE(wide.remove(key.data(), key.size()));
+}
+
+TEST(counting_bf_test, to_bloom_filter_and_merge)
+{
+    BF::bloom_filter          classic;
+    BF::counting_bloom_filter bf;
+    BF::counting_bloom_filter other;
+    ASSERT_TRUE(classic.config(1000, 0.01));
+    ASSERT_TRUE(bf.config(1000, 0.01));
+    ASSERT_TRUE(other.config(1000, 0.01));
+
+    for (std::uint64_t i = 0; i < 1000; ++i)
+    {
+        ASSERT_TRUE(classic.add(&i, sizeof(i)));
+        ASSERT_TRUE(i < 500 ? bf.add(&i, sizeof(i)) : other.add(&i, sizeof(i)));
+    }
+    ASSERT_TRUE(bf.merge(other));
+
+    const auto projected = bf.to_bloom_filter();
+    EXPECT_EQ(projected.bit_count(), classic.bit_count());
+    EXPECT_EQ(projected.hash_count(), classic.hash_count());
+    ASSERT_EQ(projected.size(), classic.size());
+    EXPECT_EQ(std::memcmp(projected.raw(), classic.raw(), classic.size()), 0);
+
+    // the merged counts can be taken out again
+    for (std::uint64_t i = 500; i < 1000; ++i)
+        ASSERT_TRUE(bf.remove(&i, sizeof(i)));
+    for (std::uint64_t i = 0; i < 500; ++i)
+        ASSERT_TRUE(bf.contains(&i, sizeof(i)));
+
+    BF::counting_bloom_filter mismatch;
+    ASSERT_TRUE(mismatch.config(2000, 0.01));
+    EXPECT_FALSE(bf.merge(mismatch));
+
+    BF::counting_bloom_filter moved = std::move(bf);
+    EXPECT_EQ(bf.bit_count(), 0);
+    EXPECT_EQ(bf.raw(), nullptr);
+    EXPECT_EQ(moved.bit_count(), classic.bit_count());
+}
+
+TEST(counting_bf_test, from_raw)
+{
+    // every counter width, an odd m for the packed 4 bit counters
+    auto round_trip = []<unsigned bits>(std::integral_constant<unsigned, bits>) {
+        BF::counting_bloom_filter<BF::murmur3, bits> bf;
+        ASSERT_TRUE(bf.config(1001, 3, 100));
+        for (std::uint64_t i = 0; i < 100; ++i)
+            ASSERT_TRUE(bf.add(&i, sizeof(i)));
+        ASSERT_EQ(bf.size(), bits == 4 ? 501 : 1001 * bits / 8);
+
+        BF::counting_bloom_filter<BF::murmur3, bits> copy;
+        ASSERT_TRUE(copy.from(bf.bit_count(), bf.hash_count(), bf.expected_elements(), bf.false_positive(), bf.raw(), bf.size()));
+        EXPECT_EQ(copy.bit_count(), bf.bit_count());
+        EXPECT_EQ(copy.false_positive(), bf.false_positive());
+        ASSERT_EQ(copy.size(), bf.size());
+        EXPECT_EQ(std::memcmp(copy.raw(), bf.raw(), bf.size()), 0);
+
+        // the counts came along, removing works on the copy
+        for (std::uint64_t i = 0; i < 50; ++i)
+            ASSERT_TRUE(copy.remove(&i, sizeof(i)));
+        for (std::uint64_t i = 50; i < 100; ++i)
+            ASSERT_TRUE(copy.contains(&i, sizeof(i)));
+
+        // a size that does not fit m counters of this width
+        EXPECT_FALSE(copy.from(bf.bit_count(), bf.hash_count(), bf.expected_elements(), bf.false_positive(), bf.raw(), bf.size() - 1));
+        EXPECT_FALSE(copy.from(bf.bit_count() + 2, bf.hash_count(), bf.expected_elements(), bf.false_positive(), bf.raw(), bf.size()));
+        EXPECT_FALSE(copy.from(bf.bit_count(), bf.hash_count(), bf.expected_elements(), 0.0, bf.raw(), bf.size()));
+        EXPECT_FALSE(copy.from(bf.bit_count(), bf.hash_count(), bf.expected_elements(), bf.false_positive(), nullptr, bf.size()));
+    };
+    round_trip(std::integral_constant<unsigned, 4>());
+    round_trip(std::integral_constant<unsigned, 8>());
+    round_trip(std::integral_constant<unsigned, 16>());
+
+    // the unused nibble after an odd number of 4 bit counters is cleared
+    BF::counting_bloom_filter<BF::murmur3, 4> odd;
+    std::vector<std::uint8_t>                 bytes(501, 0);
+    bytes.back() = 0xf1;
+    ASSERT_TRUE(odd.from(1001, 3, 100, 0.5, bytes.data(), bytes.size()));
+    EXPECT_EQ(odd.raw()[500], 0x01);
+}
+
+} // BF
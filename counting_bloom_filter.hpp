@@ -0,0 +1,256 @@
+#ifndef COUNTING_BLOOM_FILTER_HPP
+#define COUNTING_BLOOM_FILTER_HPP
+
+#include "bloom_filter.hpp"
+#include <type_traits>
+
+namespace BF
+{
+
+// Bloom filter with a small counter in place of every bit, so keys can be
+// removed again. Counters are counter_bits(4, 8 or 16) wide, 4 bit counters
+// are packed two per byte. A counter that reaches its maximum saturates and
+// stays there: it can no longer be decremented, because the number of keys
+// that hit it is unknown from then on. Removing a key that was never added
+// can produce false negatives, just like with any counting filter.
+// Counter i corresponds to bit i of a bloom_filter with the same m, k, hasher
+// and index policy, which is what to_bloom_filter relies on.
+template <bloom_hasher hasher = murmur3, unsigned counter_bits = 4, typename index = modulo_index>
+class counting_bloom_filter
+{
+    static_assert(counter_bits == 4 || counter_bits == 8 || counter_bits == 16, "counters are 4, 8 or 16 bits wide");
+
+    typedef std::conditional_t<counter_bits == 16, std::uint16_t, std::uint8_t> counter_word;
+
+public:
+    static constexpr std::uint64_t MAX_COUNT = (std::uint64_t(1) << counter_bits) - 1;
+
+    counting_bloom_filter()
+        : m(0)
+        , k(0)
+        , n(0)
+        , p(0.0)
+    {
+    }
+
+    counting_bloom_filter(const counting_bloom_filter& other) = default;
+
+    counting_bloom_filter& operator=(const counting_bloom_filter& other) = default;
+
+    counting_bloom_filter(counting_bloom_filter&& other)
+        : m(other.m)
+        , k(other.k)
+        , n(other.n)
+        , p(other.p)
+        , counters(std::move(other.counters))
+    {
+        other.m = other.k = other.n = other.p = 0;
+    }
+
+    counting_bloom_filter& operator=(counting_bloom_filter&& other)
+    {
+        if (this != &other)
+        {
+            m        = other.m;
+            k        = other.k;
+            n        = other.n;
+            p        = other.p;
+            counters = std::move(other.counters);
+
+            other.m = other.k = other.n = other.p = 0;
+        }
+        return *this;
+    }
+
+    // m is the number of counters, sized exactly like bloom_filter::config.
+    bool config(std::uint64_t m, std::uint64_t k, std::uint64_t n)
+    {
+        if (index::round_m(m) == 0 || k == 0 || n == 0)
+            return false;
+
+        this->m = index::round_m(m);
+        this->k = k;
+        this->n = n;
+        this->p = compute_p(this->m, k, n);
+        allocate();
+
+        return true;
+    }
+
+    bool config(std::uint64_t n, double p)
+    {
+        if (p >= 1.0 || p <= 0.0 || n == 0)
+            return false;
+
+        if (!compute_m_k<index>(n, p, m, k, this->p))
+            return false;
+        this->n = n;
+        allocate();
+
+        return true;
+    }
+
+    std::uint64_t bit_count() const { return m; } // number of counters
+
+    std::uint64_t hash_count() const { return k; }
+
+    std::uint64_t expected_elements() const { return n; }
+
+    double false_positive() const { return p; }
+
+    std::size_t size() const { return counters.size() * sizeof(counter_word); } // in bytes
+
+    // The counters as size() bytes: 4 bit counters two per byte, counter i
+    // in the low nibble of byte i / 2 for an even i, 16 bit ones little
+    // endian. from() takes them back.
+    const std::uint8_t* raw() const
+    {
+        if (counters.empty())
+            return nullptr;
+        return reinterpret_cast<const std::uint8_t*>(counters.data());
+    }
+
+    // Create a filter from the components of an existing one, raw_size has
+    // to be the size() of m counters of counter_bits. Deep copies the
+    // counters.
+    bool from(std::uint64_t       m,
+              std::uint64_t       k,
+              std::uint64_t       n,
+              double              p,
+              const std::uint8_t* raw,
+              std::uint64_t       raw_size)
+    {
+        if (p >= 1.0 || p <= 0.0 || n == 0 || k == 0 || index::round_m(m) != m)
+            return false;
+
+        const std::uint64_t word_count = counter_bits == 4 ? m / 2 + (m & 1) : m;
+        if (!raw || raw_size == 0 || raw_size != word_count * sizeof(counter_word))
+            return false;
+
+        this->m = m;
+        this->k = k;
+        this->n = n;
+        this->p = p;
+        allocate();
+        std::memcpy(counters.data(), raw, raw_size);
+        if constexpr (counter_bits == 4)
+        {
+            // the unused high nibble after an odd number of counters
+            if (m & 1)
+                counters.back() &= 0xF;
+        }
+
+        return true;
+    }
+
+    bool add(const void* key, const std::uint64_t len)
+    {
+        if (m == 0 || k == 0 || n == 0 || p == 0.0)
+            return false;
+
+        return for_each_hash(h, key, len, k, [this](std::uint64_t hash) {
+            const std::uint64_t id    = idx(hash, m);
+            const std::uint64_t count = get(id);
+            if (count < MAX_COUNT)
+                set(id, count + 1);
+            return true;
+        });
+    }
+
+    bool contains(const void* key, const std::uint64_t len) const
+    {
+        if (m == 0 || k == 0 || n == 0 || p == 0.0)
+            return false;
+
+        return for_each_hash(h, key, len, k, [this](std::uint64_t hash) { return get(idx(hash, m)) != 0; });
+    }
+
+    // Decrements the counters of a key. Returns false and changes nothing if
+    // the key is not in the filter. Saturated counters are left alone.
+    bool remove(const void* key, const std::uint64_t len)
+    {
+        if (!contains(key, len))
+            return false;
+
+        return for_each_hash(h, key, len, k, [this](std::uint64_t hash) {
+            const std::uint64_t id    = idx(hash, m);
+            const std::uint64_t count = get(id);
+            // a key that was never added can probe the same counter twice
+            // and find it at 0 the second time
+            if (count != 0 && count < MAX_COUNT)
+                set(id, count - 1);
+            return true;
+        });
+    }
+
+    // Adds the counts of other, saturating at MAX_COUNT.
+    bool merge(const counting_bloom_filter& other)
+    {
+        if (m == 0 || k == 0 || n == 0 || p == 0.0)
+            return false;
+
+        if (m != other.m || k != other.k || n != other.n
+            || p != other.p || counters.size() != other.counters.size())
+            return false;
+
+        for (std::uint64_t i = 0; i < m; ++i)
+            set(i, std::min(get(i) + other.get(i), MAX_COUNT));
+
+        return true;
+    }
+
+    // A plain bloom_filter with bit i set wherever counter i is not 0, e.g.
+    // for read only replicas that do not need to remove keys.
+    bloom_filter<hasher, index> to_bloom_filter() const
+    {
+        bloom_filter<hasher, index> out;
+        if (m == 0)
+            return out;
+
+        std::vector<std::uint8_t> raw(m / 8 + static_cast<bool>(m & 7), 0);
+        for (std::uint64_t i = 0; i < m; ++i)
+            raw[i / 8] |= static_cast<std::uint8_t>(get(i) != 0) << (i & 7);
+        out.from(m, k, n, p, raw.data(), raw.size());
+        return out;
+    }
+
+private:
+    std::uint64_t             m; // number of counters
+    std::uint64_t             k; // number of hashes
+    std::uint64_t             n; // expected number of elements
+    double                    p; // false positive probability(> 0 && < 1)
+    std::vector<counter_word> counters;
+    hasher                    h;
+    index                     idx;
+
+    void allocate()
+    {
+        counters.clear();
+        if constexpr (counter_bits == 4)
+            counters.resize(m / 2 + (m & 1), 0);
+        else
+            counters.resize(m, 0);
+    }
+
+    std::uint64_t get(std::uint64_t id) const
+    {
+        if constexpr (counter_bits == 4)
+            return (counters[id / 2] >> ((id & 1) * 4)) & 0xF;
+        else
+            return counters[id];
+    }
+
+    void set(std::uint64_t id, std::uint64_t count)
+    {
+        if constexpr (counter_bits == 4)
+        {
+            const unsigned shift = (id & 1) * 4;
+            counters[id / 2]     = static_cast<std::uint8_t>((counters[id / 2] & ~(0xF << shift)) | (count << shift));
+        }
+        else
+            counters[id] = static_cast<counter_word>(count);
+    }
+};
+
+} // BF
+#endif // COUNTING_BLOOM_FILTER_HPP
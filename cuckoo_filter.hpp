@@ -0,0 +1,402 @@
+#ifndef CUCKOO_FILTER_HPP
+#define CUCKOO_FILTER_HPP
+
+#include "bloom_filter.hpp"
+
+namespace BF
+{
+
+// Cuckoo filter(Fan, Andersen, Kaminsky, Mitzenmacher: "Cuckoo Filter:
+// Practically Better Than Bloom") with buckets of 4 fingerprints of 8 or 16
+// bits. A key has two candidate buckets, the second one derived from the
+// first and the fingerprint, so a stored fingerprint can be moved to its
+// other bucket without knowing the key. Lookups read two buckets, i.e. at
+// most two cache lines, and compare them with one vector instruction, and
+// unlike a bloom filter keys can be removed.
+//
+// When both buckets of a new key are full, fingerprints are kicked to their
+// other bucket at most MAX_KICKS times. The one left over after that goes to
+// a small stash that every lookup checks as well, add only fails once the
+// stash is full too. Keys can be added more than once, but only keys that
+// were added may be removed.
+template <bloom_hasher hasher = murmur3, unsigned fingerprint_bits = 16>
+class cuckoo_filter
+{
+    static_assert(fingerprint_bits == 8 || fingerprint_bits == 16, "fingerprints are 8 or 16 bits wide");
+    static_assert(requires(const hasher& h, const void* key, std::uint64_t len) { { h(key, len) } -> std::convertible_to<hash128>; },
+                  "the hasher has to return hash128");
+
+    typedef std::conditional_t<fingerprint_bits == 16, std::uint16_t, std::uint8_t> fingerprint;
+
+public:
+    static constexpr std::uint64_t BUCKET_SIZE = 4;
+    static constexpr std::uint64_t MAX_KICKS   = 500;
+    static constexpr std::uint64_t STASH_SIZE  = 8;
+    // the load a filter is sized for, 4-way buckets fill up at ~95%
+    static constexpr double TARGET_LOAD = 0.9;
+
+    cuckoo_filter()
+        : buckets(0)
+        , elements(0)
+        , stashed(0)
+        , rng(RNG_SEED)
+    {
+    }
+
+    cuckoo_filter(const cuckoo_filter& other) = default;
+
+    cuckoo_filter& operator=(const cuckoo_filter& other) = default;
+
+    cuckoo_filter(cuckoo_filter&& other)
+        : buckets(other.buckets)
+        , elements(other.elements)
+        , stashed(other.stashed)
+        , rng(other.rng)
+    {
+        if (!other.slots.empty())
+            std::swap(slots, other.slots);
+        other.buckets = other.elements = other.stashed = 0;
+    }
+
+    cuckoo_filter& operator=(cuckoo_filter&& other)
+    {
+        if (this != &other)
+        {
+            buckets  = other.buckets;
+            elements = other.elements;
+            stashed  = other.stashed;
+            rng      = other.rng;
+
+            if (!other.slots.empty())
+            {
+                std::swap(slots, other.slots);
+                other.slots.clear(); // in case it is not empty
+            }
+            other.buckets = other.elements = other.stashed = 0;
+        }
+        return *this;
+    }
+
+    // Room for n keys at TARGET_LOAD, the number of buckets is rounded up to
+    // a power of two.
+    bool config(std::uint64_t n)
+    {
+        if (n == 0 || n > (std::uint64_t(1) << 48))
+            return false;
+
+        const std::uint64_t min_buckets = std::max<std::uint64_t>(2, std::ceil(n / (BUCKET_SIZE * TARGET_LOAD)));
+        buckets                         = pow2_index::round_m(min_buckets);
+        elements                        = 0;
+        stashed                         = 0;
+        rng                             = RNG_SEED;
+        slots.assign(buckets * BUCKET_SIZE + STASH_SLOTS, 0);
+
+        return true;
+    }
+
+    // Create a filter from the components of an existing one: its
+    // bucket_count(), element_count() and raw() bytes, which are deep copied.
+    bool from(std::uint64_t buckets, std::uint64_t elements, const std::uint8_t* raw, std::uint64_t raw_size)
+    {
+        if (buckets < 2 || pow2_index::round_m(buckets) != buckets || buckets > (std::uint64_t(1) << 48))
+            return false;
+
+        if (!raw || raw_size != (buckets * BUCKET_SIZE + STASH_SLOTS) * sizeof(fingerprint) || elements > buckets * BUCKET_SIZE + STASH_SIZE)
+            return false;
+
+        this->buckets  = buckets;
+        this->elements = elements;
+        rng            = RNG_SEED;
+        slots.assign(buckets * BUCKET_SIZE + STASH_SLOTS, 0);
+        std::memcpy(slots.data(), raw, raw_size);
+
+        stashed = 0;
+        for (std::uint64_t i = 0; i < STASH_SIZE; ++i)
+            stashed += stash_entry(i) != 0;
+        return true;
+    }
+
+    std::uint64_t bucket_count() const { return buckets; }
+
+    std::uint64_t element_count() const { return elements; } // adds minus removes
+
+    std::uint64_t stash_count() const { return stashed; }
+
+    // The share of the fingerprint slots that are taken.
+    double load_factor() const
+    {
+        if (buckets == 0)
+            return 0.0;
+        return static_cast<double>(elements) / (buckets * BUCKET_SIZE);
+    }
+
+    // The false positive rate at the current load: a lookup compares its
+    // fingerprint with the taken slots of two buckets, each matches with a
+    // probability of 1 / (2^fingerprint_bits - 1).
+    double false_positive() const
+    {
+        const double taken = 2.0 * BUCKET_SIZE * std::min(load_factor(), 1.0);
+        return 1.0 - std::pow(1.0 - 1.0 / ((std::uint64_t(1) << fingerprint_bits) - 1), taken);
+    }
+
+    std::size_t size() const { return slots.size() * sizeof(fingerprint); } // in bytes
+
+    // The buckets(BUCKET_SIZE fingerprints each, 0 is a free slot) followed by
+    // STASH_SIZE stash entries of 8 bytes(bucket << 16 | fingerprint, 0 if
+    // free), in the byte order of the machine. The buckets start on a cache
+    // line and the layout does not depend on where it is loaded, so the bytes
+    // can be queried where they are, e.g. from a mapped file.
+    const std::uint8_t* raw() const
+    {
+        if (slots.empty())
+            return nullptr;
+        return reinterpret_cast<const std::uint8_t*>(slots.data());
+    }
+
+    bool add(const void* key, const std::uint64_t len)
+    {
+        if (buckets == 0)
+            return false;
+        return insert(h(key, len));
+    }
+
+    bool contains(const void* key, const std::uint64_t len) const
+    {
+        if (buckets == 0)
+            return false;
+        return find(h(key, len));
+    }
+
+    bool remove(const void* key, const std::uint64_t len)
+    {
+        if (buckets == 0)
+            return false;
+        return erase(h(key, len));
+    }
+
+    // Typed keys, see bloom_filter.
+    template <trivial_key T>
+    bool add(const T& key)
+    {
+        if (buckets == 0)
+            return false;
+        return insert(hash_key<sizeof(T)>(h, &key));
+    }
+
+    template <trivial_key T>
+    bool contains(const T& key) const
+    {
+        if (buckets == 0)
+            return false;
+        return find(hash_key<sizeof(T)>(h, &key));
+    }
+
+    template <trivial_key T>
+    bool remove(const T& key)
+    {
+        if (buckets == 0)
+            return false;
+        return erase(hash_key<sizeof(T)>(h, &key));
+    }
+
+    bool add(std::string_view key) { return add(key.data(), key.size()); }
+
+    bool contains(std::string_view key) const { return contains(key.data(), key.size()); }
+
+    bool remove(std::string_view key) { return remove(key.data(), key.size()); }
+
+    bool add(std::span<const std::byte> key) { return add(key.data(), key.size()); }
+
+    bool contains(std::span<const std::byte> key) const { return contains(key.data(), key.size()); }
+
+    bool remove(std::span<const std::byte> key) { return remove(key.data(), key.size()); }
+
+private:
+    static constexpr std::uint64_t RNG_SEED    = 0x2545f4914f6cdd1dULL;
+    static constexpr std::uint64_t STASH_SLOTS = STASH_SIZE * sizeof(std::uint64_t) / sizeof(fingerprint);
+
+    std::uint64_t                                              buckets; // a power of two
+    std::uint64_t                                              elements;
+    std::uint64_t                                              stashed;
+    std::uint64_t                                              rng; // picks the fingerprints to kick
+    std::vector<fingerprint, aligned_allocator<fingerprint, 64>> slots; // the buckets, then the stash
+    hasher                                                     h;
+
+    // The fingerprint from the second base hash, 0 marks a free slot.
+    static fingerprint fingerprint_of(const hash128& base)
+    {
+        const fingerprint fp = static_cast<fingerprint>(base.h2);
+        return fp == 0 ? 1 : fp;
+    }
+
+    // The other bucket of a fingerprint, alternate(alternate(i)) == i.
+    std::uint64_t alternate(std::uint64_t bucket, fingerprint fp) const
+    {
+        return (bucket ^ (fp * 0x5bd1e995ULL)) & (buckets - 1);
+    }
+
+    std::uint64_t bucket_word(std::uint64_t bucket) const
+    {
+        std::uint64_t word = 0;
+        std::memcpy(&word, slots.data() + bucket * BUCKET_SIZE, BUCKET_SIZE * sizeof(fingerprint));
+        return word;
+    }
+
+    std::uint64_t stash_entry(std::uint64_t i) const
+    {
+        std::uint64_t entry;
+        std::memcpy(&entry, slots.data() + buckets * BUCKET_SIZE + i * (STASH_SLOTS / STASH_SIZE), sizeof(entry));
+        return entry;
+    }
+
+    void set_stash_entry(std::uint64_t i, std::uint64_t entry)
+    {
+        std::memcpy(slots.data() + buckets * BUCKET_SIZE + i * (STASH_SLOTS / STASH_SIZE), &entry, sizeof(entry));
+    }
+
+    // Puts fp into a free slot of bucket.
+    bool put(std::uint64_t bucket, fingerprint fp)
+    {
+        fingerprint* slot = slots.data() + bucket * BUCKET_SIZE;
+        for (std::uint64_t i = 0; i < BUCKET_SIZE; ++i)
+        {
+            if (slot[i] == 0)
+            {
+                slot[i] = fp;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Frees a slot of bucket that holds fp.
+    bool take(std::uint64_t bucket, fingerprint fp)
+    {
+        fingerprint* slot = slots.data() + bucket * BUCKET_SIZE;
+        for (std::uint64_t i = 0; i < BUCKET_SIZE; ++i)
+        {
+            if (slot[i] == fp)
+            {
+                slot[i] = 0;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::uint64_t next_random()
+    {
+        // xorshift64
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        return rng;
+    }
+
+    bool insert(const hash128& base)
+    {
+        fingerprint         fp    = fingerprint_of(base);
+        const std::uint64_t first = base.h1 & (buckets - 1);
+        if (put(first, fp) || put(alternate(first, fp), fp))
+        {
+            ++elements;
+            return true;
+        }
+
+        // the kicks end with a fingerprint in the stash, check there is room
+        // first so that a failed add does not lose any key
+        if (stashed == STASH_SIZE)
+            return false;
+
+        std::uint64_t bucket = next_random() & 1 ? first : alternate(first, fp);
+        for (std::uint64_t kick = 0; kick < MAX_KICKS; ++kick)
+        {
+            std::swap(fp, slots[bucket * BUCKET_SIZE + (next_random() & (BUCKET_SIZE - 1))]);
+            bucket = alternate(bucket, fp);
+            if (put(bucket, fp))
+            {
+                ++elements;
+                return true;
+            }
+        }
+
+        for (std::uint64_t i = 0; i < STASH_SIZE; ++i)
+        {
+            if (stash_entry(i) == 0)
+            {
+                set_stash_entry(i, bucket << 16 | fp);
+                ++stashed;
+                ++elements;
+                return true;
+            }
+        }
+        return false; // not reached, there was room
+    }
+
+    bool find(const hash128& base) const
+    {
+        const fingerprint   fp     = fingerprint_of(base);
+        const std::uint64_t first  = base.h1 & (buckets - 1);
+        const std::uint64_t second = alternate(first, fp);
+        if (simd::bucket_pair_contains<fingerprint_bits>(bucket_word(first), bucket_word(second), fp))
+            return true;
+
+        if (stashed == 0)
+            return false;
+        for (std::uint64_t i = 0; i < STASH_SIZE; ++i)
+        {
+            const std::uint64_t entry = stash_entry(i);
+            if (entry == (first << 16 | fp) || entry == (second << 16 | fp))
+                return true;
+        }
+        return false;
+    }
+
+    bool erase(const hash128& base)
+    {
+        const fingerprint   fp     = fingerprint_of(base);
+        const std::uint64_t first  = base.h1 & (buckets - 1);
+        const std::uint64_t second = alternate(first, fp);
+        if (take(first, fp) || take(second, fp))
+        {
+            --elements;
+            unstash();
+            return true;
+        }
+
+        for (std::uint64_t i = 0; i < STASH_SIZE; ++i)
+        {
+            const std::uint64_t entry = stash_entry(i);
+            if (entry != 0 && (entry == (first << 16 | fp) || entry == (second << 16 | fp)))
+            {
+                set_stash_entry(i, 0);
+                --stashed;
+                --elements;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Moves stashed fingerprints back into their buckets once there is room.
+    void unstash()
+    {
+        for (std::uint64_t i = 0; i < STASH_SIZE && stashed > 0; ++i)
+        {
+            const std::uint64_t entry = stash_entry(i);
+            if (entry == 0)
+                continue;
+
+            const fingerprint   fp     = static_cast<fingerprint>(entry & 0xffff);
+            const std::uint64_t bucket = entry >> 16;
+            if (put(bucket, fp) || put(alternate(bucket, fp), fp))
+            {
+                set_stash_entry(i, 0);
+                --stashed;
+            }
+        }
+    }
+};
+
+} // BF
+#endif // CUCKOO_FILTER_HPP
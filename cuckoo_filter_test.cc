@@ -0,0 +1,146 @@
+#include "cuckoo_filter.hpp"
+#include "hashers.hpp"
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+
+namespace BF
+{
+
+TEST(cuckoo_filter_test, parameters)
+{
+    BF::cuckoo_filter bf;
+    EXPECT_FALSE(bf.config(0));
+    EXPECT_FALSE(bf.add("a", 1));
+    EXPECT_FALSE(bf.contains("a", 1));
+    EXPECT_FALSE(bf.remove("a", 1));
+    EXPECT_EQ(bf.raw(), nullptr);
+    EXPECT_EQ(bf.load_factor(), 0.0);
+
+    ASSERT_TRUE(bf.config(1000));
+    EXPECT_EQ(bf.bucket_count(), 512); // 1000 / (4 * 0.9) rounded up to a power of two
+    EXPECT_EQ(bf.size(), (512 * 4 + 32) * 2);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(bf.raw()) % 64, 0);
+    EXPECT_EQ(bf.element_count(), 0);
+    EXPECT_EQ(bf.false_positive(), 0.0);
+}
+
+template <typename filter>
+void check_membership(double max_fpr)
+{
+    constexpr std::uint64_t N = 100000;
+
+    filter bf;
+    ASSERT_TRUE(bf.config(N));
+    for (std::uint64_t i = 0; i < N; ++i)
+        ASSERT_TRUE(i % 2 ? bf.add(i) : bf.add(&i, sizeof(i)));
+    EXPECT_EQ(bf.element_count(), N);
+    EXPECT_NEAR(bf.load_factor(), static_cast<double>(N) / (bf.bucket_count() * 4), 1e-9);
+    for (std::uint64_t i = 0; i < N; ++i)
+        ASSERT_TRUE(bf.contains(i)) << i;
+
+    std::uint64_t false_positive = 0;
+    for (std::uint64_t i = N; i < 11 * N; ++i)
+        false_positive += bf.contains(i);
+    EXPECT_LE(false_positive / (10.0 * N), max_fpr);
+    EXPECT_NEAR(false_positive / (10.0 * N), bf.false_positive(), bf.false_positive() * 0.3);
+
+    // removing half of the keys keeps the other half
+    for (std::uint64_t i = 0; i < N; i += 2)
+        ASSERT_TRUE(bf.remove(i));
+    EXPECT_EQ(bf.element_count(), N / 2);
+    for (std::uint64_t i = 1; i < N; i += 2)
+        ASSERT_TRUE(bf.contains(i));
+
+    std::uint64_t still_found = 0;
+    for (std::uint64_t i = 0; i < N; i += 2)
+        still_found += bf.contains(i);
+    EXPECT_LE(still_found, N / 2 * max_fpr * 2);
+}
+
+TEST(cuckoo_filter_test, membership)
+{
+    check_membership<BF::cuckoo_filter<>>(0.0002);
+    check_membership<BF::cuckoo_filter<BF::xxh3, 8>>(0.03);
+}
+
+TEST(cuckoo_filter_test, full_and_stash)
+{
+    // far more keys than it was sized for: the stash takes the overflow and
+    // add fails without losing anything once it is full
+    BF::cuckoo_filter<BF::murmur3, 8> bf;
+    ASSERT_TRUE(bf.config(100));
+    std::uint64_t added = 0;
+    while (added < 10000 && bf.add(added))
+        ++added;
+    EXPECT_LT(added, 10000);
+    EXPECT_GE(bf.load_factor(), 0.9);
+    EXPECT_EQ(bf.stash_count(), BF::cuckoo_filter<>::STASH_SIZE);
+    for (std::uint64_t i = 0; i < added; ++i)
+        EXPECT_TRUE(bf.contains(i)) << i;
+
+    // removes make room and the stash drains back into the buckets
+    for (std::uint64_t i = 0; i < added; i += 3)
+        ASSERT_TRUE(bf.remove(i));
+    EXPECT_EQ(bf.stash_count(), 0);
+    for (std::uint64_t i = 1; i < added; i += 3)
+        EXPECT_TRUE(bf.contains(i)) << i;
+    EXPECT_TRUE(bf.add(added));
+}
+
+TEST(cuckoo_filter_test, bucket_probe)
+{
+    // 4 lanes per bucket, a match in any lane of either bucket counts
+    EXPECT_TRUE(simd::bucket_pair_contains<8>(0x44332211, 0x88776655, 0x11));
+    EXPECT_TRUE(simd::bucket_pair_contains<8>(0x44332211, 0x88776655, 0x88));
+    EXPECT_FALSE(simd::bucket_pair_contains<8>(0x44332211, 0x88776655, 0x99));
+    EXPECT_FALSE(simd::bucket_pair_contains<8>(0xffffffff44332211, 0x88776655, 0xff)); // only the low 4 bytes are a bucket
+    EXPECT_TRUE(simd::bucket_pair_contains<16>(0x4444333322221111, 0x8888777766665555, 0x2222));
+    EXPECT_TRUE(simd::bucket_pair_contains<16>(0x4444333322221111, 0x8888777766665555, 0x8888));
+    EXPECT_FALSE(simd::bucket_pair_contains<16>(0x4444333322221111, 0x8888777766665555, 0x1122));
+}
+
+TEST(cuckoo_filter_test, strings_and_duplicates)
+{
+    BF::cuckoo_filter bf;
+    ASSERT_TRUE(bf.config(100));
+    const std::string key = "expiring key";
+    ASSERT_TRUE(bf.add(key));
+    ASSERT_TRUE(bf.add("expiring key"));
+    EXPECT_EQ(bf.element_count(), 2);
+
+    // every add needs its own remove
+    ASSERT_TRUE(bf.remove(key));
+    EXPECT_TRUE(bf.contains(key.data(), key.size()));
+    ASSERT_TRUE(bf.remove(key));
+    EXPECT_FALSE(bf.contains(key));
+    EXPECT_FALSE(bf.remove(key));
+    EXPECT_EQ(bf.element_count(), 0);
+}
+
+TEST(cuckoo_filter_test, from_existing_data)
+{
+    BF::cuckoo_filter<BF::murmur3, 8> bf;
+    ASSERT_TRUE(bf.config(64));
+    std::uint64_t added = 0;
+    while (bf.add(added))
+        ++added;
+    ASSERT_GT(bf.stash_count(), 0);
+
+    BF::cuckoo_filter<BF::murmur3, 8> copy;
+    EXPECT_FALSE(copy.from(bf.bucket_count() + 1, bf.element_count(), bf.raw(), bf.size()));
+    EXPECT_FALSE(copy.from(bf.bucket_count(), bf.element_count(), bf.raw(), bf.size() - 1));
+    ASSERT_TRUE(copy.from(bf.bucket_count(), bf.element_count(), bf.raw(), bf.size()));
+    EXPECT_EQ(copy.stash_count(), bf.stash_count());
+    EXPECT_EQ(copy.element_count(), bf.element_count());
+    EXPECT_EQ(std::memcmp(copy.raw(), bf.raw(), bf.size()), 0);
+    for (std::uint64_t i = 0; i < added; ++i)
+        EXPECT_TRUE(copy.contains(i));
+
+    BF::cuckoo_filter<BF::murmur3, 8> moved = std::move(copy);
+    EXPECT_EQ(copy.bucket_count(), 0);
+    EXPECT_FALSE(copy.contains(std::uint64_t(0)));
+    EXPECT_TRUE(moved.contains(std::uint64_t(0)));
+}
+
+} // BF
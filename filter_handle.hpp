@@ -0,0 +1,258 @@
+#ifndef FILTER_HANDLE_HPP
+#define FILTER_HANDLE_HPP
+
+#include "bloom_filter.hpp"
+#include <atomic>
+#include <barrier>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <string>
+#include <thread>
+
+namespace BF
+{
+
+// Publishes a filter to reader threads and replaces it without a lock on the
+// read side. Readers call contains(or read) on whatever filter is current;
+// build() fills a replacement on background threads and swaps it in with a
+// single atomic pointer exchange, so readers never block and never see a
+// half built filter.
+//
+// The old filter is reclaimed RCU style: a reader announces itself in one of
+// two counters picked by the current epoch before it loads the pointer, and
+// publish flips the epoch twice and waits for each counter to drain before
+// it frees the old filter. Only publish ever waits.
+//
+// filter is a bloom_filter or any filter with config(n, p), add(key, len) and
+// merge; build gives each worker thread a filter of its own and merges them,
+// so it needs a filter per thread while it runs.
+template <typename filter>
+class filter_handle
+{
+public:
+    // records read from a stream per round of build_file
+    static constexpr std::uint64_t BUILD_BATCH = 1 << 16;
+
+    explicit filter_handle(unsigned threads = std::max(1u, std::thread::hardware_concurrency()))
+        : threads(std::max(1u, threads))
+        , epoch(0)
+        , live(nullptr)
+        , publishes(0)
+    {
+        readers[0].count = 0;
+        readers[1].count = 0;
+    }
+
+    filter_handle(const filter_handle& other) = delete;
+
+    filter_handle& operator=(const filter_handle& other) = delete;
+
+    // Waits for a running build.
+    ~filter_handle()
+    {
+        if (builder.joinable())
+            builder.join();
+        delete live.load();
+    }
+
+    // false while nothing was published yet
+    template <typename... key>
+    bool contains(const key&... keys) const
+    {
+        return read([&](const filter& current) { return current.contains(keys...); }, false);
+    }
+
+    // Calls fn(const filter&) on the current filter and returns its result,
+    // or otherwise when nothing was published yet. The filter stays alive
+    // until fn returns, keep the call short since publish waits for it.
+    template <typename function, typename result>
+    result read(function&& fn, result otherwise) const
+    {
+        const std::uint64_t e = epoch.load();
+        readers[e & 1].count.fetch_add(1);
+        const filter* current = live.load();
+        const result  out     = current ? fn(*current) : otherwise;
+        readers[e & 1].count.fetch_sub(1);
+        return out;
+    }
+
+    // The number of filters published so far.
+    std::uint64_t version() const { return publishes.load(); }
+
+    // Makes next the current filter and frees the previous one once no
+    // reader can still be using it.
+    void publish(std::unique_ptr<filter> next)
+    {
+        std::lock_guard<std::mutex> lock(publishing);
+        const filter*               old = live.exchange(next.release());
+
+        // readers that loaded old announced themselves in one of the two
+        // counters before, flipping the epoch twice moves new readers away
+        // from each in turn
+        for (int flip = 0; flip < 2; ++flip)
+        {
+            const std::uint64_t e = epoch.fetch_add(1);
+            while (readers[e & 1].count.load() != 0)
+                std::this_thread::yield();
+        }
+
+        delete old;
+        publishes.fetch_add(1);
+    }
+
+    void publish(filter&& next) { publish(std::make_unique<filter>(std::move(next))); }
+
+    // Builds a filter for n keys at a false positive rate of p from a range
+    // of keys(typed keys or strings, see range_key) on the worker threads and
+    // publishes it. The range is moved in, so it lives as long as the build.
+    // A build that is still running is waited for first. The future is false
+    // if the filter could not be configured.
+    template <std::ranges::random_access_range range>
+        requires range_key<std::ranges::range_value_t<range>>
+    std::future<bool> build(range keys, std::uint64_t n, double p)
+    {
+        return start([this, keys = std::move(keys), n, p]() {
+            std::vector<filter> parts(threads);
+            for (auto& part : parts)
+            {
+                if (!part.config(n, p))
+                    return false;
+            }
+
+            const std::uint64_t count = std::ranges::size(keys);
+            const std::uint64_t slice = count / threads + static_cast<bool>(count % threads);
+            run([&](unsigned thread) {
+                const std::uint64_t first = std::min(count, thread * slice);
+                const std::uint64_t last  = std::min(count, first + slice);
+                for (std::uint64_t i = first; i < last; ++i)
+                    add(parts[thread], std::ranges::begin(keys)[i]);
+            });
+            return finish(parts);
+        });
+    }
+
+    // Same as above for the records of a file, e.g. one key per line. The
+    // file is read BUILD_BATCH records at a time while the workers add the
+    // previous batch.
+    std::future<bool> build_file(std::string path, std::uint64_t n, double p, char delimiter = '\n')
+    {
+        return start([this, path = std::move(path), n, p, delimiter]() {
+            std::ifstream in(path, std::ios::binary);
+            if (!in)
+                return false;
+
+            std::vector<filter> parts(threads);
+            for (auto& part : parts)
+            {
+                if (!part.config(n, p))
+                    return false;
+            }
+
+            // thread 0 reads batch current ^ 1 while all of them add batch
+            // current, one barrier per round swaps them
+            std::vector<std::string> batches[2];
+            bool                     more[2] = { read_batch(in, delimiter, batches[0]), false };
+            std::barrier             sync(threads);
+            run([&](unsigned thread) {
+                for (unsigned current = 0; more[current]; current ^= 1)
+                {
+                    if (thread == 0)
+                        more[current ^ 1] = read_batch(in, delimiter, batches[current ^ 1]);
+
+                    const std::vector<std::string>& batch = batches[current];
+                    const std::uint64_t             slice = batch.size() / threads + static_cast<bool>(batch.size() % threads);
+                    const std::uint64_t             first = std::min<std::uint64_t>(batch.size(), thread * slice);
+                    const std::uint64_t             last  = std::min<std::uint64_t>(batch.size(), first + slice);
+                    for (std::uint64_t i = first; i < last; ++i)
+                        add(parts[thread], std::string_view(batch[i]));
+                    sync.arrive_and_wait();
+                }
+            });
+            return finish(parts);
+        });
+    }
+
+private:
+    // one cache line each, readers of the two epochs do not share a line
+    struct alignas(64) reader_count
+    {
+        std::atomic<std::uint64_t> count;
+    };
+
+    const unsigned             threads;
+    mutable reader_count       readers[2];
+    std::atomic<std::uint64_t> epoch;
+    std::atomic<const filter*> live;
+    std::atomic<std::uint64_t> publishes;
+    std::mutex                 publishing;
+    std::thread                builder;
+
+    template <typename task>
+    std::future<bool> start(task&& work)
+    {
+        if (builder.joinable())
+            builder.join();
+
+        std::packaged_task<bool()> job(std::forward<task>(work));
+        std::future<bool>          result = job.get_future();
+        builder                           = std::thread(std::move(job));
+        return result;
+    }
+
+    // Typed keys go through the typed add where the filter has one, which
+    // hashes them the same as their bytes.
+    template <typename key>
+    static void add(filter& bf, const key& k)
+    {
+        if constexpr (std::convertible_to<const key&, std::string_view>)
+        {
+            const std::string_view chars(k);
+            bf.add(chars.data(), chars.size());
+        }
+        else if constexpr (requires { bf.add(k); })
+            bf.add(k);
+        else
+            bf.add(&k, sizeof(k));
+    }
+
+    // Reads up to BUILD_BATCH records into batch, false once there are none.
+    static bool read_batch(std::ifstream& in, char delimiter, std::vector<std::string>& batch)
+    {
+        batch.resize(BUILD_BATCH);
+        std::uint64_t count = 0;
+        while (count < BUILD_BATCH && std::getline(in, batch[count], delimiter))
+            ++count;
+        batch.resize(count);
+        return count > 0;
+    }
+
+    bool finish(std::vector<filter>& parts)
+    {
+        for (std::uint64_t i = 1; i < parts.size(); ++i)
+        {
+            if (!parts[0].merge(parts[i]))
+                return false;
+        }
+        publish(std::move(parts[0]));
+        return true;
+    }
+
+    // Runs work(thread) on the worker threads, the calling thread is thread 0.
+    template <typename worker>
+    void run(worker&& work)
+    {
+        std::vector<std::thread> pool;
+        pool.reserve(threads - 1);
+        for (unsigned thread = 1; thread < threads; ++thread)
+            pool.emplace_back(work, thread);
+        work(0);
+        for (auto& t : pool)
+            t.join();
+    }
+};
+
+} // BF
+#endif // FILTER_HANDLE_HPP
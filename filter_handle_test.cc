@@ -0,0 +1,130 @@
+#include "blocked_bloom_filter.hpp"
+#include "filter_handle.hpp"
+#include <atomic>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace BF
+{
+
+TEST(filter_handle_test, build_and_publish)
+{
+    BF::filter_handle<BF::bloom_filter<>> handle(4);
+    EXPECT_EQ(handle.version(), 0);
+    EXPECT_FALSE(handle.contains(std::uint64_t(1)));
+
+    std::vector<std::uint64_t> keys(100000);
+    for (std::uint64_t i = 0; i < keys.size(); ++i)
+        keys[i] = i;
+    std::future<bool> built = handle.build(std::move(keys), 100000, 0.01);
+    ASSERT_TRUE(built.get());
+    EXPECT_EQ(handle.version(), 1);
+    for (std::uint64_t i = 0; i < 100000; ++i)
+        ASSERT_TRUE(handle.contains(i));
+    EXPECT_EQ(handle.read([](const BF::bloom_filter<>& bf) { return bf.expected_elements(); }, std::uint64_t(0)), 100000);
+
+    // the same bits as a filter built on one thread
+    BF::bloom_filter<> single;
+    ASSERT_TRUE(single.config(100000, 0.01));
+    for (std::uint64_t i = 0; i < 100000; ++i)
+        ASSERT_TRUE(single.add(i));
+    EXPECT_TRUE(handle.read([&](const BF::bloom_filter<>& bf) { return std::memcmp(bf.raw(), single.raw(), bf.size()) == 0; }, false));
+
+    // a replacement
+    const std::vector<std::string> words = { "alpha", "beta", "gamma" };
+    ASSERT_TRUE(handle.build(words, 1000, 0.01).get());
+    EXPECT_EQ(handle.version(), 2);
+    EXPECT_TRUE(handle.contains(std::string_view("beta")));
+    EXPECT_FALSE(handle.contains(std::uint64_t(1)) && handle.contains(std::uint64_t(2)) && handle.contains(std::uint64_t(3)));
+
+    // a filter that cannot be configured is not published
+    EXPECT_FALSE(handle.build(words, 0, 0.01).get());
+    EXPECT_EQ(handle.version(), 2);
+
+    handle.publish(std::move(single));
+    EXPECT_EQ(handle.version(), 3);
+    EXPECT_TRUE(handle.contains(std::uint64_t(99999)));
+}
+
+TEST(filter_handle_test, build_file)
+{
+    const std::string path = ::testing::TempDir() + "filter_handle_test.txt";
+    {
+        std::ofstream out(path, std::ios::binary);
+        for (std::uint64_t i = 0; i < 200000; ++i)
+            out << "key-" << i << '\n';
+    }
+
+    for (const unsigned threads : { 1u, 3u })
+    {
+        BF::filter_handle<BF::blocked_bloom_filter<>> handle(threads);
+        ASSERT_TRUE(handle.build_file(path, 200000, 0.01).get());
+        for (std::uint64_t i = 0; i < 200000; ++i)
+        {
+            const std::string key = "key-" + std::to_string(i);
+            ASSERT_TRUE(handle.contains(key.data(), key.size())) << key;
+        }
+
+        std::uint64_t false_positive = 0;
+        for (std::uint64_t i = 200000; i < 300000; ++i)
+        {
+            const std::string key = "key-" + std::to_string(i);
+            false_positive += handle.contains(key.data(), key.size());
+        }
+        EXPECT_LE(false_positive / 100000.0, 0.02);
+    }
+
+    // other delimiters, and files that do not exist
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << "a,b,c";
+    }
+    BF::filter_handle<BF::bloom_filter<>> handle(2);
+    ASSERT_TRUE(handle.build_file(path, 100, 0.01, ',').get());
+    EXPECT_TRUE(handle.contains(std::string_view("c")));
+    EXPECT_FALSE(handle.build_file(path + ".missing", 100, 0.01).get());
+    EXPECT_EQ(handle.version(), 1);
+
+    std::remove(path.c_str());
+}
+
+TEST(filter_handle_test, readers_during_swaps)
+{
+    // readers never see a half built filter: every published filter
+    // contains all keys below 1000
+    BF::filter_handle<BF::bloom_filter<>> handle(2);
+    std::vector<std::uint64_t>            keys(1000);
+    for (std::uint64_t i = 0; i < keys.size(); ++i)
+        keys[i] = i;
+    ASSERT_TRUE(handle.build(keys, 2000, 0.01).get());
+
+    std::atomic<bool>          stop   = false;
+    std::atomic<std::uint64_t> misses = 0;
+    std::vector<std::thread>   readers;
+    for (int r = 0; r < 4; ++r)
+    {
+        readers.emplace_back([&, r]() {
+            for (std::uint64_t i = r; !stop; i = (i + 7) % 1000)
+                misses += !handle.contains(i);
+        });
+    }
+
+    for (std::uint64_t round = 1; round <= 20; ++round)
+    {
+        std::vector<std::uint64_t> next = keys;
+        next.push_back(1000 + round);
+        ASSERT_TRUE(handle.build(std::move(next), 2000, 0.01).get());
+    }
+    stop = true;
+    for (auto& reader : readers)
+        reader.join();
+
+    EXPECT_EQ(misses, 0);
+    EXPECT_EQ(handle.version(), 21);
+    EXPECT_TRUE(handle.contains(std::uint64_t(1020)));
+}
+
+} // BF
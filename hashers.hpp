@@ -0,0 +1,584 @@
+#ifndef BF_HASHERS_HPP
+#define BF_HASHERS_HPP
+
+#include "bloom_filter.hpp"
+
+namespace BF
+{
+
+// 64x64 -> 128 bit multiply, both halves are needed by xxh3 and wyhash
+__extension__ typedef unsigned __int128 uint128;
+
+// XXH3 from xxHash 0.8(https://github.com/Cyan4973/xxHash), scalar code
+// path. hash_64 and hash_128 produce the same values as XXH3_64bits_withSeed
+// and XXH3_128bits_withSeed. As a bloom_filter hasher the two halves of the
+// 128 bit hash are the base hashes.
+class xxh3
+{
+public:
+    // identify the hash function in persisted filters(see mapped_bloom_filter.hpp)
+    static constexpr std::uint32_t id           = 2;
+    static constexpr std::uint32_t default_seed = 0xbeefeebb;
+
+    hash128 operator()(const void* key, const std::uint64_t len, const std::uint32_t seed = default_seed) const
+    {
+        return hash_128(key, len, seed);
+    }
+
+    // Same as operator()(&key, 8, seed), without going through the bytes.
+    hash128 hash_u64(std::uint64_t key, const std::uint32_t seed = default_seed) const
+    {
+        return len_4to8_128(key, 8, seed);
+    }
+
+    // Same as operator()(key, len, seed) for a len known at compile time, only
+    // the code for that length range is left.
+    template <std::uint64_t len>
+    hash128 hash_fixed(const void* key, const std::uint32_t seed = default_seed) const
+    {
+        if constexpr (len <= 16)
+            return len_0to16_128((const std::uint8_t*)key, len, seed);
+        else if constexpr (len <= 128)
+            return len_17to128_128((const std::uint8_t*)key, len, seed);
+        else
+            return hash_128(key, len, seed);
+    }
+
+    static std::uint64_t hash_64(const void* key, const std::uint64_t len, std::uint64_t seed = 0)
+    {
+        const std::uint8_t* data = (const std::uint8_t*)key;
+        if (len <= 16)
+            return len_0to16_64(data, len, seed);
+        if (len <= 128)
+            return len_17to128_64(data, len, seed);
+        if (len <= MIDSIZE_MAX)
+            return len_129to240_64(data, len, seed);
+
+        std::uint8_t        secret[SECRET_SIZE];
+        const std::uint8_t* used = long_secret(seed, secret) ? secret : SECRET;
+        std::uint64_t       acc[8];
+        hash_long(data, len, used, acc);
+        return merge_accs(acc, used + 11, len * PRIME64_1);
+    }
+
+    // {low 64 bits, high 64 bits}
+    static hash128 hash_128(const void* key, const std::uint64_t len, std::uint64_t seed = 0)
+    {
+        const std::uint8_t* data = (const std::uint8_t*)key;
+        if (len <= 16)
+            return len_0to16_128(data, len, seed);
+        if (len <= 128)
+            return len_17to128_128(data, len, seed);
+        if (len <= MIDSIZE_MAX)
+            return len_129to240_128(data, len, seed);
+
+        std::uint8_t        secret[SECRET_SIZE];
+        const std::uint8_t* used = long_secret(seed, secret) ? secret : SECRET;
+        std::uint64_t       acc[8];
+        hash_long(data, len, used, acc);
+        return { merge_accs(acc, used + 11, len * PRIME64_1),
+                 merge_accs(acc, used + SECRET_SIZE - sizeof(acc) - 11, ~(len * PRIME64_2)) };
+    }
+
+private:
+    static constexpr std::uint64_t SECRET_SIZE = 192;
+    static constexpr std::uint64_t MIDSIZE_MAX = 240;
+    static constexpr std::uint64_t STRIPE_LEN  = 64;
+
+    static constexpr std::uint32_t PRIME32_1 = 0x9E3779B1U;
+    static constexpr std::uint32_t PRIME32_2 = 0x85EBCA77U;
+    static constexpr std::uint32_t PRIME32_3 = 0xC2B2AE3DU;
+    static constexpr std::uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+    static constexpr std::uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr std::uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+    static constexpr std::uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr std::uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+    static constexpr std::uint64_t PRIME_MX1 = 0x165667919E3779F9ULL;
+    static constexpr std::uint64_t PRIME_MX2 = 0x9FB21C651E98DF25ULL;
+
+    // the default secret of XXH3
+    static constexpr std::uint8_t SECRET[SECRET_SIZE] = {
+        0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+        0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+        0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+        0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+        0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+        0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+        0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+        0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+        0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+        0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+        0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+        0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+    };
+
+    static std::uint64_t read64(const std::uint8_t* p)
+    {
+        std::uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static std::uint32_t read32(const std::uint8_t* p)
+    {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static hash128 mul128(std::uint64_t a, std::uint64_t b)
+    {
+        const uint128 r = static_cast<uint128>(a) * b;
+        return { static_cast<std::uint64_t>(r), static_cast<std::uint64_t>(r >> 64) };
+    }
+
+    static std::uint64_t mul128_fold64(std::uint64_t a, std::uint64_t b)
+    {
+        const hash128 r = mul128(a, b);
+        return r.h1 ^ r.h2;
+    }
+
+    static std::uint64_t xxh64_avalanche(std::uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= PRIME64_2;
+        h ^= h >> 29;
+        h *= PRIME64_3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    static std::uint64_t avalanche(std::uint64_t h)
+    {
+        h ^= h >> 37;
+        h *= PRIME_MX1;
+        h ^= h >> 32;
+        return h;
+    }
+
+    static std::uint64_t rrmxmx(std::uint64_t h, std::uint64_t len)
+    {
+        h ^= std::rotl(h, 49) ^ std::rotl(h, 24);
+        h *= PRIME_MX2;
+        h ^= (h >> 35) + len;
+        h *= PRIME_MX2;
+        return h ^ (h >> 28);
+    }
+
+    static std::uint64_t mix16(const std::uint8_t* p, const std::uint8_t* secret, std::uint64_t seed)
+    {
+        return mul128_fold64(read64(p) ^ (read64(secret) + seed), read64(p + 8) ^ (read64(secret + 8) - seed));
+    }
+
+    static std::uint64_t len_0to16_64(const std::uint8_t* p, std::uint64_t len, std::uint64_t seed)
+    {
+        const std::uint8_t* s = SECRET;
+        if (len > 8)
+        {
+            const std::uint64_t lo  = read64(p) ^ ((read64(s + 24) ^ read64(s + 32)) + seed);
+            const std::uint64_t hi  = read64(p + len - 8) ^ ((read64(s + 40) ^ read64(s + 48)) - seed);
+            const std::uint64_t acc = len + __builtin_bswap64(lo) + hi + mul128_fold64(lo, hi);
+            return avalanche(acc);
+        }
+        if (len >= 4)
+        {
+            seed ^= static_cast<std::uint64_t>(__builtin_bswap32(static_cast<std::uint32_t>(seed))) << 32;
+            const std::uint64_t input = read32(p + len - 4) + (static_cast<std::uint64_t>(read32(p)) << 32);
+            return rrmxmx(input ^ ((read64(s + 8) ^ read64(s + 16)) - seed), len);
+        }
+        if (len > 0)
+        {
+            const std::uint32_t combined = (static_cast<std::uint32_t>(p[0]) << 16) | (static_cast<std::uint32_t>(p[len >> 1]) << 24)
+                                           | p[len - 1] | (static_cast<std::uint32_t>(len) << 8);
+            return xxh64_avalanche(combined ^ ((read32(s) ^ read32(s + 4)) + seed));
+        }
+        return xxh64_avalanche(seed ^ read64(s + 56) ^ read64(s + 64));
+    }
+
+    static std::uint64_t len_17to128_64(const std::uint8_t* p, std::uint64_t len, std::uint64_t seed)
+    {
+        std::uint64_t acc = len * PRIME64_1;
+        for (std::uint64_t i = (len - 1) / 32 + 1; i-- > 0;)
+        {
+            acc += mix16(p + 16 * i, SECRET + 32 * i, seed);
+            acc += mix16(p + len - 16 * (i + 1), SECRET + 32 * i + 16, seed);
+        }
+        return avalanche(acc);
+    }
+
+    static std::uint64_t len_129to240_64(const std::uint8_t* p, std::uint64_t len, std::uint64_t seed)
+    {
+        std::uint64_t acc = len * PRIME64_1;
+        for (std::uint64_t i = 0; i < 8; ++i)
+            acc += mix16(p + 16 * i, SECRET + 16 * i, seed);
+        acc = avalanche(acc);
+
+        std::uint64_t acc_end = mix16(p + len - 16, SECRET + 136 - 17, seed);
+        for (std::uint64_t i = 8; i < len / 16; ++i)
+            acc_end += mix16(p + 16 * i, SECRET + 16 * (i - 8) + 3, seed);
+        return avalanche(acc + acc_end);
+    }
+
+    static hash128 len_4to8_128(std::uint64_t input, std::uint64_t len, std::uint64_t seed)
+    {
+        const std::uint8_t* s = SECRET;
+        seed ^= static_cast<std::uint64_t>(__builtin_bswap32(static_cast<std::uint32_t>(seed))) << 32;
+        hash128 m = mul128(input ^ ((read64(s + 16) ^ read64(s + 24)) + seed), PRIME64_1 + (len << 2));
+        m.h2 += m.h1 << 1;
+        m.h1 ^= m.h2 >> 3;
+        m.h1 ^= m.h1 >> 35;
+        m.h1 *= PRIME_MX2;
+        m.h1 ^= m.h1 >> 28;
+        m.h2 = avalanche(m.h2);
+        return m;
+    }
+
+    [[gnu::always_inline]] static hash128 len_0to16_128(const std::uint8_t* p, std::uint64_t len, std::uint64_t seed)
+    {
+        const std::uint8_t* s = SECRET;
+        if (len > 8)
+        {
+            const std::uint64_t lo = read64(p);
+            const std::uint64_t hi = read64(p + len - 8) ^ ((read64(s + 48) ^ read64(s + 56)) + seed);
+            hash128             m  = mul128(lo ^ read64(p + len - 8) ^ ((read64(s + 32) ^ read64(s + 40)) - seed), PRIME64_1);
+            m.h1 += (len - 1) << 54;
+            m.h2 += hi + static_cast<std::uint64_t>(static_cast<std::uint32_t>(hi)) * (PRIME32_2 - 1);
+            m.h1 ^= __builtin_bswap64(m.h2);
+
+            hash128 h = mul128(m.h1, PRIME64_2);
+            h.h2 += m.h2 * PRIME64_2;
+            return { avalanche(h.h1), avalanche(h.h2) };
+        }
+        if (len >= 4)
+            return len_4to8_128(read32(p) + (static_cast<std::uint64_t>(read32(p + len - 4)) << 32), len, seed);
+        if (len > 0)
+        {
+            const std::uint32_t lo = (static_cast<std::uint32_t>(p[0]) << 16) | (static_cast<std::uint32_t>(p[len >> 1]) << 24)
+                                     | p[len - 1] | (static_cast<std::uint32_t>(len) << 8);
+            const std::uint32_t hi = std::rotl(__builtin_bswap32(lo), 13);
+            return { xxh64_avalanche(lo ^ ((read32(s) ^ read32(s + 4)) + seed)),
+                     xxh64_avalanche(hi ^ ((read32(s + 8) ^ read32(s + 12)) - seed)) };
+        }
+        return { xxh64_avalanche(seed ^ read64(s + 64) ^ read64(s + 72)), xxh64_avalanche(seed ^ read64(s + 80) ^ read64(s + 88)) };
+    }
+
+    static void mix32(hash128& acc, const std::uint8_t* p1, const std::uint8_t* p2, const std::uint8_t* secret, std::uint64_t seed)
+    {
+        acc.h1 += mix16(p1, secret, seed);
+        acc.h1 ^= read64(p2) + read64(p2 + 8);
+        acc.h2 += mix16(p2, secret + 16, seed);
+        acc.h2 ^= read64(p1) + read64(p1 + 8);
+    }
+
+    static hash128 finish_128(const hash128& acc, std::uint64_t len, std::uint64_t seed)
+    {
+        const std::uint64_t lo = acc.h1 + acc.h2;
+        const std::uint64_t hi = acc.h1 * PRIME64_1 + acc.h2 * PRIME64_4 + (len - seed) * PRIME64_2;
+        return { avalanche(lo), 0 - avalanche(hi) };
+    }
+
+    [[gnu::always_inline]] static hash128 len_17to128_128(const std::uint8_t* p, std::uint64_t len, std::uint64_t seed)
+    {
+        hash128 acc { len * PRIME64_1, 0 };
+        for (std::uint64_t i = (len - 1) / 32 + 1; i-- > 0;)
+            mix32(acc, p + 16 * i, p + len - 16 * (i + 1), SECRET + 32 * i, seed);
+        return finish_128(acc, len, seed);
+    }
+
+    static hash128 len_129to240_128(const std::uint8_t* p, std::uint64_t len, std::uint64_t seed)
+    {
+        hash128 acc { len * PRIME64_1, 0 };
+        for (std::uint64_t i = 32; i < 160; i += 32)
+            mix32(acc, p + i - 32, p + i - 16, SECRET + i - 32, seed);
+        acc.h1 = avalanche(acc.h1);
+        acc.h2 = avalanche(acc.h2);
+        for (std::uint64_t i = 160; i <= len; i += 32)
+            mix32(acc, p + i - 32, p + i - 16, SECRET + 3 + i - 160, seed);
+        mix32(acc, p + len - 16, p + len - 32, SECRET + 136 - 17 - 16, 0 - seed);
+        return finish_128(acc, len, seed);
+    }
+
+    // Inputs past MIDSIZE_MAX are hashed with a secret derived from the seed.
+    // Returns false, leaving secret alone, when the default one is used.
+    static bool long_secret(std::uint64_t seed, std::uint8_t* secret)
+    {
+        if (seed == 0)
+            return false;
+        for (std::uint64_t i = 0; i < SECRET_SIZE; i += 16)
+        {
+            const std::uint64_t lo = read64(SECRET + i) + seed;
+            const std::uint64_t hi = read64(SECRET + i + 8) - seed;
+            std::memcpy(secret + i, &lo, sizeof(lo));
+            std::memcpy(secret + i + 8, &hi, sizeof(hi));
+        }
+        return true;
+    }
+
+    static void accumulate_512(std::uint64_t* acc, const std::uint8_t* p, const std::uint8_t* secret)
+    {
+        for (std::uint64_t lane = 0; lane < 8; ++lane)
+        {
+            const std::uint64_t value = read64(p + lane * 8);
+            const std::uint64_t key   = value ^ read64(secret + lane * 8);
+            acc[lane ^ 1] += value;
+            acc[lane] += static_cast<std::uint64_t>(static_cast<std::uint32_t>(key)) * (key >> 32);
+        }
+    }
+
+    static void hash_long(const std::uint8_t* p, std::uint64_t len, const std::uint8_t* secret, std::uint64_t* acc)
+    {
+        const std::uint64_t init[8] = { PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1 };
+        std::memcpy(acc, init, sizeof(init));
+
+        const std::uint64_t stripes_per_block = (SECRET_SIZE - STRIPE_LEN) / 8;
+        const std::uint64_t block_len         = STRIPE_LEN * stripes_per_block;
+        const std::uint64_t blocks            = (len - 1) / block_len;
+
+        for (std::uint64_t n = 0; n < blocks; ++n)
+        {
+            for (std::uint64_t s = 0; s < stripes_per_block; ++s)
+                accumulate_512(acc, p + n * block_len + s * STRIPE_LEN, secret + s * 8);
+
+            // scramble
+            for (std::uint64_t lane = 0; lane < 8; ++lane)
+            {
+                std::uint64_t a = acc[lane];
+                a ^= a >> 47;
+                a ^= read64(secret + SECRET_SIZE - STRIPE_LEN + lane * 8);
+                a *= PRIME32_1;
+                acc[lane] = a;
+            }
+        }
+
+        const std::uint64_t stripes = ((len - 1) - block_len * blocks) / STRIPE_LEN;
+        for (std::uint64_t s = 0; s < stripes; ++s)
+            accumulate_512(acc, p + blocks * block_len + s * STRIPE_LEN, secret + s * 8);
+        accumulate_512(acc, p + len - STRIPE_LEN, secret + SECRET_SIZE - STRIPE_LEN - 7);
+    }
+
+    static std::uint64_t merge_accs(const std::uint64_t* acc, const std::uint8_t* secret, std::uint64_t start)
+    {
+        std::uint64_t result = start;
+        for (std::uint64_t i = 0; i < 4; ++i)
+            result += mul128_fold64(acc[2 * i] ^ read64(secret + 16 * i), acc[2 * i + 1] ^ read64(secret + 16 * i + 8));
+        return avalanche(result);
+    }
+};
+
+// wyhash, final version 4(https://github.com/wangyi-fudan/wyhash) with the
+// default secret. h1 is the 64 bit wyhash of the key, h2 is a second mix of
+// the same final state, so it costs one more multiply instead of hashing the
+// key twice.
+class wyhash
+{
+public:
+    // identify the hash function in persisted filters(see mapped_bloom_filter.hpp)
+    static constexpr std::uint32_t id           = 3;
+    static constexpr std::uint32_t default_seed = 0xbeefeebb;
+
+    hash128 operator()(const void* key, const std::uint64_t len, const std::uint32_t seed = default_seed) const
+    {
+        return hash(key, len, seed);
+    }
+
+    // Same as operator()(key, len, seed) for a len known at compile time.
+    template <std::uint64_t len>
+    hash128 hash_fixed(const void* key, const std::uint32_t seed = default_seed) const
+    {
+        return hash(key, len, seed);
+    }
+
+    // Same as operator()(&key, 8, seed), without going through the bytes.
+    hash128 hash_u64(std::uint64_t key, const std::uint32_t seed = default_seed) const
+    {
+        const std::uint64_t s = seed ^ mix(seed ^ SECRET[0], SECRET[1]);
+        return finish(std::rotl(key, 32), key, s, 8);
+    }
+
+private:
+    [[gnu::always_inline]] static hash128 hash(const void* key, const std::uint64_t len, const std::uint32_t seed)
+    {
+        const std::uint8_t* p = (const std::uint8_t*)key;
+        std::uint64_t       a = 0;
+        std::uint64_t       b = 0;
+        std::uint64_t       s = seed ^ mix(seed ^ SECRET[0], SECRET[1]);
+
+        if (len <= 16)
+        {
+            if (len >= 4)
+            {
+                const std::uint64_t shift = (len >> 3) << 2;
+                a                         = (read32(p) << 32) | read32(p + shift);
+                b                         = (read32(p + len - 4) << 32) | read32(p + len - 4 - shift);
+            }
+            else if (len > 0)
+                a = (static_cast<std::uint64_t>(p[0]) << 16) | (static_cast<std::uint64_t>(p[len >> 1]) << 8) | p[len - 1];
+        }
+        else
+        {
+            std::uint64_t i = len;
+            if (i > 48)
+            {
+                std::uint64_t s1 = s;
+                std::uint64_t s2 = s;
+                do
+                {
+                    s  = mix(read64(p) ^ SECRET[1], read64(p + 8) ^ s);
+                    s1 = mix(read64(p + 16) ^ SECRET[2], read64(p + 24) ^ s1);
+                    s2 = mix(read64(p + 32) ^ SECRET[3], read64(p + 40) ^ s2);
+                    p += 48;
+                    i -= 48;
+                } while (i > 48);
+                s ^= s1 ^ s2;
+            }
+            while (i > 16)
+            {
+                s = mix(read64(p) ^ SECRET[1], read64(p + 8) ^ s);
+                p += 16;
+                i -= 16;
+            }
+            a = read64(p + i - 16);
+            b = read64(p + i - 8);
+        }
+
+        return finish(a, b, s, len);
+    }
+
+    static constexpr std::uint64_t SECRET[4] = { 0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL };
+
+    static std::uint64_t read64(const std::uint8_t* p)
+    {
+        std::uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static std::uint64_t read32(const std::uint8_t* p)
+    {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static void mum(std::uint64_t& a, std::uint64_t& b)
+    {
+        const uint128 r = static_cast<uint128>(a) * b;
+        a               = static_cast<std::uint64_t>(r);
+        b               = static_cast<std::uint64_t>(r >> 64);
+    }
+
+    static std::uint64_t mix(std::uint64_t a, std::uint64_t b)
+    {
+        mum(a, b);
+        return a ^ b;
+    }
+
+    static hash128 finish(std::uint64_t a, std::uint64_t b, std::uint64_t s, std::uint64_t len)
+    {
+        a ^= SECRET[1];
+        b ^= s;
+        mum(a, b);
+        return { mix(a ^ SECRET[0] ^ len, b ^ SECRET[1]), mix(a ^ SECRET[2], b ^ SECRET[3] ^ len) };
+    }
+};
+
+// XXH64 from xxHash(https://github.com/Cyan4973/xxHash). Slower than xxh3,
+// it is here because file formats fix it, e.g. the split block bloom filters
+// of Parquet(see split_block_bloom_filter.hpp). hash_64 gives the plain XXH64
+// value, as a bloom_filter hasher h1 is XXH64 of the key and h2 a second mix
+// of it.
+class xxh64
+{
+public:
+    // identify the hash function in persisted filters(see mapped_bloom_filter.hpp)
+    static constexpr std::uint32_t id           = 4;
+    static constexpr std::uint32_t default_seed = 0xbeefeebb;
+
+    hash128 operator()(const void* key, const std::uint64_t len, const std::uint32_t seed = default_seed) const
+    {
+        const std::uint64_t h1 = hash_64(key, len, seed);
+        return { h1, avalanche(h1 ^ PRIME64_5) };
+    }
+
+    static std::uint64_t hash_64(const void* key, const std::uint64_t len, std::uint64_t seed = 0)
+    {
+        const std::uint8_t* p   = (const std::uint8_t*)key;
+        const std::uint8_t* end = p + len;
+        std::uint64_t       h;
+
+        if (len >= 32)
+        {
+            std::uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+            std::uint64_t v2 = seed + PRIME64_2;
+            std::uint64_t v3 = seed;
+            std::uint64_t v4 = seed - PRIME64_1;
+            do
+            {
+                v1 = round(v1, read64(p));
+                v2 = round(v2, read64(p + 8));
+                v3 = round(v3, read64(p + 16));
+                v4 = round(v4, read64(p + 24));
+                p += 32;
+            } while (end - p >= 32);
+
+            h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+            h = merge_round(h, v1);
+            h = merge_round(h, v2);
+            h = merge_round(h, v3);
+            h = merge_round(h, v4);
+        }
+        else
+            h = seed + PRIME64_5;
+
+        h += len;
+        for (; end - p >= 8; p += 8)
+            h = std::rotl(h ^ round(0, read64(p)), 27) * PRIME64_1 + PRIME64_4;
+        if (end - p >= 4)
+        {
+            h = std::rotl(h ^ (read32(p) * PRIME64_1), 23) * PRIME64_2 + PRIME64_3;
+            p += 4;
+        }
+        for (; p < end; ++p)
+            h = std::rotl(h ^ (*p * PRIME64_5), 11) * PRIME64_1;
+
+        return avalanche(h);
+    }
+
+private:
+    static constexpr std::uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+    static constexpr std::uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr std::uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+    static constexpr std::uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr std::uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+    static std::uint64_t read64(const std::uint8_t* p)
+    {
+        std::uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static std::uint64_t read32(const std::uint8_t* p)
+    {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static std::uint64_t round(std::uint64_t acc, std::uint64_t input) { return std::rotl(acc + input * PRIME64_2, 31) * PRIME64_1; }
+
+    static std::uint64_t merge_round(std::uint64_t acc, std::uint64_t v) { return (acc ^ round(0, v)) * PRIME64_1 + PRIME64_4; }
+
+    static std::uint64_t avalanche(std::uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= PRIME64_2;
+        h ^= h >> 29;
+        h *= PRIME64_3;
+        h ^= h >> 32;
+        return h;
+    }
+};
+
+} // BF
+#endif // BF_HASHERS_HPP
@@ -0,0 +1,216 @@
+#include "concurrent_bloom_filter.hpp"
+#include "hashers.hpp"
+#include "mapped_bloom_filter.hpp"
+#include <cstring>
+#include <gtest/gtest.h>
+#include <utility>
+
+namespace BF
+{
+
+static_assert(u64_hasher<murmur3> && u64_hasher<xxh3> && u64_hasher<wyhash>);
+static_assert(!bloom_hasher<int>);
+
+TEST(hashers_test, xxh3_reference)
+{
+    // from XXH3_64bits_withSeed(seed 0) and XXH3_128bits_withSeed(seed xxh3::default_seed) of xxHash 0.8.3
+    struct vector
+    {
+        const char*   key;
+        std::uint64_t h64;
+        std::uint64_t low;
+        std::uint64_t high;
+    };
+    const vector vectors[] = {
+        { "", 0x2d06800538d394c2, 0xb9f89d810533a29d, 0xfa90212a047929aa },
+        { "a", 0xe6c632b61e964e1f, 0x5aa811c7da7b4c71, 0xcefd0582798980d0 },
+        { "abc", 0x78af5f94892f3950, 0x4be1634f83255896, 0xa643c1e26a7f9059 },
+        { "message digest", 0x160d8e9329be94f9, 0x00d20c2e583e55f5, 0x39b8676b2de448c0 },
+        { "abcdefghijklmnopqrstuvwxyz", 0x810f9ca067fbb90c, 0x4ce76a7bdb150c8b, 0xbcd0670e4a4ef40a },
+        { "12345678901234567890123456789012345678901234567890123456789012345678901234567890", 0x7f58aa2520c681f9, 0x456c19cde633e3bb, 0xef1382a258b34ae4 },
+    };
+    for (const auto& v : vectors)
+    {
+        EXPECT_EQ(xxh3::hash_64(v.key, std::strlen(v.key)), v.h64) << v.key;
+        const hash128 h = xxh3 {}(v.key, std::strlen(v.key));
+        EXPECT_EQ(h.h1, v.low) << v.key;
+        EXPECT_EQ(h.h2, v.high) << v.key;
+    }
+
+    // past 240 bytes with a seed the long path derives its own secret
+    std::uint8_t bytes[2048];
+    for (std::uint64_t i = 0; i < sizeof(bytes); ++i)
+        bytes[i] = static_cast<std::uint8_t>(i * 131 + 7);
+    EXPECT_EQ(xxh3::hash_64(bytes, 1000, xxh3::default_seed), 0x220ddf64b5acc53b);
+    const hash128 h = xxh3 {}(bytes, 1000);
+    EXPECT_EQ(h.h1, 0x220ddf64b5acc53b);
+    EXPECT_EQ(h.h2, 0x6883c9f3e3112fd9);
+
+    // the first len bytes on both sides of every length range: 17-128,
+    // 129-240, the long path and its 1024 byte blocks
+    struct prefix
+    {
+        std::uint64_t len;
+        std::uint64_t h64;
+        std::uint64_t low;
+        std::uint64_t high;
+    };
+    const prefix prefixes[] = {
+        { 16, 0x86abf6baccea0858, 0x51f74f1f2dfc901e, 0x27aa387c78b633ff },
+        { 17, 0xb58bf5dc5022d071, 0xfdd7be8f8dcb0046, 0x19478d2b7de50132 },
+        { 128, 0x10d17f72c0ccba41, 0x0b696c2b2e2ab555, 0x82c095407288e262 },
+        { 129, 0x1648bdc3db49d1a2, 0xed8c4b3dc9aa6774, 0xcbfb1e7289ff779f },
+        { 240, 0xb6cfaf343fab81e6, 0x3857ed0447402a93, 0xb0ac2fad76ff45a9 },
+        { 241, 0x956cae592c67279e, 0x6c556c6cedfb8274, 0x638621972c484f9a },
+        { 500, 0x7ce64a364c324f8e, 0xff4c07211f0cc32f, 0x3d4bf656a49c3585 },
+        { 1024, 0x70bd377d9574f4bb, 0x66ff0fc058c8b1ca, 0x2454287229d4a60a },
+        { 1025, 0x66c4487c41e127a7, 0x770f03ab70ec5905, 0x7c211ad21d6e7bea },
+        { 2048, 0x8b46caa67dab3a30, 0x227a399f9f030228, 0x347c20496108914a },
+    };
+    for (const auto& v : prefixes)
+    {
+        EXPECT_EQ(xxh3::hash_64(bytes, v.len), v.h64) << v.len;
+        const hash128 prefix_hash = xxh3 {}(bytes, v.len);
+        EXPECT_EQ(prefix_hash.h1, v.low) << v.len;
+        EXPECT_EQ(prefix_hash.h2, v.high) << v.len;
+    }
+}
+
+TEST(hashers_test, xxh64_reference)
+{
+    // from XXH64(seed 0) of xxHash 0.8.3
+    const std::pair<const char*, std::uint64_t> vectors[] = {
+        { "", 0xef46db3751d8e999 },
+        { "a", 0xd24ec4f1a98c6e5b },
+        { "abc", 0x44bc2cf5ad770999 },
+        { "message digest", 0x066ed728fceeb3be },
+        { "abcdefghijklmnopqrstuvwxyz", 0xcfe1f278fa89835c },
+        { "12345678901234567890123456789012345678901234567890123456789012345678901234567890", 0xe04a477f19ee145d },
+    };
+    for (const auto& [key, expected] : vectors)
+    {
+        EXPECT_EQ(xxh64::hash_64(key, std::strlen(key)), expected) << key;
+        EXPECT_EQ(xxh64 {}(key, std::strlen(key), 0).h1, expected) << key;
+    }
+
+    std::uint8_t bytes[1000];
+    for (std::uint64_t i = 0; i < sizeof(bytes); ++i)
+        bytes[i] = static_cast<std::uint8_t>(i * 131 + 7);
+    EXPECT_EQ(xxh64::hash_64(bytes, sizeof(bytes), xxh64::default_seed), 0x888cbe56a70ca147);
+}
+
+TEST(hashers_test, wyhash_reference)
+{
+    // the test vectors of wyhash final version 4, key i hashed with seed i
+    const char* keys[] = { "", "a", "abc", "message digest", "abcdefghijklmnopqrstuvwxyz",
+                           "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",
+                           "12345678901234567890123456789012345678901234567890123456789012345678901234567890" };
+    const std::uint64_t expected[] = { 0x93228a4de0eec5a2, 0xc5bac3db178713c4, 0xa97f2f7b1d9b3314, 0x786d1f1df3801df4,
+                                       0xdca5a8138ad37c87, 0xb9e734f117cfaf70, 0x6cc5eab49a92d617 };
+    for (std::uint32_t i = 0; i < 7; ++i)
+        EXPECT_EQ(wyhash {}(keys[i], std::strlen(keys[i]), i).h1, expected[i]) << keys[i];
+}
+
+template <typename hasher>
+void check_hash_u64()
+{
+    const hasher h;
+    for (std::uint64_t key : { std::uint64_t(0), std::uint64_t(1), std::uint64_t(0xdeadbeef), ~std::uint64_t(0) })
+    {
+        const hash128 fast  = h.hash_u64(key);
+        const hash128 bytes = h(&key, sizeof(key));
+        EXPECT_EQ(fast.h1, bytes.h1);
+        EXPECT_EQ(fast.h2, bytes.h2);
+    }
+
+    // keys added either way are found either way
+    bloom_filter<hasher> bf;
+    ASSERT_TRUE(bf.config(2000, 0.01));
+    for (std::uint64_t i = 0; i < 2000; ++i)
+        ASSERT_TRUE(i % 2 ? bf.add(&i, sizeof(i)) : bf.add(i));
+    for (std::uint64_t i = 0; i < 2000; ++i)
+    {
+        EXPECT_TRUE(bf.contains(i));
+        EXPECT_TRUE(bf.contains(&i, sizeof(i)));
+    }
+
+    std::uint64_t false_positive = 0;
+    for (std::uint64_t i = 2000; i < 102000; ++i)
+        false_positive += bf.contains(i);
+    EXPECT_LE(false_positive / 100000.0, 0.015);
+}
+
+TEST(hashers_test, hash_u64)
+{
+    check_hash_u64<murmur3>();
+    check_hash_u64<xxh3>();
+    check_hash_u64<wyhash>();
+
+    // hashers without the fast path take the byte loop
+    class legacy_murmur3
+    {
+    public:
+        void operator()(const void* key, const std::uint64_t len, std::uint64_t k, hashes& out) const
+        {
+            murmur3()(key, len, k, out);
+        }
+    };
+    static_assert(bloom_hasher<legacy_murmur3> && !u64_hasher<legacy_murmur3>);
+
+    bloom_filter<legacy_murmur3> legacy;
+    ASSERT_TRUE(legacy.config(1000, 0.01));
+    const std::uint64_t key = 42;
+    ASSERT_TRUE(legacy.add(key));
+    EXPECT_TRUE(legacy.contains(&key, sizeof(key)));
+}
+
+template <typename hasher, std::uint64_t... lens>
+void check_hash_fixed(const std::uint8_t* bytes, std::integer_sequence<std::uint64_t, lens...>)
+{
+    const hasher h;
+    const auto   check = [&](std::uint64_t len, const hash128& fixed) {
+        const hash128 expected = h(bytes, len);
+        EXPECT_EQ(fixed.h1, expected.h1) << len;
+        EXPECT_EQ(fixed.h2, expected.h2) << len;
+    };
+    (check(lens, h.template hash_fixed<lens>(bytes)), ...);
+}
+
+TEST(hashers_test, hash_fixed)
+{
+    static_assert(fixed_hasher<murmur3, 12> && fixed_hasher<xxh3, 12> && fixed_hasher<wyhash, 12>);
+
+    std::uint8_t bytes[300];
+    for (std::uint64_t i = 0; i < sizeof(bytes); ++i)
+        bytes[i] = static_cast<std::uint8_t>(i * 131 + 7);
+
+    // every murmur3 tail and block count, every xxh3 and wyhash length range
+    check_hash_fixed<murmur3>(bytes, std::make_integer_sequence<std::uint64_t, 50>());
+    check_hash_fixed<xxh3>(bytes, std::make_integer_sequence<std::uint64_t, 50>());
+    check_hash_fixed<wyhash>(bytes, std::make_integer_sequence<std::uint64_t, 50>());
+    check_hash_fixed<xxh3>(bytes, std::integer_sequence<std::uint64_t, 127, 128, 129, 200, 240, 241, 300>());
+    check_hash_fixed<wyhash>(bytes, std::integer_sequence<std::uint64_t, 64, 100, 200, 300>());
+}
+
+TEST(hashers_test, filters)
+{
+    // every filter takes the new hashers and persists their id
+    concurrent_bloom_filter<xxh3> concurrent;
+    ASSERT_TRUE(concurrent.config(1000, 0.01));
+    for (std::uint64_t i = 0; i < 1000; ++i)
+        ASSERT_TRUE(concurrent.add(&i, sizeof(i)));
+
+    const bloom_filter<xxh3> bf   = concurrent.snapshot();
+    const std::string        path = ::testing::TempDir() + "hashers_test.bf";
+    ASSERT_TRUE(save(bf, path));
+
+    mapped_bloom_filter<wyhash> other;
+    EXPECT_FALSE(other.open(path));
+    mapped_bloom_filter<xxh3> mapped;
+    ASSERT_TRUE(mapped.open(path));
+    for (std::uint64_t i = 0; i < 1000; ++i)
+        EXPECT_TRUE(mapped.contains(&i, sizeof(i)));
+    std::remove(path.c_str());
+}
+
+} // BF
@@ -0,0 +1,111 @@
+#ifndef HUGE_PAGE_ALLOCATOR_HPP
+#define HUGE_PAGE_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include <sys/mman.h>
+
+namespace BF
+{
+
+// The pages huge_page_allocator asks for.
+enum class huge_pages
+{
+    transparent, // 2 MB aligned anonymous memory with MADV_HUGEPAGE
+    explicit_2mb, // MAP_HUGETLB pages of 2 MB from the preallocated pool
+    explicit_1gb, // MAP_HUGETLB pages of 1 GB from the preallocated pool
+};
+
+// Allocator for the bits of large filters. Random probes into a filter of a
+// few hundred MB miss the TLB on almost every lookup with 4 KB pages; with
+// 2 MB or 1 GB pages the page walks mostly go away. Use it as the last
+// template parameter of bloom_filter, e.g.
+//   bloom_filter<murmur3, modulo_index, no_stats, huge_page_allocator<std::uint64_t>>
+//
+// Allocations below a huge page come from operator new, 64 byte aligned like
+// aligned_allocator. Larger ones are mmap'd. The explicit page sizes need
+// pages reserved in /proc/sys/vm/nr_hugepages(or the 1 GB pool); if there
+// are none the allocation falls back to transparent huge pages, and if the
+// kernel has those disabled the mapping simply stays on 4 KB pages. The
+// mapping is rounded up to the page size, the part past count is never
+// touched and so costs address space only.
+template <typename T, huge_pages pages = huge_pages::transparent>
+class huge_page_allocator
+{
+public:
+    typedef T value_type;
+
+    static constexpr std::size_t SMALL_ALIGNMENT = 64;
+    static constexpr std::size_t HUGE_PAGE       = std::size_t(2) << 20;
+    static constexpr std::size_t PAGE            = pages == huge_pages::explicit_1gb ? std::size_t(1) << 30 : HUGE_PAGE;
+
+    template <typename U>
+    struct rebind
+    {
+        typedef huge_page_allocator<U, pages> other;
+    };
+
+    huge_page_allocator() = default;
+
+    template <typename U>
+    huge_page_allocator(const huge_page_allocator<U, pages>&)
+    {
+    }
+
+    T* allocate(std::size_t count)
+    {
+        const std::size_t bytes = count * sizeof(T);
+        if (bytes < HUGE_PAGE)
+            return static_cast<T*>(::operator new(bytes, std::align_val_t(SMALL_ALIGNMENT)));
+
+        const std::size_t length = mapping_length(bytes);
+        if constexpr (pages != huge_pages::transparent)
+        {
+            const int page_flag = (pages == huge_pages::explicit_1gb ? 30 : 21) << MAP_HUGE_SHIFT;
+            void*     addr      = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | page_flag, -1, 0);
+            if (addr != MAP_FAILED)
+                return static_cast<T*>(addr);
+        }
+
+        // over-allocate by a huge page and trim, so the mapping starts on a
+        // huge page boundary and the kernel can back all of it with them
+        void* addr = ::mmap(nullptr, length + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED)
+            throw std::bad_alloc();
+
+        const std::uintptr_t start   = reinterpret_cast<std::uintptr_t>(addr);
+        const std::uintptr_t aligned = (start + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+        if (aligned > start)
+            ::munmap(addr, aligned - start);
+        if (aligned + length < start + length + HUGE_PAGE)
+            ::munmap(reinterpret_cast<void*>(aligned + length), start + HUGE_PAGE - aligned);
+
+        ::madvise(reinterpret_cast<void*>(aligned), length, MADV_HUGEPAGE);
+        return reinterpret_cast<T*>(aligned);
+    }
+
+    void deallocate(T* ptr, std::size_t count)
+    {
+        const std::size_t bytes = count * sizeof(T);
+        if (bytes < HUGE_PAGE)
+            ::operator delete(ptr, std::align_val_t(SMALL_ALIGNMENT));
+        else
+            ::munmap(ptr, mapping_length(bytes));
+    }
+
+    template <typename U>
+    bool operator==(const huge_page_allocator<U, pages>&) const
+    {
+        return true;
+    }
+
+private:
+    // The same for the explicit mapping and the fallback, so deallocate does
+    // not need to know which one allocate got.
+    static std::size_t mapping_length(std::size_t bytes) { return (bytes + PAGE - 1) & ~(PAGE - 1); }
+};
+
+} // BF
+#endif // HUGE_PAGE_ALLOCATOR_HPP
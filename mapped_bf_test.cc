@@ -0,0 +1,133 @@
+#include "mapped_bloom_filter.hpp"
+#include <fstream>
+#include <gtest/gtest.h>
+
+namespace BF
+{
+
+namespace
+{
+
+struct unnamed_hasher
+{
+    hash128 operator()(const void* key, const std::uint64_t len) const { return murmur3 {}(key, len); }
+};
+
+// flips the byte at offset of the file at path
+void corrupt(const std::string& path, std::uint64_t offset)
+{
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekg(offset);
+    const char byte = file.get();
+    file.seekp(offset);
+    file.put(~byte);
+}
+
+} // namespace
+
+TEST(mapped_bf_test, save_and_open)
+{
+    const std::string path = ::testing::TempDir() + "mapped_bf_test.bf";
+
+    BF::bloom_filter bf;
+    ASSERT_TRUE(bf.config(10000, 0.01));
+    for (std::uint64_t i = 0; i < 10000; ++i)
+        ASSERT_TRUE(bf.add(&i, sizeof(i)));
+    ASSERT_TRUE(BF::save(bf, path));
+
+    {
+        BF::mapped_bloom_filter mapped;
+        ASSERT_TRUE(mapped.open(path));
+        EXPECT_TRUE(mapped.is_open());
+        EXPECT_EQ(mapped.bit_count(), bf.bit_count());
+        EXPECT_EQ(mapped.hash_count(), bf.hash_count());
+        EXPECT_EQ(mapped.expected_elements(), bf.expected_elements());
+        EXPECT_EQ(mapped.false_positive(), bf.false_positive());
+        ASSERT_EQ(mapped.size(), bf.size());
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(mapped.raw()) % 64, 0);
+        EXPECT_EQ(std::memcmp(mapped.raw(), bf.raw(), bf.size()), 0);
+        EXPECT_TRUE(mapped.verify());
+
+        for (std::uint64_t i = 0; i < 20000; ++i)
+            EXPECT_EQ(mapped.contains(&i, sizeof(i)), bf.contains(&i, sizeof(i)));
+
+        // the mapping outlives a replacement of the file
+        BF::bloom_filter other;
+        ASSERT_TRUE(other.config(100, 0.1));
+        ASSERT_TRUE(BF::save(other, path));
+        EXPECT_EQ(mapped.bit_count(), bf.bit_count());
+        EXPECT_TRUE(mapped.verify());
+
+        BF::mapped_bloom_filter moved = std::move(mapped);
+        EXPECT_FALSE(mapped.is_open());
+        EXPECT_FALSE(mapped.contains("a", 1));
+        EXPECT_TRUE(moved.is_open());
+
+        moved.close();
+        EXPECT_FALSE(moved.is_open());
+        EXPECT_EQ(moved.raw(), nullptr);
+        EXPECT_FALSE(moved.verify());
+        EXPECT_TRUE(moved.open(path));
+        EXPECT_EQ(moved.bit_count(), other.bit_count());
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST(mapped_bf_test, rejects_bad_files)
+{
+    const std::string path = ::testing::TempDir() + "mapped_bf_test_bad.bf";
+
+    BF::mapped_bloom_filter mapped;
+    EXPECT_FALSE(mapped.open(path + ".missing"));
+
+    BF::bloom_filter empty;
+    EXPECT_FALSE(BF::save(empty, path));
+
+    BF::bloom_filter bf;
+    ASSERT_TRUE(bf.config(1000, 0.01));
+    ASSERT_TRUE(bf.add("key", 3));
+
+    // a flipped bit still opens but fails the checksum
+    ASSERT_TRUE(BF::save(bf, path));
+    corrupt(path, sizeof(BF::file_header) + 1);
+    ASSERT_TRUE(mapped.open(path));
+    EXPECT_FALSE(mapped.verify());
+
+    ASSERT_TRUE(BF::save(bf, path));
+    corrupt(path, 0); // magic
+    EXPECT_FALSE(mapped.open(path));
+    EXPECT_FALSE(mapped.is_open());
+
+    ASSERT_TRUE(BF::save(bf, path));
+    corrupt(path, offsetof(BF::file_header, version));
+    EXPECT_FALSE(mapped.open(path));
+
+    {
+        // a size that does not match m
+        ASSERT_TRUE(BF::save(bf, path));
+        std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::app);
+        file.put(0);
+    }
+    EXPECT_FALSE(mapped.open(path));
+
+    // written with a different hasher
+    BF::bloom_filter<unnamed_hasher> unnamed;
+    ASSERT_TRUE(unnamed.config(1000, 0.01));
+    ASSERT_TRUE(BF::save(unnamed, path));
+    EXPECT_FALSE(mapped.open(path));
+    BF::mapped_bloom_filter<unnamed_hasher> mapped_unnamed;
+    EXPECT_TRUE(mapped_unnamed.open(path));
+
+    // or index policy
+    BF::bloom_filter<BF::murmur3, BF::pow2_index> pow2;
+    ASSERT_TRUE(pow2.config(1000, 0.01));
+    ASSERT_TRUE(BF::save(pow2, path));
+    EXPECT_FALSE(mapped.open(path));
+    BF::mapped_bloom_filter<BF::murmur3, BF::pow2_index> mapped_pow2;
+    EXPECT_TRUE(mapped_pow2.open(path));
+
+    std::remove(path.c_str());
+}
+
+} // BF
@@ -0,0 +1,298 @@
+#ifndef MAPPED_BLOOM_FILTER_HPP
+#define MAPPED_BLOOM_FILTER_HPP
+
+#include "bloom_filter.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace BF
+{
+
+// On-disk layout of a bloom_filter: this 64 byte header followed by the bytes
+// of raw(). The bits start on a cache line so they can be used in place once
+// mapped.
+struct file_header
+{
+    char          magic[8]; // FILE_MAGIC
+    std::uint32_t version;  // FILE_VERSION
+    std::uint32_t hasher_id;
+    std::uint32_t seed;
+    std::uint32_t index_id; // id of the index policy
+    std::uint64_t m;
+    std::uint64_t k;
+    std::uint64_t n;
+    double        p;
+    std::uint64_t checksum; // murmur3 of the bits
+};
+
+static_assert(sizeof(file_header) == 64);
+
+constexpr char          FILE_MAGIC[8] = { 'B', 'F', 'I', 'L', 'T', 'E', 'R', '\0' };
+constexpr std::uint32_t FILE_VERSION  = 1;
+
+// The id and seed of a hasher as written to the header. Hashers without an
+// id are stored as 0 and can only be read back by other hashers without one.
+template <typename hasher>
+constexpr std::uint32_t hasher_id()
+{
+    if constexpr (requires { hasher::id; })
+        return hasher::id;
+    else
+        return 0;
+}
+
+template <typename hasher>
+constexpr std::uint32_t hasher_seed()
+{
+    if constexpr (requires { hasher::default_seed; })
+        return hasher::default_seed;
+    else
+        return 0;
+}
+
+inline std::uint64_t file_checksum(const std::uint8_t* bits, std::uint64_t size)
+{
+    return murmur3 {}(bits, size).h1;
+}
+
+// Whether a filter of this hasher and index policy can read the bits that
+// follow header.
+template <typename hasher, typename index>
+bool readable_header(const file_header& header)
+{
+    return std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0 && header.version == FILE_VERSION
+        && header.hasher_id == hasher_id<hasher>() && header.seed == hasher_seed<hasher>() && header.index_id == index::id
+        && index::round_m(header.m) == header.m && header.m != 0 && header.k != 0 && header.n != 0 && header.p > 0.0 && header.p < 1.0;
+}
+
+// The header save() writes for bf.
+template <typename hasher, typename index, typename stats_policy, typename allocator>
+file_header make_header(const bloom_filter<hasher, index, stats_policy, allocator>& bf)
+{
+    file_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.version   = FILE_VERSION;
+    header.hasher_id = hasher_id<hasher>();
+    header.seed      = hasher_seed<hasher>();
+    header.index_id  = index::id;
+    header.m         = bf.bit_count();
+    header.k         = bf.hash_count();
+    header.n         = bf.expected_elements();
+    header.p         = bf.false_positive();
+    header.checksum  = file_checksum(bf.raw(), bf.size());
+    return header;
+}
+
+// Writes bf to path. The file is written next to path and renamed over it
+// when complete, so processes that have the old file mapped keep reading
+// the old bits instead of crashing on a truncated mapping.
+template <typename hasher, typename index, typename stats_policy, typename allocator>
+bool save(const bloom_filter<hasher, index, stats_policy, allocator>& bf, const std::string& path)
+{
+    if (!bf.raw())
+        return false;
+
+    const file_header header = make_header(bf);
+
+    const std::string tmp_path = path + ".tmp";
+    const int         fd       = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    auto write_all = [fd](const void* data, std::uint64_t len) {
+        const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+        while (len > 0)
+        {
+            const ssize_t written = ::write(fd, bytes, len);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                return false;
+            bytes += written;
+            len -= written;
+        }
+        return true;
+    };
+
+    const bool ok = write_all(&header, sizeof(header)) && write_all(bf.raw(), bf.size()) && ::fsync(fd) == 0;
+    if (::close(fd) != 0 || !ok || std::rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        ::unlink(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Read only bloom filter that queries a file written by save() directly from
+// the page cache. Opening it costs a mmap instead of reading the whole file,
+// pages are faulted in by the lookups that need them and processes that map
+// the same file share the memory.
+template <bloom_hasher hasher = murmur3, typename index = modulo_index>
+class mapped_bloom_filter
+{
+public:
+    mapped_bloom_filter()
+        : m(0)
+        , k(0)
+        , n(0)
+        , p(0.0)
+        , checksum(0)
+        , bits(nullptr)
+        , mapping(nullptr)
+        , mapping_size(0)
+    {
+    }
+
+    mapped_bloom_filter(const mapped_bloom_filter& other) = delete;
+
+    mapped_bloom_filter& operator=(const mapped_bloom_filter& other) = delete;
+
+    mapped_bloom_filter(mapped_bloom_filter&& other)
+        : mapped_bloom_filter()
+    {
+        *this = std::move(other);
+    }
+
+    mapped_bloom_filter& operator=(mapped_bloom_filter&& other)
+    {
+        if (this != &other)
+        {
+            close();
+            m            = other.m;
+            k            = other.k;
+            n            = other.n;
+            p            = other.p;
+            checksum     = other.checksum;
+            bits         = other.bits;
+            mapping      = other.mapping;
+            mapping_size = other.mapping_size;
+
+            other.m = other.k = other.n = other.checksum = other.mapping_size = 0;
+            other.p                                                           = 0.0;
+            other.bits                                                        = nullptr;
+            other.mapping                                                     = nullptr;
+        }
+        return *this;
+    }
+
+    ~mapped_bloom_filter() { close(); }
+
+    // Maps a file written by save(). Fails if the file is not one, is
+    // truncated or was written with a different hasher or index policy. The
+    // bits are not read, call verify() to check them against the stored
+    // checksum.
+    bool open(const std::string& path)
+    {
+        close();
+
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || static_cast<std::uint64_t>(info.st_size) < sizeof(file_header))
+        {
+            ::close(fd);
+            return false;
+        }
+
+        void* addr = ::mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // the mapping keeps the file alive
+        if (addr == MAP_FAILED)
+            return false;
+
+        file_header header;
+        std::memcpy(&header, addr, sizeof(header));
+        const std::uint64_t byte_count = header.m / 8 + static_cast<bool>(header.m & 7);
+
+        if (!readable_header<hasher, index>(header) || static_cast<std::uint64_t>(info.st_size) != sizeof(file_header) + byte_count)
+        {
+            ::munmap(addr, info.st_size);
+            return false;
+        }
+
+        // lookups jump all over the file, read ahead would only waste memory
+        ::madvise(addr, info.st_size, MADV_RANDOM);
+
+        m            = header.m;
+        k            = header.k;
+        n            = header.n;
+        p            = header.p;
+        checksum     = header.checksum;
+        mapping      = addr;
+        mapping_size = info.st_size;
+        bits         = static_cast<const std::uint8_t*>(addr) + sizeof(file_header);
+
+        return true;
+    }
+
+    void close()
+    {
+        if (mapping)
+            ::munmap(mapping, mapping_size);
+
+        m = k = n = checksum = mapping_size = 0;
+        p                                   = 0.0;
+        bits                                = nullptr;
+        mapping                             = nullptr;
+    }
+
+    bool is_open() const { return mapping != nullptr; }
+
+    // Reads all of the bits, so it costs as much as loading the file.
+    bool verify() const
+    {
+        if (!bits)
+            return false;
+        return file_checksum(bits, size()) == checksum;
+    }
+
+    std::uint64_t bit_count() const { return m; }
+
+    std::uint64_t hash_count() const { return k; }
+
+    std::uint64_t expected_elements() const { return n; }
+
+    double false_positive() const { return p; }
+
+    std::size_t size() const { return m / 8 + static_cast<bool>(m & 7); } // in bytes
+
+    const std::uint8_t* raw() const { return bits; }
+
+    bool contains(const void* key, const std::uint64_t len) const
+    {
+        if (!bits)
+            return false;
+
+        return for_each_hash(h, key, len, k, [this](std::uint64_t hash) {
+            const std::uint64_t abs_bit_id = idx(hash, m);
+            return (bits[abs_bit_id / 8] & BIT_POS[abs_bit_id & 7]) != 0;
+        });
+    }
+
+private:
+    static constexpr std::uint8_t BIT_POS[8] = { 0x1u, 0x2u, 0x4u, 0x8u, 0x10u, 0x20u, 0x40u, 0x80u };
+
+    std::uint64_t       m; // size in bits
+    std::uint64_t       k; // number of hashes
+    std::uint64_t       n; // expected number of elements
+    double              p; // false positive probability(> 0 && < 1)
+    std::uint64_t       checksum;
+    const std::uint8_t* bits; // inside of mapping, right after the header
+    void*               mapping;
+    std::uint64_t       mapping_size;
+    hasher              h;
+    index               idx;
+};
+
+} // BF
+#endif // MAPPED_BLOOM_FILTER_HPP
@@ -0,0 +1,128 @@
+#include "partitioned_bloom_filter.hpp"
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+
+namespace BF
+{
+
+TEST(partitioned_bf_test, parameters)
+{
+    BF::partitioned_bloom_filter bf;
+    EXPECT_FALSE(bf.add("a", 1));
+    EXPECT_FALSE(bf.contains("a", 1));
+    EXPECT_FALSE(bf.config(0, 0.01, 4));
+    EXPECT_FALSE(bf.config(1000, 1.0, 4));
+    EXPECT_FALSE(bf.config(1000, 0.01, 0));
+    EXPECT_FALSE(bf.config(1000, 0.01, 4, 0));
+
+    ASSERT_TRUE(bf.config(1001, 0.01, 4, 3));
+    EXPECT_EQ(bf.expected_elements(), 1001);
+    EXPECT_EQ(bf.false_positive(), 0.01);
+    ASSERT_EQ(bf.shard_count(), 4);
+
+    BF::bloom_filter single;
+    ASSERT_TRUE(single.config(251, 0.01)); // 1001 / 4 rounded up
+    for (std::uint64_t i = 0; i < bf.shard_count(); ++i)
+    {
+        EXPECT_EQ(bf.shard(i).bit_count(), single.bit_count());
+        EXPECT_EQ(bf.shard(i).hash_count(), single.hash_count());
+        EXPECT_EQ(bf.shard(i).expected_elements(), 251);
+    }
+    EXPECT_EQ(bf.size(), 4 * single.size());
+}
+
+TEST(partitioned_bf_test, add_contains)
+{
+    BF::partitioned_bloom_filter bf;
+    ASSERT_TRUE(bf.config(100000, 0.01, 16));
+    for (std::uint64_t i = 0; i < 100000; ++i)
+        ASSERT_TRUE(i % 2 ? bf.add(i) : bf.add(&i, sizeof(i)));
+    for (std::uint64_t i = 0; i < 100000; ++i)
+    {
+        EXPECT_TRUE(bf.contains(i));
+        EXPECT_TRUE(bf.contains(&i, sizeof(i)));
+    }
+
+    // the keys spread evenly over the shards
+    for (std::uint64_t i = 0; i < bf.shard_count(); ++i)
+        EXPECT_NEAR(static_cast<double>(bf.shard(i).approx_size()), 100000.0 / 16, 400);
+
+    std::uint64_t false_positive = 0;
+    for (std::uint64_t i = 100000; i < 200000; ++i)
+        false_positive += bf.contains(i);
+    EXPECT_LE(false_positive / 100000.0, 0.015);
+
+    ASSERT_TRUE(bf.add(std::string("a string key")));
+    EXPECT_TRUE(bf.contains("a string key"));
+}
+
+TEST(partitioned_bf_test, build)
+{
+    std::vector<std::uint64_t> keys(300001);
+    for (std::uint64_t i = 0; i < keys.size(); ++i)
+        keys[i] = i * 7919;
+
+    BF::partitioned_bloom_filter sequential;
+    ASSERT_TRUE(sequential.config(keys.size(), 0.01, 8));
+    for (const std::uint64_t key : keys)
+        ASSERT_TRUE(sequential.add(key));
+
+    // the same bits however many threads build it
+    for (const unsigned threads : { 1u, 3u, 8u })
+    {
+        BF::partitioned_bloom_filter parallel;
+        ASSERT_TRUE(parallel.config(keys.size(), 0.01, 8, threads));
+        ASSERT_TRUE(parallel.build(keys, threads));
+        for (std::uint64_t i = 0; i < parallel.shard_count(); ++i)
+            EXPECT_EQ(std::memcmp(parallel.shard(i).raw(), sequential.shard(i).raw(), sequential.shard(i).size()), 0) << threads;
+    }
+
+    const std::vector<std::string> words = { "alpha", "beta", "gamma", "delta" };
+    BF::partitioned_bloom_filter   strings;
+    ASSERT_TRUE(strings.config(100, 0.01, 4, 2));
+    ASSERT_TRUE(strings.build(words, 2));
+    for (const auto& word : words)
+        EXPECT_TRUE(strings.contains(word));
+
+    BF::partitioned_bloom_filter empty;
+    EXPECT_FALSE(empty.build(words, 2));
+}
+
+TEST(partitioned_bf_test, shards_round_trip)
+{
+    BF::partitioned_bloom_filter bf;
+    ASSERT_TRUE(bf.config(10000, 0.001, 5));
+    for (std::uint64_t i = 0; i < 10000; ++i)
+        ASSERT_TRUE(bf.add(i));
+
+    // every shard travels as an independent bloom_filter blob
+    std::vector<BF::bloom_filter<>> shards;
+    for (std::uint64_t i = 0; i < bf.shard_count(); ++i)
+    {
+        const auto&      shard = bf.shard(i);
+        BF::bloom_filter copy;
+        ASSERT_TRUE(copy.from(shard.bit_count(), shard.hash_count(), shard.expected_elements(), shard.false_positive(), shard.raw(), shard.size()));
+        shards.push_back(std::move(copy));
+    }
+
+    BF::partitioned_bloom_filter restored;
+    EXPECT_FALSE(restored.from(20000, 0.001, shards)); // different shape
+    ASSERT_TRUE(restored.from(10000, 0.001, shards));
+    for (std::uint64_t i = 0; i < 10000; ++i)
+        EXPECT_TRUE(restored.contains(i));
+
+    BF::partitioned_bloom_filter other;
+    ASSERT_TRUE(other.config(10000, 0.001, 5));
+    ASSERT_TRUE(other.add(std::uint64_t(123456789)));
+    ASSERT_TRUE(restored.merge(other));
+    EXPECT_TRUE(restored.contains(std::uint64_t(123456789)));
+
+    BF::partitioned_bloom_filter moved = std::move(restored);
+    EXPECT_EQ(restored.shard_count(), 0);
+    EXPECT_FALSE(restored.contains(std::uint64_t(1)));
+    EXPECT_TRUE(moved.contains(std::uint64_t(1)));
+    EXPECT_FALSE(moved.merge(restored));
+}
+
+} // BF
@@ -0,0 +1,290 @@
+#ifndef PARTITIONED_BLOOM_FILTER_HPP
+#define PARTITIONED_BLOOM_FILTER_HPP
+
+#include "bloom_filter.hpp"
+#include <atomic>
+#include <barrier>
+#include <ranges>
+#include <thread>
+
+namespace BF
+{
+
+// Bloom filter split into independent bloom_filter shards. The base hashes of
+// a key pick its shard, so a lookup hashes the key once and touches a single
+// shard, and disjoint sets of shards can be written by different threads
+// without any synchronization. build() uses that to add a large key set on
+// several threads.
+//
+// Shard s belongs to thread s % threads, both when config() allocates the
+// shards and when build() fills them. The bits of a shard are zeroed by its
+// thread, so on a NUMA machine with first touch placement they end up on the
+// node of the thread that later writes them. Pass the same number of threads
+// to both.
+template <bloom_hasher hasher = murmur3, typename index = modulo_index>
+class partitioned_bloom_filter
+{
+    static_assert(requires(const hasher& h, const void* key, std::uint64_t len) { { h(key, len) } -> std::convertible_to<hash128>; },
+                  "the hasher has to return hash128");
+
+public:
+    // keys hashed per thread before they are handed to the shard owners in build()
+    static constexpr std::uint64_t BUILD_BATCH = 1 << 16;
+
+    partitioned_bloom_filter()
+        : n(0)
+        , p(0.0)
+    {
+    }
+
+    partitioned_bloom_filter(const partitioned_bloom_filter& other) = default;
+
+    partitioned_bloom_filter& operator=(const partitioned_bloom_filter& other) = default;
+
+    partitioned_bloom_filter(partitioned_bloom_filter&& other)
+        : n(other.n)
+        , p(other.p)
+        , shards(std::move(other.shards))
+    {
+        other.n = 0;
+        other.p = 0.0;
+        other.shards.clear();
+    }
+
+    partitioned_bloom_filter& operator=(partitioned_bloom_filter&& other)
+    {
+        if (this != &other)
+        {
+            n      = other.n;
+            p      = other.p;
+            shards = std::move(other.shards);
+
+            other.n = 0;
+            other.p = 0.0;
+            other.shards.clear();
+        }
+        return *this;
+    }
+
+    // n keys over shard_count shards of n / shard_count(rounded up) keys
+    // each, at a false positive rate of p. The shards are allocated by
+    // threads threads, see above.
+    bool config(std::uint64_t n, double p, std::uint64_t shard_count, unsigned threads = 1)
+    {
+        if (p >= 1.0 || p <= 0.0 || n == 0 || shard_count == 0 || shard_count > n || threads == 0)
+            return false;
+
+        // all shard_count shards exist before any is configured, so the
+        // vector never grows and moves them while the bits are allocated
+        std::vector<bloom_filter<hasher, index>> configured;
+        configured.reserve(shard_count);
+        configured.resize(shard_count);
+        const std::uint64_t                      shard_n = shard_elements(n, shard_count);
+        std::atomic<bool>                        ok      = true;
+        run(threads, [&](unsigned thread) {
+            for (std::uint64_t s = thread; s < shard_count; s += threads)
+            {
+                if (!configured[s].config(shard_n, p))
+                    ok = false;
+            }
+        });
+        if (!ok)
+            return false;
+
+        this->n = n;
+        this->p = p;
+        shards  = std::move(configured);
+        return true;
+    }
+
+    std::uint64_t expected_elements() const { return n; }
+
+    double false_positive() const { return p; } // of every shard and so of the whole filter
+
+    std::uint64_t shard_count() const { return shards.size(); }
+
+    // Shard i. Every shard is a complete bloom_filter and can be serialized
+    // on its own.
+    const bloom_filter<hasher, index>& shard(std::uint64_t i) const { return shards[i]; }
+
+    std::size_t size() const // in bytes
+    {
+        std::size_t bytes = 0;
+        for (const auto& bf : shards)
+            bytes += bf.size();
+        return bytes;
+    }
+
+    bool add(const void* key, const std::uint64_t len)
+    {
+        if (shards.empty())
+            return false;
+
+        const hash128 base = h(key, len);
+        return shards[shard_of(base)].add_hash(base);
+    }
+
+    bool contains(const void* key, const std::uint64_t len) const
+    {
+        if (shards.empty())
+            return false;
+
+        const hash128 base = h(key, len);
+        return shards[shard_of(base)].contains_hash(base);
+    }
+
+    // Typed keys, see bloom_filter.
+    template <trivial_key T>
+    bool add(const T& key)
+    {
+        if (shards.empty())
+            return false;
+
+        const hash128 base = hash_key<sizeof(T)>(h, &key);
+        return shards[shard_of(base)].add_hash(base);
+    }
+
+    template <trivial_key T>
+    bool contains(const T& key) const
+    {
+        if (shards.empty())
+            return false;
+
+        const hash128 base = hash_key<sizeof(T)>(h, &key);
+        return shards[shard_of(base)].contains_hash(base);
+    }
+
+    bool add(std::string_view key) { return add(key.data(), key.size()); }
+
+    bool contains(std::string_view key) const { return contains(key.data(), key.size()); }
+
+    bool add(std::span<const std::byte> key) { return add(key.data(), key.size()); }
+
+    bool contains(std::span<const std::byte> key) const { return contains(key.data(), key.size()); }
+
+    // Adds every key of a random access range(of typed keys or strings) on
+    // threads threads. Each thread hashes its slice of the range and hands
+    // the hashes to the owners of their shards, which then set the bits of
+    // their own shards only, so no two threads ever write the same shard.
+    template <std::ranges::random_access_range range>
+        requires range_key<std::ranges::range_value_t<range>>
+    bool build(const range& keys, unsigned threads)
+    {
+        if (shards.empty() || threads == 0)
+            return false;
+
+        const std::uint64_t count = std::ranges::size(keys);
+        const std::uint64_t slice = count / threads + static_cast<bool>(count % threads);
+
+        // hashed[from][to] holds the keys thread from hashed for the shards of thread to
+        std::vector<std::vector<std::vector<hash128>>> hashed(threads, std::vector<std::vector<hash128>>(threads));
+        std::barrier                                   sync(threads);
+        run(threads, [&](unsigned thread) {
+            const std::uint64_t first = std::min(count, thread * slice);
+            const std::uint64_t last  = std::min(count, first + slice);
+            const std::uint64_t steps = slice / BUILD_BATCH + static_cast<bool>(slice % BUILD_BATCH);
+
+            // every thread takes the same number of steps so the barriers match
+            for (std::uint64_t step = 0; step < steps; ++step)
+            {
+                const std::uint64_t begin = std::min(last, first + step * BUILD_BATCH);
+                const std::uint64_t end   = std::min(last, begin + BUILD_BATCH);
+                for (std::uint64_t i = begin; i < end; ++i)
+                {
+                    const hash128 base = hash_range_key(h, std::ranges::begin(keys)[i]);
+                    hashed[thread][shard_of(base) % threads].push_back(base);
+                }
+                sync.arrive_and_wait();
+
+                for (unsigned from = 0; from < threads; ++from)
+                {
+                    for (const hash128& base : hashed[from][thread])
+                        shards[shard_of(base)].add_hash(base);
+                }
+                sync.arrive_and_wait();
+
+                for (auto& to : hashed[thread])
+                    to.clear();
+            }
+        });
+        return true;
+    }
+
+    // Union: afterwards the filter contains the keys of both.
+    bool merge(const partitioned_bloom_filter& other)
+    {
+        if (shards.empty() || n != other.n || p != other.p || shards.size() != other.shards.size())
+            return false;
+
+        for (std::uint64_t i = 0; i < shards.size(); ++i)
+        {
+            if (!shards[i].merge(other.shards[i]))
+                return false;
+        }
+        return true;
+    }
+
+    // Create a filter from the shards of an existing one. The shards are deep
+    // copied. Fails if a shard does not have the shape this filter would
+    // have given it.
+    bool from(std::uint64_t n, double p, const std::vector<bloom_filter<hasher, index>>& shards)
+    {
+        if (p >= 1.0 || p <= 0.0 || n == 0 || shards.empty() || shards.size() > n)
+            return false;
+
+        bloom_filter<hasher, index> shape;
+        if (!shape.config(shard_elements(n, shards.size()), p))
+            return false;
+
+        for (const auto& bf : shards)
+        {
+            if (bf.bit_count() != shape.bit_count() || bf.hash_count() != shape.hash_count()
+                || bf.expected_elements() != shape.expected_elements() || bf.false_positive() != shape.false_positive() || !bf.raw())
+                return false;
+        }
+
+        this->n      = n;
+        this->p      = p;
+        this->shards = shards;
+        return true;
+    }
+
+private:
+    std::uint64_t                            n; // expected number of elements over all shards
+    double                                   p; // false positive probability(> 0 && < 1)
+    std::vector<bloom_filter<hasher, index>> shards;
+    hasher                                   h;
+
+    // a vector of shards that grows moves them rather than copy their bits
+    static_assert(std::is_nothrow_move_constructible_v<bloom_filter<hasher, index>>);
+
+    static std::uint64_t shard_elements(std::uint64_t n, std::uint64_t shard_count)
+    {
+        return n / shard_count + static_cast<bool>(n % shard_count);
+    }
+
+    // The shard of a key from the top bits of a mix of both base hashes. The
+    // probes inside of the shard start with h1 and h2 themselves, so the keys
+    // of a shard must not agree on their top bits(fastrange_index).
+    std::uint64_t shard_of(const hash128& base) const
+    {
+        const std::uint64_t mixed = (base.h1 ^ std::rotl(base.h2, 32)) * 0x9e3779b97f4a7c15ULL;
+        return fastrange_index {}(mixed, shards.size());
+    }
+
+    // Runs work(thread) on threads threads, the calling thread is thread 0.
+    template <typename worker>
+    static void run(unsigned threads, worker&& work)
+    {
+        std::vector<std::thread> pool;
+        pool.reserve(threads - 1);
+        for (unsigned thread = 1; thread < threads; ++thread)
+            pool.emplace_back(work, thread);
+        work(0);
+        for (auto& t : pool)
+            t.join();
+    }
+};
+
+} // BF
+#endif // PARTITIONED_BLOOM_FILTER_HPP
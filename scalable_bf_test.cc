@@ -0,0 +1,108 @@
+#include "scalable_bloom_filter.hpp"
+#include <gtest/gtest.h>
+
+namespace BF
+{
+
+TEST(scalable_bf_test, parameters)
+{
+    BF::scalable_bloom_filter bf;
+    EXPECT_FALSE(bf.add("a", 1));
+    EXPECT_FALSE(bf.contains("a", 1));
+    EXPECT_FALSE(bf.config(0, 0.01));
+    EXPECT_FALSE(bf.config(100, 1.0));
+    EXPECT_FALSE(bf.config(100, 0.01, 0, 0.5));
+    EXPECT_FALSE(bf.config(100, 0.01, 2, 1.0));
+
+    ASSERT_TRUE(bf.config(1000, 0.01, 2, 0.5));
+    EXPECT_EQ(bf.expected_elements(), 1000);
+    EXPECT_EQ(bf.false_positive(), 0.01);
+    EXPECT_EQ(bf.growth_factor(), 2);
+    EXPECT_EQ(bf.tightening_ratio(), 0.5);
+    ASSERT_EQ(bf.stage_count(), 1);
+    EXPECT_EQ(bf.stage(0).expected_elements(), 1000);
+    EXPECT_EQ(bf.stage(0).false_positive(), 0.005);
+    EXPECT_EQ(bf.size(), bf.stage(0).size());
+}
+
+TEST(scalable_bf_test, grows)
+{
+    constexpr std::uint64_t N   = 1000;
+    constexpr double        FPR = 0.01;
+
+    BF::scalable_bloom_filter bf;
+    ASSERT_TRUE(bf.config(N, FPR));
+
+    // capacities 1000, 2000, 4000 and 8000
+    constexpr std::uint64_t ELEMENT_COUNT = 10 * N;
+    for (std::uint64_t i = 0; i < ELEMENT_COUNT; ++i)
+        ASSERT_TRUE(bf.add(&i, sizeof(i)));
+    EXPECT_EQ(bf.element_count(), ELEMENT_COUNT);
+    ASSERT_EQ(bf.stage_count(), 4);
+    EXPECT_EQ(bf.newest_stage_count(), ELEMENT_COUNT - 7 * N);
+    for (std::uint64_t i = 1; i < bf.stage_count(); ++i)
+    {
+        EXPECT_EQ(bf.stage(i).expected_elements(), 2 * bf.stage(i - 1).expected_elements());
+        EXPECT_LT(bf.stage(i).false_positive(), bf.stage(i - 1).false_positive());
+        EXPECT_GT(bf.stage(i).size(), bf.stage(i - 1).size());
+    }
+
+    for (std::uint64_t i = 0; i < ELEMENT_COUNT; ++i)
+        ASSERT_TRUE(bf.contains(&i, sizeof(i)));
+
+    // a plain filter sized for N would be useless by now
+    std::uint64_t false_positive = 0;
+    for (std::uint64_t i = ELEMENT_COUNT; i < 11 * ELEMENT_COUNT; ++i)
+        false_positive += bf.contains(&i, sizeof(i));
+    EXPECT_LE(static_cast<double>(false_positive) / (10 * ELEMENT_COUNT), FPR);
+
+    // hashing once for all stages answers the same as asking every stage
+    for (std::uint64_t i = ELEMENT_COUNT; i < 2 * ELEMENT_COUNT; ++i)
+    {
+        bool any = false;
+        for (std::uint64_t s = 0; s < bf.stage_count(); ++s)
+            any |= bf.stage(s).contains(&i, sizeof(i));
+        ASSERT_EQ(bf.contains(&i, sizeof(i)), any) << i;
+    }
+}
+
+TEST(scalable_bf_test, from_stages)
+{
+    BF::scalable_bloom_filter bf;
+    ASSERT_TRUE(bf.config(100, 0.01, 4, 0.9));
+    for (std::uint64_t i = 0; i < 1000; ++i)
+        ASSERT_TRUE(bf.add(&i, sizeof(i)));
+
+    // every stage goes through its own raw bytes
+    std::vector<BF::bloom_filter<>> stages(bf.stage_count());
+    for (std::uint64_t i = 0; i < bf.stage_count(); ++i)
+    {
+        const auto& stage = bf.stage(i);
+        ASSERT_TRUE(stages[i].from(stage.bit_count(), stage.hash_count(), stage.expected_elements(), stage.false_positive(), stage.raw(), stage.size()));
+    }
+
+    BF::scalable_bloom_filter copy;
+    EXPECT_FALSE(copy.from(100, 0.01, 2, 0.9, stages, bf.element_count(), bf.newest_stage_count())); // other growth
+    EXPECT_EQ(copy.stage_count(), 0);
+    EXPECT_FALSE(copy.from(100, 0.01, 4, 0.9, {}, 0, 0));
+    ASSERT_TRUE(copy.from(100, 0.01, 4, 0.9, stages, bf.element_count(), bf.newest_stage_count()));
+    EXPECT_EQ(copy.stage_count(), bf.stage_count());
+    EXPECT_EQ(copy.element_count(), bf.element_count());
+    for (std::uint64_t i = 0; i < 2000; ++i)
+        EXPECT_EQ(copy.contains(&i, sizeof(i)), bf.contains(&i, sizeof(i)));
+
+    // and keeps growing where the original left off
+    for (std::uint64_t i = 1000; i < 5000; ++i)
+    {
+        ASSERT_TRUE(bf.add(&i, sizeof(i)));
+        ASSERT_TRUE(copy.add(&i, sizeof(i)));
+    }
+    EXPECT_EQ(copy.stage_count(), bf.stage_count());
+
+    BF::scalable_bloom_filter moved = std::move(copy);
+    EXPECT_EQ(copy.stage_count(), 0);
+    EXPECT_FALSE(copy.add("a", 1));
+    EXPECT_EQ(moved.stage_count(), bf.stage_count());
+}
+
+} // BF
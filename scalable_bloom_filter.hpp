@@ -0,0 +1,252 @@
+#ifndef SCALABLE_BLOOM_FILTER_HPP
+#define SCALABLE_BLOOM_FILTER_HPP
+
+#include "bloom_filter.hpp"
+#include <limits>
+
+namespace BF
+{
+
+// Bloom filter that keeps its false positive rate when more keys than
+// expected are added(Almeida, Baquero, Preguica, Hutchison: "Scalable Bloom
+// Filters"). It is a chain of bloom_filter stages. Once the newest stage holds
+// as many keys as it was sized for, a new one with growth times the capacity
+// and tightening times the false positive rate is started. The rates form a
+// geometric series, the first one is p * (1 - tightening), so the rate of the
+// whole chain stays below p no matter how many stages there are.
+template <bloom_hasher hasher = murmur3, typename index = modulo_index>
+class scalable_bloom_filter
+{
+public:
+    static constexpr std::uint64_t DEFAULT_GROWTH     = 2;
+    static constexpr double        DEFAULT_TIGHTENING = 0.8;
+
+    scalable_bloom_filter()
+        : n(0)
+        , p(0.0)
+        , growth(0)
+        , tightening(0.0)
+        , elements(0)
+        , stage_elements(0)
+    {
+    }
+
+    scalable_bloom_filter(const scalable_bloom_filter& other) = default;
+
+    scalable_bloom_filter& operator=(const scalable_bloom_filter& other) = default;
+
+    scalable_bloom_filter(scalable_bloom_filter&& other)
+        : n(other.n)
+        , p(other.p)
+        , growth(other.growth)
+        , tightening(other.tightening)
+        , elements(other.elements)
+        , stage_elements(other.stage_elements)
+        , stages(std::move(other.stages))
+    {
+        other.n = other.growth = other.elements = other.stage_elements = 0;
+        other.p = other.tightening = 0.0;
+        other.stages.clear();
+    }
+
+    scalable_bloom_filter& operator=(scalable_bloom_filter&& other)
+    {
+        if (this != &other)
+        {
+            n              = other.n;
+            p              = other.p;
+            growth         = other.growth;
+            tightening     = other.tightening;
+            elements       = other.elements;
+            stage_elements = other.stage_elements;
+            stages         = std::move(other.stages);
+
+            other.n = other.growth = other.elements = other.stage_elements = 0;
+            other.p = other.tightening = 0.0;
+            other.stages.clear();
+        }
+        return *this;
+    }
+
+    // n is the capacity of the first stage and p the bound on the false
+    // positive rate of the whole filter.
+    bool config(std::uint64_t n, double p)
+    {
+        return config(n, p, DEFAULT_GROWTH, DEFAULT_TIGHTENING);
+    }
+
+    bool config(std::uint64_t n, double p, std::uint64_t growth, double tightening)
+    {
+        if (p >= 1.0 || p <= 0.0 || n == 0 || growth == 0 || tightening >= 1.0 || tightening <= 0.0)
+            return false;
+
+        this->n          = n;
+        this->p          = p;
+        this->growth     = growth;
+        this->tightening = tightening;
+        elements         = 0;
+        stage_elements   = 0;
+        stages.clear();
+
+        return add_stage();
+    }
+
+    std::uint64_t expected_elements() const { return n; } // of the first stage
+
+    std::uint64_t element_count() const { return elements; } // number of adds
+
+    std::uint64_t newest_stage_count() const { return stage_elements; } // adds to the newest stage
+
+    std::uint64_t growth_factor() const { return growth; }
+
+    double tightening_ratio() const { return tightening; }
+
+    double false_positive() const { return p; } // of the whole filter
+
+    std::uint64_t stage_count() const { return stages.size(); }
+
+    // Stage i, 0 is the oldest one. Every stage is a complete bloom_filter
+    // and can be serialized on its own.
+    const bloom_filter<hasher, index>& stage(std::uint64_t i) const { return stages[i]; }
+
+    std::size_t size() const // in bytes
+    {
+        std::size_t bytes = 0;
+        for (const auto& bf : stages)
+            bytes += bf.size();
+        return bytes;
+    }
+
+    bool add(const void* key, const std::uint64_t len)
+    {
+        if (stages.empty())
+            return false;
+
+        if (stage_elements >= stages.back().expected_elements() && !add_stage())
+            return false;
+
+        if (!stages.back().add(key, len))
+            return false;
+
+        ++elements;
+        ++stage_elements;
+        return true;
+    }
+
+    // The key is hashed once for all stages, unless the hasher only has the
+    // older (key, len, k, hashes&) form.
+    bool contains(const void* key, const std::uint64_t len) const
+    {
+        // the newest stage is the largest and holds most of the keys
+        if constexpr (requires { { h(key, len) } -> std::convertible_to<hash128>; })
+        {
+            const hash128 base = h(key, len);
+            for (auto it = stages.rbegin(); it != stages.rend(); ++it)
+            {
+                if (it->contains_hash(base))
+                    return true;
+            }
+        }
+        else
+        {
+            for (auto it = stages.rbegin(); it != stages.rend(); ++it)
+            {
+                if (it->contains(key, len))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // Create a filter from the stages of an existing one, oldest first,
+    // together with its element_count() and newest_stage_count(). The stages
+    // are deep copied. Fails if a stage does not have the shape this filter
+    // would have given it.
+    bool from(std::uint64_t                                   n,
+              double                                          p,
+              std::uint64_t                                   growth,
+              double                                          tightening,
+              const std::vector<bloom_filter<hasher, index>>& stages,
+              std::uint64_t                                   elements,
+              std::uint64_t                                   stage_elements)
+    {
+        if (p >= 1.0 || p <= 0.0 || n == 0 || growth == 0 || tightening >= 1.0 || tightening <= 0.0)
+            return false;
+
+        if (stages.empty() || stage_elements > elements)
+            return false;
+
+        for (std::uint64_t i = 0; i < stages.size(); ++i)
+        {
+            std::uint64_t stage_n = 0;
+            double        stage_p = 0.0;
+            stage_shape(n, p, growth, tightening, i, stage_n, stage_p);
+
+            std::uint64_t stage_m = 0;
+            std::uint64_t stage_k = 0;
+            if (!compute_m_k<index>(stage_n, stage_p, stage_m, stage_k, stage_p))
+                return false;
+
+            if (stages[i].bit_count() != stage_m || stages[i].hash_count() != stage_k
+                || stages[i].expected_elements() != stage_n || stages[i].false_positive() != stage_p || !stages[i].raw())
+                return false;
+        }
+
+        this->n              = n;
+        this->p              = p;
+        this->growth         = growth;
+        this->tightening     = tightening;
+        this->stages         = stages;
+        this->elements       = elements;
+        this->stage_elements = stage_elements;
+        return true;
+    }
+
+private:
+    std::uint64_t                            n; // capacity of the first stage
+    double                                   p; // false positive probability(> 0 && < 1)
+    std::uint64_t                            growth;
+    double                                   tightening;
+    std::uint64_t                            elements;       // added to all stages
+    std::uint64_t                            stage_elements; // added to the newest stage
+    std::vector<bloom_filter<hasher, index>> stages;
+    hasher                                   h;
+
+    // capacity and false positive rate of stage i
+    static void stage_shape(std::uint64_t  n,
+                            double         p,
+                            std::uint64_t  growth,
+                            double         tightening,
+                            std::uint64_t  i,
+                            std::uint64_t& stage_n,
+                            double&        stage_p)
+    {
+        stage_n = n;
+        stage_p = p * (1.0 - tightening);
+        for (std::uint64_t j = 0; j < i; ++j)
+        {
+            // stop growing rather than overflow
+            if (stage_n <= std::numeric_limits<std::uint64_t>::max() / growth)
+                stage_n *= growth;
+            stage_p *= tightening;
+        }
+    }
+
+    bool add_stage()
+    {
+        std::uint64_t stage_n = 0;
+        double        stage_p = 0.0;
+        stage_shape(n, p, growth, tightening, stages.size(), stage_n, stage_p);
+
+        bloom_filter<hasher, index> bf;
+        if (!bf.config(stage_n, stage_p))
+            return false;
+
+        stages.push_back(std::move(bf));
+        stage_elements = 0;
+        return true;
+    }
+};
+
+} // BF
+#endif // SCALABLE_BLOOM_FILTER_HPP
@@ -0,0 +1,424 @@
+#ifndef BF_SIMD_HPP
+#define BF_SIMD_HPP
+
+#include <cstdint>
+
+#if defined(__x86_64__)
+// gcc 12 flags _mm512_undefined_epi32 inside its own headers once optimizing
+// (https://gcc.gnu.org/bugzilla/show_bug.cgi?id=105593)
+#    pragma GCC diagnostic push
+#    pragma GCC diagnostic ignored "-Wuninitialized"
+#    pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#    include <immintrin.h>
+#    pragma GCC diagnostic pop
+#endif
+
+// Vector kernels with runtime instruction set selection. Every kernel is
+// compiled for its target through function attributes, so the rest of the
+// library does not need any -m flags and still runs on older cpus.
+namespace BF::simd
+{
+
+enum class level
+{
+    scalar,
+    avx2,
+    avx512
+};
+
+// The best instruction set supported by the cpu we are running on.
+inline level detect()
+{
+#if defined(__x86_64__)
+    static const level best = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq"))
+            return level::avx512;
+        if (__builtin_cpu_supports("avx2"))
+            return level::avx2;
+        return level::scalar;
+    }();
+    return best;
+#else
+    return level::scalar;
+#endif
+}
+
+#if defined(__x86_64__)
+
+#    define BF_AVX2 __attribute__((target("avx2")))
+#    define BF_AVX512 __attribute__((target("avx512f,avx512dq")))
+
+// AVX2 has no 64 bit multiply, it is assembled from 32 bit ones.
+BF_AVX2 inline __m256i mul64(__m256i a, __m256i b)
+{
+    const __m256i lo    = _mm256_mul_epu32(a, b);
+    const __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                           _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+template <int r>
+BF_AVX2 inline __m256i rotl64(__m256i x)
+{
+    return _mm256_or_si256(_mm256_slli_epi64(x, r), _mm256_srli_epi64(x, 64 - r));
+}
+
+BF_AVX2 inline __m256i fmix64(__m256i k)
+{
+    k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+    k = mul64(k, _mm256_set1_epi64x(0xff51afd7ed558ccdLL));
+    k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+    k = mul64(k, _mm256_set1_epi64x(0xc4ceb9fe1a85ec53LL));
+    return _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+}
+
+// murmur3 x64 128 of 4 keys of len bytes(a multiple of 8) stored back to
+// back at keys. Mirrors BF::murmur3 step by step.
+BF_AVX2 inline void murmur3_x4(const std::uint8_t* keys,
+                               std::uint64_t       len,
+                               std::uint32_t       seed,
+                               std::uint64_t*      h1_out,
+                               std::uint64_t*      h2_out)
+{
+    const __m256i       c1      = _mm256_set1_epi64x(0x87c37b91114253d5LL);
+    const __m256i       c2      = _mm256_set1_epi64x(0x4cf5ad432745937fLL);
+    const long long     stride  = static_cast<long long>(len);
+    const __m256i       offsets = _mm256_set_epi64x(3 * stride, 2 * stride, stride, 0);
+    const std::uint64_t nblocks = len / 16;
+    __m256i             h1      = _mm256_set1_epi64x(seed);
+    __m256i             h2      = h1;
+
+    for (std::uint64_t i = 0; i < nblocks; ++i)
+    {
+        const long long* block = reinterpret_cast<const long long*>(keys + i * 16);
+        __m256i          k1    = _mm256_i64gather_epi64(block, offsets, 1);
+        __m256i          k2    = _mm256_i64gather_epi64(block + 1, offsets, 1);
+
+        k1 = mul64(rotl64<31>(mul64(k1, c1)), c2);
+        h1 = _mm256_xor_si256(h1, k1);
+        h1 = _mm256_add_epi64(rotl64<27>(h1), h2);
+        h1 = _mm256_add_epi64(_mm256_add_epi64(_mm256_slli_epi64(h1, 2), h1), _mm256_set1_epi64x(0x52dce729));
+        k2 = mul64(rotl64<33>(mul64(k2, c2)), c1);
+        h2 = _mm256_xor_si256(h2, k2);
+        h2 = _mm256_add_epi64(rotl64<31>(h2), h1);
+        h2 = _mm256_add_epi64(_mm256_add_epi64(_mm256_slli_epi64(h2, 2), h2), _mm256_set1_epi64x(0x38495ab5));
+    }
+
+    if (len & 8)
+    {
+        const long long* tail = reinterpret_cast<const long long*>(keys + nblocks * 16);
+        const __m256i    k1   = _mm256_i64gather_epi64(tail, offsets, 1);
+        h1                    = _mm256_xor_si256(h1, mul64(rotl64<31>(mul64(k1, c1)), c2));
+    }
+
+    const __m256i length = _mm256_set1_epi64x(stride);
+    h1                   = _mm256_xor_si256(h1, length);
+    h2                   = _mm256_xor_si256(h2, length);
+    h1                   = _mm256_add_epi64(h1, h2);
+    h2                   = _mm256_add_epi64(h2, h1);
+    h1                   = fmix64(h1);
+    h2                   = fmix64(h2);
+    h1                   = _mm256_add_epi64(h1, h2);
+    h2                   = _mm256_add_epi64(h2, h1);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(h1_out), h1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(h2_out), h2);
+}
+
+BF_AVX512 inline __m512i fmix64(__m512i k)
+{
+    k = _mm512_xor_si512(k, _mm512_srli_epi64(k, 33));
+    k = _mm512_mullo_epi64(k, _mm512_set1_epi64(0xff51afd7ed558ccdLL));
+    k = _mm512_xor_si512(k, _mm512_srli_epi64(k, 33));
+    k = _mm512_mullo_epi64(k, _mm512_set1_epi64(0xc4ceb9fe1a85ec53LL));
+    return _mm512_xor_si512(k, _mm512_srli_epi64(k, 33));
+}
+
+// Same as murmur3_x4 for 8 keys, AVX-512DQ has a native 64 bit multiply and
+// AVX-512F a rotate.
+BF_AVX512 inline void murmur3_x8(const std::uint8_t* keys,
+                                 std::uint64_t       len,
+                                 std::uint32_t       seed,
+                                 std::uint64_t*      h1_out,
+                                 std::uint64_t*      h2_out)
+{
+    const __m512i       c1      = _mm512_set1_epi64(0x87c37b91114253d5LL);
+    const __m512i       c2      = _mm512_set1_epi64(0x4cf5ad432745937fLL);
+    const long long     stride  = static_cast<long long>(len);
+    const __m512i       offsets = _mm512_mullo_epi64(_mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0), _mm512_set1_epi64(stride));
+    const std::uint64_t nblocks = len / 16;
+    __m512i             h1      = _mm512_set1_epi64(seed);
+    __m512i             h2      = h1;
+
+    for (std::uint64_t i = 0; i < nblocks; ++i)
+    {
+        const std::uint8_t* block = keys + i * 16;
+        __m512i             k1    = _mm512_i64gather_epi64(offsets, block, 1);
+        __m512i             k2    = _mm512_i64gather_epi64(offsets, block + 8, 1);
+
+        k1 = _mm512_mullo_epi64(_mm512_rol_epi64(_mm512_mullo_epi64(k1, c1), 31), c2);
+        h1 = _mm512_xor_si512(h1, k1);
+        h1 = _mm512_add_epi64(_mm512_rol_epi64(h1, 27), h2);
+        h1 = _mm512_add_epi64(_mm512_add_epi64(_mm512_slli_epi64(h1, 2), h1), _mm512_set1_epi64(0x52dce729));
+        k2 = _mm512_mullo_epi64(_mm512_rol_epi64(_mm512_mullo_epi64(k2, c2), 33), c1);
+        h2 = _mm512_xor_si512(h2, k2);
+        h2 = _mm512_add_epi64(_mm512_rol_epi64(h2, 31), h1);
+        h2 = _mm512_add_epi64(_mm512_add_epi64(_mm512_slli_epi64(h2, 2), h2), _mm512_set1_epi64(0x38495ab5));
+    }
+
+    if (len & 8)
+    {
+        const __m512i k1 = _mm512_i64gather_epi64(offsets, keys + nblocks * 16, 1);
+        h1               = _mm512_xor_si512(h1, _mm512_mullo_epi64(_mm512_rol_epi64(_mm512_mullo_epi64(k1, c1), 31), c2));
+    }
+
+    const __m512i length = _mm512_set1_epi64(stride);
+    h1                   = _mm512_xor_si512(h1, length);
+    h2                   = _mm512_xor_si512(h2, length);
+    h1                   = _mm512_add_epi64(h1, h2);
+    h2                   = _mm512_add_epi64(h2, h1);
+    h1                   = fmix64(h1);
+    h2                   = fmix64(h2);
+    h1                   = _mm512_add_epi64(h1, h2);
+    h2                   = _mm512_add_epi64(h2, h1);
+
+    _mm512_storeu_si512(h1_out, h1);
+    _mm512_storeu_si512(h2_out, h2);
+}
+
+// Word array kernels, each returns how many words it handled. The rest is
+// left to the scalar loops in or_words/and_words/popcount_words.
+BF_AVX2 inline std::uint64_t or_words_x4(std::uint64_t* dst, const std::uint64_t* src, std::uint64_t count)
+{
+    std::uint64_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_or_si256(a, b));
+    }
+    return i;
+}
+
+BF_AVX2 inline std::uint64_t and_words_x4(std::uint64_t* dst, const std::uint64_t* src, std::uint64_t count)
+{
+    std::uint64_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_and_si256(a, b));
+    }
+    return i;
+}
+
+// Mula's nibble lookup: pshufb counts the bits of every nibble and psadbw
+// sums the byte counts into 64 bit lanes.
+BF_AVX2 inline std::uint64_t popcount_words_x4(const std::uint64_t* words, std::uint64_t count, std::uint64_t& total)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low    = _mm256_set1_epi8(0x0f);
+    __m256i       acc    = _mm256_setzero_si256();
+
+    std::uint64_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m256i v      = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+        const __m256i lo     = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low));
+        const __m256i hi     = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+        const __m256i nibble = _mm256_add_epi8(lo, hi);
+        acc                  = _mm256_add_epi64(acc, _mm256_sad_epu8(nibble, _mm256_setzero_si256()));
+    }
+
+    total += _mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1) + _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3);
+    return i;
+}
+
+BF_AVX512 inline std::uint64_t or_words_x8(std::uint64_t* dst, const std::uint64_t* src, std::uint64_t count)
+{
+    std::uint64_t i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm512_storeu_si512(dst + i, _mm512_or_si512(_mm512_loadu_si512(dst + i), _mm512_loadu_si512(src + i)));
+    return i;
+}
+
+BF_AVX512 inline std::uint64_t and_words_x8(std::uint64_t* dst, const std::uint64_t* src, std::uint64_t count)
+{
+    std::uint64_t i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm512_storeu_si512(dst + i, _mm512_and_si512(_mm512_loadu_si512(dst + i), _mm512_loadu_si512(src + i)));
+    return i;
+}
+
+// VPOPCNTDQ is not part of level::avx512, callers check has_popcount_x8.
+__attribute__((target("avx512f,avx512vpopcntdq"))) inline std::uint64_t popcount_words_x8(const std::uint64_t* words, std::uint64_t count, std::uint64_t& total)
+{
+    __m512i       acc = _mm512_setzero_si512();
+    std::uint64_t i   = 0;
+    for (; i + 8 <= count; i += 8)
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_loadu_si512(words + i)));
+
+    total += _mm512_reduce_add_epi64(acc);
+    return i;
+}
+
+#endif // __x86_64__
+
+inline bool has_popcount_x8()
+{
+#if defined(__x86_64__)
+    static const bool supported = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq");
+    }();
+    return supported;
+#else
+    return false;
+#endif
+}
+
+// The salts of the split block bloom filter of Parquet and Impala(see
+// split_block_bloom_filter.hpp). Lane i of a 256 bit block gets bit
+// (key * SPLIT_BLOCK_SALT[i]) >> 27 of a key.
+inline constexpr std::uint32_t SPLIT_BLOCK_SALT[8] = { 0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                                       0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U };
+
+#if defined(__x86_64__)
+
+// The one bit per 32 bit lane a key sets in its block.
+BF_AVX2 inline __m256i split_block_mask(std::uint32_t key)
+{
+    const __m256i salt = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(SPLIT_BLOCK_SALT));
+    const __m256i bit  = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(static_cast<int>(key)), salt), 27);
+    return _mm256_sllv_epi32(_mm256_set1_epi32(1), bit);
+}
+
+BF_AVX2 inline void split_block_insert_x8(std::uint32_t* block, std::uint32_t key)
+{
+    __m256i* lanes = reinterpret_cast<__m256i*>(block);
+    _mm256_store_si256(lanes, _mm256_or_si256(_mm256_load_si256(lanes), split_block_mask(key)));
+}
+
+// testc is set when every bit of the mask is set in the block.
+BF_AVX2 inline bool split_block_check_x8(const std::uint32_t* block, std::uint32_t key)
+{
+    return _mm256_testc_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(block)), split_block_mask(key));
+}
+
+#endif
+
+// Whether one of the 4 fingerprints of lane_bits(8 or 16) bits in either of
+// the two buckets a and b equals fp. A bucket is its fingerprints in memory
+// order in the low bytes. SSE2 is part of x86-64, so there is no runtime
+// selection here.
+template <unsigned lane_bits>
+inline bool bucket_pair_contains(std::uint64_t a, std::uint64_t b, std::uint16_t fp)
+{
+    static_assert(lane_bits == 8 || lane_bits == 16);
+#if defined(__x86_64__)
+    if constexpr (lane_bits == 8)
+    {
+        const __m128i pair = _mm_cvtsi64_si128(static_cast<long long>((a & 0xffffffffULL) | (b << 32)));
+        return (_mm_movemask_epi8(_mm_cmpeq_epi8(pair, _mm_set1_epi8(static_cast<char>(fp)))) & 0xff) != 0;
+    }
+    else
+    {
+        const __m128i pair = _mm_set_epi64x(static_cast<long long>(b), static_cast<long long>(a));
+        return _mm_movemask_epi8(_mm_cmpeq_epi16(pair, _mm_set1_epi16(static_cast<short>(fp)))) != 0;
+    }
+#else
+    const std::uint64_t mask = (std::uint64_t(1) << lane_bits) - 1;
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        if (((a >> (i * lane_bits)) & mask) == fp || ((b >> (i * lane_bits)) & mask) == fp)
+            return true;
+    }
+    return false;
+#endif
+}
+
+// dst[i] |= src[i] for count words.
+inline void or_words(std::uint64_t* dst, const std::uint64_t* src, std::uint64_t count, level isa = detect())
+{
+    std::uint64_t i = 0;
+#if defined(__x86_64__)
+    if (isa == level::avx512)
+        i = or_words_x8(dst, src, count);
+    else if (isa == level::avx2)
+        i = or_words_x4(dst, src, count);
+#else
+    static_cast<void>(isa);
+#endif
+    for (; i < count; ++i)
+        dst[i] |= src[i];
+}
+
+// dst[i] &= src[i] for count words.
+inline void and_words(std::uint64_t* dst, const std::uint64_t* src, std::uint64_t count, level isa = detect())
+{
+    std::uint64_t i = 0;
+#if defined(__x86_64__)
+    if (isa == level::avx512)
+        i = and_words_x8(dst, src, count);
+    else if (isa == level::avx2)
+        i = and_words_x4(dst, src, count);
+#else
+    static_cast<void>(isa);
+#endif
+    for (; i < count; ++i)
+        dst[i] &= src[i];
+}
+
+// Sets the 8 bits of key in a 32 byte aligned block of 8 lanes.
+inline void split_block_insert(std::uint32_t* block, std::uint32_t key, level isa = detect())
+{
+#if defined(__x86_64__)
+    if (isa != level::scalar)
+    {
+        split_block_insert_x8(block, key);
+        return;
+    }
+#else
+    static_cast<void>(isa);
+#endif
+    for (unsigned i = 0; i < 8; ++i)
+        block[i] |= std::uint32_t(1) << ((key * SPLIT_BLOCK_SALT[i]) >> 27);
+}
+
+// Whether all 8 bits of key are set in the block.
+inline bool split_block_check(const std::uint32_t* block, std::uint32_t key, level isa = detect())
+{
+#if defined(__x86_64__)
+    if (isa != level::scalar)
+        return split_block_check_x8(block, key);
+#else
+    static_cast<void>(isa);
+#endif
+    std::uint32_t missing = 0;
+    for (unsigned i = 0; i < 8; ++i)
+        missing |= ~block[i] & (std::uint32_t(1) << ((key * SPLIT_BLOCK_SALT[i]) >> 27));
+    return missing == 0;
+}
+
+// The number of set bits in count words.
+inline std::uint64_t popcount_words(const std::uint64_t* words, std::uint64_t count, level isa = detect())
+{
+    std::uint64_t total = 0;
+    std::uint64_t i     = 0;
+#if defined(__x86_64__)
+    if (isa == level::avx512 && has_popcount_x8())
+        i = popcount_words_x8(words, count, total);
+    else if (isa != level::scalar)
+        i = popcount_words_x4(words, count, total);
+#else
+    static_cast<void>(isa);
+#endif
+    for (; i < count; ++i)
+        total += __builtin_popcountll(words[i]);
+    return total;
+}
+
+} // BF::simd
+#endif // BF_SIMD_HPP
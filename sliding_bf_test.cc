@@ -0,0 +1,139 @@
+#include "sliding_bloom_filter.hpp"
+#include <gtest/gtest.h>
+#include <string>
+
+namespace BF
+{
+
+TEST(sliding_bf_test, parameters)
+{
+    BF::sliding_bloom_filter<BF::murmur3, 4> bf;
+    EXPECT_FALSE(bf.add(std::uint64_t(1)));
+    EXPECT_FALSE(bf.contains(std::uint64_t(1)));
+    EXPECT_FALSE(bf.advance());
+    EXPECT_FALSE(bf.config(0, 0.01));
+    EXPECT_FALSE(bf.config(100, 1.0));
+
+    // sized like a bloom_filter of all generations, a byte per position
+    ASSERT_TRUE(bf.config(1000, 0.01));
+    BF::bloom_filter window;
+    ASSERT_TRUE(window.config(4000, 0.01));
+    EXPECT_EQ(bf.bit_count(), window.bit_count());
+    EXPECT_EQ(bf.hash_count(), window.hash_count());
+    EXPECT_EQ(bf.expected_elements(), 1000);
+    EXPECT_EQ(bf.false_positive(), 0.01);
+    EXPECT_EQ(bf.size(), bf.bit_count());
+
+    EXPECT_EQ((BF::sliding_bloom_filter<BF::murmur3, 7> {}.GENERATIONS), 7);
+    BF::sliding_bloom_filter<BF::murmur3, 8> wide;
+    ASSERT_TRUE(wide.config(1000, 0.01));
+    EXPECT_EQ(wide.size(), wide.bit_count() * 2);
+    BF::sliding_bloom_filter<BF::murmur3, 63> widest;
+    ASSERT_TRUE(widest.config(10, 0.01));
+    EXPECT_EQ(widest.size(), widest.bit_count() * 8);
+}
+
+TEST(sliding_bf_test, window)
+{
+    constexpr std::uint64_t per_generation = 1000;
+
+    BF::sliding_bloom_filter<BF::murmur3, 3> bf;
+    ASSERT_TRUE(bf.config(per_generation, 0.01));
+
+    // generation g holds keys [g * 1000, g * 1000 + 1000)
+    for (std::uint64_t g = 0; g < 10; ++g)
+    {
+        if (g > 0)
+        {
+            ASSERT_TRUE(bf.advance());
+        }
+        for (std::uint64_t i = g * per_generation; i < (g + 1) * per_generation; ++i)
+            ASSERT_TRUE(bf.add(i));
+
+        // the last 3 generations are in, the ones before are gone
+        for (std::uint64_t i = (g >= 2 ? g - 2 : 0) * per_generation; i < (g + 1) * per_generation; ++i)
+            ASSERT_TRUE(bf.contains(i)) << "generation " << g << " key " << i;
+
+        if (g >= 3)
+        {
+            std::uint64_t false_positive = 0;
+            for (std::uint64_t i = 0; i < (g - 2) * per_generation; ++i)
+                false_positive += bf.contains(i);
+            EXPECT_LE(false_positive, (g - 2) * per_generation * 0.02) << "generation " << g;
+        }
+    }
+
+    // the rate over the full window stays at p
+    std::uint64_t false_positive = 0;
+    for (std::uint64_t i = 1000000; i < 1100000; ++i)
+        false_positive += bf.contains(i);
+    EXPECT_LE(false_positive / 100000.0, 0.015);
+}
+
+TEST(sliding_bf_test, clearing)
+{
+    BF::sliding_bloom_filter<BF::murmur3, 2> bf;
+    ASSERT_TRUE(bf.config(1000, 0.01));
+    EXPECT_TRUE(bf.clear_expired(0)); // nothing to clear yet
+    EXPECT_EQ(bf.current_slot(), 0);
+
+    for (std::uint64_t i = 0; i < 1000; ++i)
+        ASSERT_TRUE(bf.add(i));
+    ASSERT_TRUE(bf.advance());
+    ASSERT_TRUE(bf.advance());
+    EXPECT_EQ(bf.current_slot(), 2);
+
+    // the first generation is out of the window but its bits are still there
+    // until they are cleared
+    EXPECT_FALSE(bf.contains(std::uint64_t(1)));
+    EXPECT_FALSE(bf.clear_expired(1));
+    EXPECT_TRUE(bf.clear_expired(bf.bit_count()));
+
+    // adds clear the retired slot along the way, half a generation of keys
+    // cleans it
+    ASSERT_TRUE(bf.advance()); // retires the empty second generation
+    for (std::uint64_t i = 5000; i < 5500; ++i)
+        ASSERT_TRUE(bf.add(i));
+    EXPECT_TRUE(bf.clear_expired(0));
+
+    // the slot the first generation was in was cleared before it was reused
+    EXPECT_EQ(bf.current_slot(), 0);
+    std::uint64_t false_positive = 0;
+    for (std::uint64_t i = 0; i < 1000; ++i)
+        false_positive += bf.contains(i);
+    EXPECT_LE(false_positive, 20);
+}
+
+TEST(sliding_bf_test, keys_and_conversion)
+{
+    BF::sliding_bloom_filter<BF::murmur3, 4> bf;
+    ASSERT_TRUE(bf.config(1000, 0.01));
+    ASSERT_TRUE(bf.add("first"));
+    ASSERT_TRUE(bf.advance());
+    const std::string second = "second";
+    ASSERT_TRUE(bf.add(second.data(), second.size()));
+    const std::byte third[] = { std::byte { 3 } };
+    ASSERT_TRUE(bf.add(std::span<const std::byte>(third)));
+    EXPECT_TRUE(bf.contains("first"));
+    EXPECT_TRUE(bf.contains(second));
+    EXPECT_TRUE(bf.contains(std::span<const std::byte>(third)));
+
+    // a plain bloom_filter of the whole window
+    const BF::bloom_filter window = bf.to_bloom_filter();
+    EXPECT_EQ(window.bit_count(), bf.bit_count());
+    EXPECT_EQ(window.expected_elements(), 4000);
+    EXPECT_TRUE(window.contains("first"));
+    EXPECT_TRUE(window.contains(second));
+
+    for (int i = 0; i < 4; ++i)
+        ASSERT_TRUE(bf.advance());
+    EXPECT_FALSE(bf.contains("first"));
+    EXPECT_FALSE(bf.to_bloom_filter().contains("first"));
+
+    BF::sliding_bloom_filter<BF::murmur3, 4> moved(std::move(bf));
+    EXPECT_FALSE(bf.add("x"));
+    EXPECT_TRUE(moved.add("x"));
+    EXPECT_TRUE(moved.contains("x"));
+}
+
+} // BF
@@ -0,0 +1,241 @@
+#ifndef SLIDING_BLOOM_FILTER_HPP
+#define SLIDING_BLOOM_FILTER_HPP
+
+#include "bloom_filter.hpp"
+#include <type_traits>
+
+namespace BF
+{
+
+// Bloom filter over a sliding window of the last `generations` generations,
+// e.g. "seen in the last 10 minutes" as 10 generations of a minute each with
+// advance() called every minute. Every position holds one bit per generation
+// side by side in a cell, so a probe is a single load and a lookup checks all
+// live generations at once. The window behaves like the union of a
+// bloom_filter per generation, it is sized for n keys per generation times
+// the number of generations.
+//
+// There is one slot more than there are generations. advance() makes that
+// spare slot the current generation and retires the oldest one in O(1) by
+// masking it out of lookups; its bits are then cleared a few cells per add in
+// the background of the writes(see clear_expired). advance() only has to
+// clear what the adds of a whole generation did not get to, which is nothing
+// once a generation has seen at least n / 2 keys.
+template <bloom_hasher hasher = murmur3, unsigned generations = 4, typename index = modulo_index>
+class sliding_bloom_filter
+{
+    static_assert(generations >= 1 && generations <= 63, "a sliding_bloom_filter keeps 1 to 63 generations");
+
+    static constexpr unsigned SLOTS = generations + 1;
+
+    typedef std::conditional_t<SLOTS <= 8, std::uint8_t, std::conditional_t<SLOTS <= 16, std::uint16_t, std::conditional_t<SLOTS <= 32, std::uint32_t, std::uint64_t>>> cell;
+
+public:
+    static constexpr unsigned GENERATIONS = generations;
+
+    sliding_bloom_filter()
+        : m(0)
+        , k(0)
+        , n(0)
+        , p(0.0)
+        , current(0)
+        , cleared(0)
+        , clear_step(0)
+    {
+    }
+
+    sliding_bloom_filter(const sliding_bloom_filter& other) = default;
+
+    sliding_bloom_filter& operator=(const sliding_bloom_filter& other) = default;
+
+    sliding_bloom_filter(sliding_bloom_filter&& other)
+        : m(other.m)
+        , k(other.k)
+        , n(other.n)
+        , p(other.p)
+        , current(other.current)
+        , cleared(other.cleared)
+        , clear_step(other.clear_step)
+        , cells(std::move(other.cells))
+    {
+        other.m = other.k = other.n = other.p = 0;
+        other.current = other.cleared = other.clear_step = 0;
+    }
+
+    sliding_bloom_filter& operator=(sliding_bloom_filter&& other)
+    {
+        if (this != &other)
+        {
+            m          = other.m;
+            k          = other.k;
+            n          = other.n;
+            p          = other.p;
+            current    = other.current;
+            cleared    = other.cleared;
+            clear_step = other.clear_step;
+            cells      = std::move(other.cells);
+
+            other.m = other.k = other.n = other.p = 0;
+            other.current = other.cleared = other.clear_step = 0;
+        }
+        return *this;
+    }
+
+    // n keys per generation at a false positive rate of p for a lookup over
+    // the whole window.
+    bool config(std::uint64_t n, double p)
+    {
+        if (p >= 1.0 || p <= 0.0 || n == 0 || n > std::numeric_limits<std::uint64_t>::max() / generations)
+            return false;
+
+        if (!compute_m_k<index>(n * generations, p, m, k, this->p))
+            return false;
+        this->n = n;
+
+        cells.assign(m, 0);
+        current    = 0;
+        cleared    = m;
+        clear_step = 2 * (m / n) + 1;
+        return true;
+    }
+
+    std::uint64_t bit_count() const { return m; } // number of cells
+
+    std::uint64_t hash_count() const { return k; }
+
+    std::uint64_t expected_elements() const { return n; } // per generation
+
+    double false_positive() const { return p; }
+
+    std::size_t size() const { return cells.size() * sizeof(cell); } // in bytes
+
+    // The slot the current generation is written to, bit current of a cell.
+    unsigned current_slot() const { return current; }
+
+    bool add(const void* key, const std::uint64_t len)
+    {
+        if (m == 0)
+            return false;
+
+        const bool ok = for_each_hash(h, key, len, k, [this](std::uint64_t hash) {
+            cells[idx(hash, m)] |= cell(1) << current;
+            return true;
+        });
+        clear_expired(clear_step);
+        return ok;
+    }
+
+    // Whether the key was added in one of the live generations.
+    bool contains(const void* key, const std::uint64_t len) const
+    {
+        if (m == 0)
+            return false;
+
+        const cell live = live_mask();
+        return for_each_hash(h, key, len, k, [this, live](std::uint64_t hash) { return (cells[idx(hash, m)] & live) != 0; });
+    }
+
+    // Typed keys, see bloom_filter.
+    template <trivial_key T>
+    bool add(const T& key)
+    {
+        if (m == 0)
+            return false;
+
+        const bool ok = for_each_hash<sizeof(T)>(h, &key, k, [this](std::uint64_t hash) {
+            cells[idx(hash, m)] |= cell(1) << current;
+            return true;
+        });
+        clear_expired(clear_step);
+        return ok;
+    }
+
+    template <trivial_key T>
+    bool contains(const T& key) const
+    {
+        if (m == 0)
+            return false;
+
+        const cell live = live_mask();
+        return for_each_hash<sizeof(T)>(h, &key, k, [this, live](std::uint64_t hash) { return (cells[idx(hash, m)] & live) != 0; });
+    }
+
+    bool add(std::string_view key) { return add(key.data(), key.size()); }
+
+    bool contains(std::string_view key) const { return contains(key.data(), key.size()); }
+
+    bool add(std::span<const std::byte> key) { return add(key.data(), key.size()); }
+
+    bool contains(std::span<const std::byte> key) const { return contains(key.data(), key.size()); }
+
+    // Starts a new generation and drops the oldest one from lookups.
+    bool advance()
+    {
+        if (m == 0)
+            return false;
+
+        // the spare slot becomes the current generation, it has to be clean
+        clear_expired(m);
+        current = spare();
+        cleared = 0;
+        return true;
+    }
+
+    // Clears up to count cells of the retired generation. add does this a
+    // few cells at a time, idle writers can call it to get ahead. Returns
+    // true once the slot is clean.
+    bool clear_expired(std::uint64_t count)
+    {
+        const std::uint64_t end  = std::min(m, cleared + std::min(count, m));
+        const cell          keep = ~(cell(1) << spare());
+        for (std::uint64_t i = cleared; i < end; ++i)
+            cells[i] &= keep;
+        cleared = end;
+        return cleared == m;
+    }
+
+    // The keys of the live generations as a plain bloom_filter with the same
+    // m and k, sized for the whole window, e.g. to save or query it elsewhere.
+    bloom_filter<hasher, index> to_bloom_filter() const
+    {
+        bloom_filter<hasher, index> out;
+        if (m == 0)
+            return out;
+
+        const cell                live = live_mask();
+        std::vector<std::uint8_t> raw(m / 8 + static_cast<bool>(m & 7), 0);
+        for (std::uint64_t i = 0; i < m; ++i)
+        {
+            if (cells[i] & live)
+                raw[i / 8] |= std::uint8_t(1) << (i & 7);
+        }
+        out.from(m, k, n * generations, p, raw.data(), raw.size());
+        return out;
+    }
+
+private:
+    std::uint64_t                                  m; // number of cells
+    std::uint64_t                                  k; // number of hashes
+    std::uint64_t                                  n; // expected number of elements per generation
+    double                                         p; // false positive probability of the window(> 0 && < 1)
+    unsigned                                       current; // slot of the current generation
+    std::uint64_t                                  cleared; // cells of the spare slot cleared so far
+    std::uint64_t                                  clear_step; // cells cleared per add
+    std::vector<cell, aligned_allocator<cell, 64>> cells; // bit s of cell i is position i of slot s
+    hasher                                         h;
+    index                                          idx;
+
+    // the slot after the current one, which held the oldest generation
+    unsigned spare() const { return current + 1 == SLOTS ? 0 : current + 1; }
+
+    cell live_mask() const
+    {
+        cell all = ~cell(0);
+        if constexpr (SLOTS < sizeof(cell) * 8)
+            all = (cell(1) << SLOTS) - 1;
+        return all & ~(cell(1) << spare());
+    }
+};
+
+} // BF
+#endif // SLIDING_BLOOM_FILTER_HPP
@@ -0,0 +1,150 @@
+#include "split_block_bloom_filter.hpp"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace BF
+{
+
+TEST(split_block_bf_test, parameters)
+{
+    BF::split_block_bloom_filter bf;
+    EXPECT_FALSE(bf.add(std::uint64_t(1)));
+    EXPECT_FALSE(bf.contains(std::uint64_t(1)));
+    EXPECT_EQ(bf.raw(), nullptr);
+    EXPECT_TRUE(bf.to_parquet().empty());
+    EXPECT_FALSE(bf.config(0, 0.01));
+    EXPECT_FALSE(bf.config(100, 1.0));
+    EXPECT_FALSE(bf.config(1ULL << 40, 0.01)); // past MAX_BYTES
+
+    // a power of two bytes, at a rate of p or better
+    ASSERT_TRUE(bf.config(100000, 0.01));
+    EXPECT_TRUE(std::has_single_bit(bf.size()));
+    EXPECT_EQ(bf.bit_count(), bf.size() * 8);
+    EXPECT_EQ(bf.block_count(), bf.size() / BF::split_block_bloom_filter::BLOCK_BYTES);
+    EXPECT_EQ(bf.expected_elements(), 100000);
+    EXPECT_GT(bf.false_positive(), 0.0);
+    EXPECT_LE(bf.false_positive(), 0.01);
+
+    ASSERT_TRUE(bf.config(1, 0.5));
+    EXPECT_EQ(bf.size(), BF::split_block_bloom_filter::MIN_BYTES);
+
+    EXPECT_FALSE(bf.config_bytes(16));
+    EXPECT_FALSE(bf.config_bytes(96));
+    EXPECT_FALSE(bf.config_bytes(BF::split_block_bloom_filter::MAX_BYTES * 2));
+    ASSERT_TRUE(bf.config_bytes(1024));
+    EXPECT_EQ(bf.size(), 1024);
+    EXPECT_EQ(bf.expected_elements(), 0);
+}
+
+TEST(split_block_bf_test, parquet_reference)
+{
+    // bits computed independently from the Parquet specification: 50 INT64
+    // values and 2 BYTE_ARRAY values in a 256 byte bitset
+    BF::split_block_bloom_filter bf;
+    ASSERT_TRUE(bf.config_bytes(256));
+    for (std::int64_t v = 0; v < 50; ++v)
+        ASSERT_TRUE(bf.add(v));
+    ASSERT_TRUE(bf.add("parquet"));
+    ASSERT_TRUE(bf.add_hash(BF::split_block_bloom_filter::hash("impala", 6)));
+
+    const std::uint32_t first_block[8] = { 0x32410010, 0x030c1480, 0x18020009, 0x10010262, 0x20840446, 0x04c08208, 0x06091300, 0x00213005 };
+    EXPECT_EQ(std::memcmp(bf.raw(), first_block, sizeof(first_block)), 0);
+    EXPECT_EQ(BF::xxh64::hash_64(bf.raw(), bf.size()), 0xe24733038b987b01);
+
+    for (std::int64_t v = 0; v < 50; ++v)
+        EXPECT_TRUE(bf.contains(v));
+    EXPECT_TRUE(bf.contains("impala"));
+    EXPECT_TRUE(bf.contains_hash(BF::split_block_bloom_filter::hash("parquet", 7)));
+
+    // the scalar kernels set and test the same bits
+    std::vector<std::uint32_t, aligned_allocator<std::uint32_t, 64>> words(bf.size() / 4, 0);
+    for (std::int64_t v = 0; v < 50; ++v)
+    {
+        const std::uint64_t h = BF::split_block_bloom_filter::hash(&v, sizeof(v));
+        std::uint32_t*      b = words.data() + ((h >> 32) * bf.block_count() >> 32) * 8;
+        simd::split_block_insert(b, static_cast<std::uint32_t>(h), simd::level::scalar);
+        EXPECT_TRUE(simd::split_block_check(b, static_cast<std::uint32_t>(h), simd::level::scalar));
+        EXPECT_EQ(simd::split_block_check(b, static_cast<std::uint32_t>(h) + 1, simd::level::scalar),
+                  simd::split_block_check(b, static_cast<std::uint32_t>(h) + 1));
+    }
+    BF::split_block_bloom_filter ints;
+    ASSERT_TRUE(ints.config_bytes(256));
+    for (std::int64_t v = 0; v < 50; ++v)
+        ASSERT_TRUE(ints.add(v));
+    EXPECT_EQ(std::memcmp(ints.raw(), words.data(), ints.size()), 0);
+}
+
+TEST(split_block_bf_test, parquet_serialization)
+{
+    BF::split_block_bloom_filter bf;
+    ASSERT_TRUE(bf.config_bytes(256));
+    ASSERT_TRUE(bf.add("a"));
+
+    // BloomFilterHeader{ numBytes = 256, BLOCK, XXHASH, UNCOMPRESSED }
+    const std::vector<std::uint8_t> header = { 0x15, 0x80, 0x04, 0x1c, 0x1c, 0x00, 0x00, 0x1c, 0x1c, 0x00, 0x00, 0x1c, 0x1c, 0x00, 0x00, 0x00 };
+    std::vector<std::uint8_t>       out    = bf.to_parquet();
+    ASSERT_EQ(out.size(), header.size() + 256);
+    EXPECT_TRUE(std::equal(header.begin(), header.end(), out.begin()));
+    EXPECT_EQ(std::memcmp(out.data() + header.size(), bf.raw(), bf.size()), 0);
+
+    BF::split_block_bloom_filter copy;
+    out.push_back(0xff); // trailing bytes are not part of it
+    ASSERT_TRUE(copy.from_parquet(out.data(), out.size(), 1));
+    EXPECT_EQ(copy.size(), 256);
+    EXPECT_EQ(copy.expected_elements(), 1);
+    EXPECT_GT(copy.false_positive(), 0.0);
+    EXPECT_TRUE(copy.contains("a"));
+
+    // truncated, another hash, a bitset that does not fit
+    EXPECT_FALSE(copy.from_parquet(out.data(), out.size() - 2, 1));
+    EXPECT_FALSE(copy.from_parquet(out.data(), 10));
+    std::vector<std::uint8_t> other = out;
+    other[8]                        = 0x2c; // XXHASH -> field 2 of the hash union
+    EXPECT_FALSE(copy.from_parquet(other.data(), other.size()));
+    other    = out;
+    other[2] = 0x05; // numBytes 320
+    EXPECT_FALSE(copy.from_parquet(other.data(), other.size()));
+
+    // from takes any whole number of blocks
+    EXPECT_FALSE(copy.from(bf.raw(), 48));
+    ASSERT_TRUE(copy.from(bf.raw(), 96));
+    EXPECT_EQ(copy.block_count(), 3);
+    EXPECT_EQ(copy.false_positive(), 0.0);
+}
+
+TEST(split_block_bf_test, false_positive_and_merge)
+{
+    BF::split_block_bloom_filter bf;
+    ASSERT_TRUE(bf.config(100000, 0.01));
+    for (std::uint64_t i = 0; i < 100000; ++i)
+        ASSERT_TRUE(bf.add(i));
+    for (std::uint64_t i = 0; i < 100000; ++i)
+        ASSERT_TRUE(bf.contains(i));
+
+    std::uint64_t false_positive = 0;
+    for (std::uint64_t i = 100000; i < 1100000; ++i)
+        false_positive += bf.contains(i);
+    EXPECT_NEAR(false_positive / 1000000.0, bf.false_positive(), bf.false_positive() * 0.1);
+
+    BF::split_block_bloom_filter other;
+    ASSERT_TRUE(other.config(100000, 0.01));
+    const std::string key = "merged";
+    ASSERT_TRUE(other.add(key.data(), key.size()));
+    ASSERT_TRUE(bf.merge(other));
+    EXPECT_TRUE(bf.contains(key));
+    EXPECT_TRUE(bf.contains(std::uint64_t(5)));
+
+    BF::split_block_bloom_filter small;
+    ASSERT_TRUE(small.config(10, 0.01));
+    EXPECT_FALSE(bf.merge(small));
+
+    BF::split_block_bloom_filter moved(std::move(bf));
+    EXPECT_FALSE(bf.contains(key));
+    EXPECT_TRUE(moved.contains(key));
+    bf = std::move(moved);
+    EXPECT_TRUE(bf.contains(key));
+    EXPECT_EQ(moved.size(), 0);
+}
+
+} // BF
@@ -0,0 +1,320 @@
+#ifndef SPLIT_BLOCK_BLOOM_FILTER_HPP
+#define SPLIT_BLOCK_BLOOM_FILTER_HPP
+
+#include "hashers.hpp"
+
+namespace BF
+{
+
+// Split block bloom filter as used by Impala, Kudu and Parquet(see
+// https://github.com/apache/parquet-format/blob/master/BloomFilter.md).
+// The high 32 bits of the 64 bit hash of a key select a block of 256 bits,
+// eight 32 bit lanes. Each lane gets exactly one bit, picked by multiplying
+// the low 32 bits with a salt per lane and keeping the top 5 bits. All eight
+// bits are computed side by side, add is one OR of the block and contains
+// one AVX2 test against it, without a branch per probe. The price is a
+// higher false positive rate than bloom_filter for the same number of bits.
+//
+// The hash is XXH64 with seed 0 of the key bytes, and raw() is the Parquet
+// bitset(little endian 32 bit words), so the filters can be exchanged with
+// Parquet readers and writers. For Parquet columns a key is the plain
+// encoding of the value: the 4 or 8 little endian bytes of an INT32, INT64,
+// FLOAT or DOUBLE(which is what the typed overloads hash) and the bytes of a
+// BYTE_ARRAY without its length.
+class split_block_bloom_filter
+{
+public:
+    static constexpr std::uint64_t BLOCK_BYTES = 32;
+    static constexpr std::uint64_t BLOCK_BITS  = BLOCK_BYTES * 8;
+    // the bitset sizes Parquet readers accept
+    static constexpr std::uint64_t MIN_BYTES = BLOCK_BYTES;
+    static constexpr std::uint64_t MAX_BYTES = std::uint64_t(128) << 20;
+
+    split_block_bloom_filter()
+        : n(0)
+        , p(0.0)
+    {
+    }
+
+    split_block_bloom_filter(const split_block_bloom_filter& other) = default;
+
+    split_block_bloom_filter& operator=(const split_block_bloom_filter& other) = default;
+
+    split_block_bloom_filter(split_block_bloom_filter&& other)
+        : n(other.n)
+        , p(other.p)
+        , words(std::move(other.words))
+    {
+        other.words.clear();
+        other.n = other.p = 0;
+    }
+
+    split_block_bloom_filter& operator=(split_block_bloom_filter&& other)
+    {
+        if (this != &other)
+        {
+            n     = other.n;
+            p     = other.p;
+            words = std::move(other.words);
+
+            other.words.clear();
+            other.n = other.p = 0;
+        }
+        return *this;
+    }
+
+    // Sized the way Parquet writers size it, the bits for n keys at a rate of
+    // p rounded up to a power of two bytes, and doubled while the model of
+    // the block load(see compute_p) still puts the rate above p.
+    // false_positive() is the rate of that size, usually below p.
+    bool config(std::uint64_t n, double p)
+    {
+        if (p >= 1.0 || p <= 0.0 || n == 0)
+            return false;
+
+        const double bits = -8.0 * n / std::log1p(-std::pow(p, 1.0 / 8));
+        if (!(bits / 8 <= MAX_BYTES))
+            return false;
+
+        std::uint64_t bytes = std::bit_ceil(std::max<std::uint64_t>(MIN_BYTES, std::ceil(bits / 8)));
+        while (bytes <= MAX_BYTES && compute_p(bytes / BLOCK_BYTES, n) > p)
+            bytes *= 2;
+        if (bytes > MAX_BYTES)
+            return false;
+
+        words.assign(bytes / sizeof(std::uint32_t), 0);
+        this->n = n;
+        this->p = compute_p(bytes / BLOCK_BYTES, n);
+        return true;
+    }
+
+    // An empty filter of bytes bytes, a power of two in [MIN_BYTES, MAX_BYTES],
+    // e.g. to match the size another writer uses. n is unknown.
+    bool config_bytes(std::uint64_t bytes)
+    {
+        if (bytes < MIN_BYTES || bytes > MAX_BYTES || !std::has_single_bit(bytes))
+            return false;
+
+        words.assign(bytes / sizeof(std::uint32_t), 0);
+        n = 0;
+        p = 0.0;
+        return true;
+    }
+
+    // Copies a Parquet bitset. Any whole number of blocks is accepted, the
+    // block selection does not need a power of two. n is optional, with it
+    // false_positive() reports the rate for n keys.
+    bool from(const std::uint8_t* raw, std::uint64_t raw_size, std::uint64_t n = 0)
+    {
+        if (!raw || raw_size < MIN_BYTES || raw_size > MAX_BYTES || raw_size % BLOCK_BYTES != 0)
+            return false;
+
+        words.resize(raw_size / sizeof(std::uint32_t));
+        std::memcpy(words.data(), raw, raw_size);
+        this->n = n;
+        this->p = n ? compute_p(block_count(), n) : 0.0;
+        return true;
+    }
+
+    std::uint64_t bit_count() const { return words.size() * 32; }
+
+    std::uint64_t block_count() const { return words.size() / LANES; }
+
+    std::uint64_t expected_elements() const { return n; } // 0 if unknown
+
+    double false_positive() const { return p; } // 0 if n is unknown
+
+    std::size_t size() const { return words.size() * sizeof(std::uint32_t); } // in bytes
+
+    // The Parquet bitset.
+    const std::uint8_t* raw() const
+    {
+        if (words.empty())
+            return nullptr;
+        return reinterpret_cast<const std::uint8_t*>(words.data());
+    }
+
+    // The hash of a key as Parquet computes it.
+    static std::uint64_t hash(const void* key, const std::uint64_t len) { return xxh64::hash_64(key, len, 0); }
+
+    // Adds a key by its hash, e.g. hashes Parquet writers computed.
+    bool add_hash(std::uint64_t hash)
+    {
+        if (words.empty())
+            return false;
+        simd::split_block_insert(block(hash), static_cast<std::uint32_t>(hash));
+        return true;
+    }
+
+    bool contains_hash(std::uint64_t hash) const
+    {
+        if (words.empty())
+            return false;
+        return simd::split_block_check(block(hash), static_cast<std::uint32_t>(hash));
+    }
+
+    bool add(const void* key, const std::uint64_t len) { return add_hash(hash(key, len)); }
+
+    bool contains(const void* key, const std::uint64_t len) const { return contains_hash(hash(key, len)); }
+
+    // Typed keys are hashed by their bytes, see bloom_filter.
+    template <trivial_key T>
+    bool add(const T& key)
+    {
+        return add(&key, sizeof(T));
+    }
+
+    template <trivial_key T>
+    bool contains(const T& key) const
+    {
+        return contains(&key, sizeof(T));
+    }
+
+    bool add(std::string_view key) { return add(key.data(), key.size()); }
+
+    bool contains(std::string_view key) const { return contains(key.data(), key.size()); }
+
+    bool add(std::span<const std::byte> key) { return add(key.data(), key.size()); }
+
+    bool contains(std::span<const std::byte> key) const { return contains(key.data(), key.size()); }
+
+    bool merge(const split_block_bloom_filter& other)
+    {
+        if (words.empty() || words.size() != other.words.size())
+            return false;
+
+        for (std::uint64_t i = 0; i < words.size(); ++i)
+            words[i] |= other.words[i];
+        return true;
+    }
+
+    // The filter the way Parquet stores it in a file: a thrift compact
+    // BloomFilterHeader(numBytes, BLOCK, XXHASH, UNCOMPRESSED) followed by
+    // the bitset. Empty if the filter is.
+    std::vector<std::uint8_t> to_parquet() const
+    {
+        std::vector<std::uint8_t> out;
+        if (words.empty())
+            return out;
+
+        // field 1, i32: numBytes as a zigzag varint
+        out.push_back(0x15);
+        for (std::uint64_t v = size() << 1; true; v >>= 7)
+        {
+            if (v < 0x80)
+            {
+                out.push_back(static_cast<std::uint8_t>(v));
+                break;
+            }
+            out.push_back(static_cast<std::uint8_t>(v | 0x80));
+        }
+
+        // fields 2 to 4, unions: field 1(BLOCK, XXHASH, UNCOMPRESSED), an
+        // empty struct
+        for (int field = 2; field <= 4; ++field)
+            out.insert(out.end(), { 0x1c, 0x1c, 0x00, 0x00 });
+        out.push_back(0x00);
+
+        out.insert(out.end(), raw(), raw() + size());
+        return out;
+    }
+
+    // Reads what to_parquet writes, e.g. the bytes at bloom_filter_offset of
+    // a Parquet column chunk. Fails on other algorithms, hashes or a
+    // compressed bitset. Bytes past the bitset are ignored.
+    bool from_parquet(const std::uint8_t* data, std::uint64_t data_size, std::uint64_t n = 0)
+    {
+        if (!data)
+            return false;
+
+        std::uint64_t pos = 0;
+        auto varint       = [&](std::uint64_t& v) {
+            v = 0;
+            for (unsigned shift = 0; pos < data_size && shift < 64; shift += 7)
+            {
+                const std::uint8_t byte = data[pos++];
+                v |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+                if (!(byte & 0x80))
+                    return true;
+            }
+            return false;
+        };
+
+        std::uint64_t bytes = 0;
+        unsigned      seen  = 0;
+        for (int field = 0; true;)
+        {
+            if (pos >= data_size)
+                return false;
+            const std::uint8_t head = data[pos++];
+            if (head == 0x00)
+                break;
+
+            if (head >> 4)
+                field += head >> 4;
+            else // long form, the id follows as a zigzag varint
+            {
+                std::uint64_t zigzag = 0;
+                if (!varint(zigzag))
+                    return false;
+                field = static_cast<int>(zigzag >> 1);
+            }
+
+            if (field == 1 && (head & 0x0f) == 0x05)
+            {
+                std::uint64_t zigzag = 0;
+                if (!varint(zigzag) || (zigzag & 1))
+                    return false;
+                bytes = zigzag >> 1;
+            }
+            else if (field >= 2 && field <= 4 && (head & 0x0f) == 0x0c)
+            {
+                // the only member every union may have: field 1, empty
+                if (data_size - pos < 3 || data[pos] != 0x1c || data[pos + 1] != 0x00 || data[pos + 2] != 0x00)
+                    return false;
+                pos += 3;
+            }
+            else
+                return false;
+            seen |= 1u << field;
+        }
+
+        if (seen != 0x1e || bytes > data_size - pos)
+            return false;
+        return from(data + pos, bytes, n);
+    }
+
+private:
+    static constexpr std::uint64_t LANES = BLOCK_BYTES / sizeof(std::uint32_t);
+
+    std::uint64_t                                                   n; // expected number of elements, 0 if unknown
+    double                                                          p; // false positive probability of the real size
+    std::vector<std::uint32_t, aligned_allocator<std::uint32_t, 64>> words;
+
+    std::uint32_t* block(std::uint64_t hash) { return words.data() + ((hash >> 32) * block_count() >> 32) * LANES; }
+
+    const std::uint32_t* block(std::uint64_t hash) const { return words.data() + ((hash >> 32) * block_count() >> 32) * LANES; }
+
+    // The keys of a block follow a Poisson distribution with mean n / blocks.
+    // A block with i keys has each lane bit of another key set with
+    // probability 1 - (1 - 1/32)^i, and all 8 have to be.
+    static double compute_p(std::uint64_t blocks, std::uint64_t n)
+    {
+        const double lambda = static_cast<double>(n) / blocks;
+        const double spread = 10.0 * std::sqrt(lambda) + 10.0;
+        const double lo     = std::max(1.0, std::floor(lambda - spread));
+        const double hi     = std::ceil(lambda + spread);
+        const double miss   = std::log1p(-1.0 / 32);
+
+        double fpr = 0.0;
+        for (double i = lo; i <= hi; ++i)
+        {
+            const double poisson = std::exp(i * std::log(lambda) - lambda - std::lgamma(i + 1.0));
+            fpr += poisson * std::pow(1.0 - std::exp(i * miss), 8.0);
+        }
+        return std::min(fpr, 1.0);
+    }
+};
+
+} // BF
+#endif // SPLIT_BLOCK_BLOOM_FILTER_HPP
@@ -0,0 +1,108 @@
+#include "hashers.hpp"
+#include "static_bloom_filter.hpp"
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+
+namespace BF
+{
+
+// built at compile time
+constexpr static_bloom_filter<1024, 5> keywords { "select", "from", "where", "a key longer than sixteen bytes" };
+static_assert(keywords.contains("select") && keywords.contains("where") && keywords.contains("a key longer than sixteen bytes"));
+static_assert(!keywords.contains("update"));
+
+constexpr static_bloom_filter<512, 4> ports { std::uint16_t(22), std::uint16_t(80), std::uint16_t(443) };
+static_assert(ports.contains(std::uint16_t(443)) && !ports.contains(std::uint16_t(8080)));
+
+// the bits are all there is to it
+static_assert(sizeof(static_bloom_filter<512, 4>) == 64);
+
+TEST(static_bf_test, parameters)
+{
+    using filter = static_bloom_filter<1001, 7>;
+    EXPECT_EQ(filter::bit_count(), 1001);
+    EXPECT_EQ(filter::hash_count(), 7);
+    EXPECT_EQ(filter::size(), 126);
+    EXPECT_EQ(filter::false_positive(100), compute_p(1001, 7, 100));
+
+    filter bf;
+    EXPECT_EQ(bf.popcount(), 0);
+    for (std::uint64_t i = 0; i < filter::size(); ++i)
+        EXPECT_EQ(bf.raw()[i], 0);
+}
+
+TEST(static_bf_test, constant_and_runtime_agree)
+{
+    // keys added at compile time are found at runtime, and the other way
+    // around, through every overload
+    static_bloom_filter<1024, 5> bf;
+    for (const std::string key : { "select", "from", "where", "a key longer than sixteen bytes" })
+        ASSERT_TRUE(bf.add(key.data(), key.size()));
+    EXPECT_EQ(std::memcmp(bf.raw(), keywords.raw(), bf.size()), 0);
+
+    const std::string select = "select";
+    EXPECT_TRUE(keywords.contains(select));
+    EXPECT_TRUE(keywords.contains(select.data(), select.size()));
+
+    const std::uint16_t port = 80;
+    EXPECT_TRUE(ports.contains(&port, sizeof(port)));
+}
+
+TEST(static_bf_test, same_bits_as_bloom_filter)
+{
+    static_bloom_filter<4099, 6, xxh3> bf;
+    bloom_filter<xxh3>                 dynamic;
+    ASSERT_TRUE(dynamic.config(4099, 6, 400));
+    for (std::uint64_t i = 0; i < 400; ++i)
+    {
+        ASSERT_TRUE(bf.add(i));
+        ASSERT_TRUE(dynamic.add(&i, sizeof(i)));
+    }
+    ASSERT_EQ(std::memcmp(bf.raw(), dynamic.raw(), bf.size()), 0);
+    EXPECT_EQ(bf.popcount(), dynamic.popcount());
+
+    const bloom_filter<xxh3> converted = bf.to_bloom_filter(400);
+    EXPECT_EQ(converted.bit_count(), 4099);
+    EXPECT_EQ(converted.hash_count(), 6);
+    EXPECT_EQ(converted.false_positive(), dynamic.false_positive());
+    for (std::uint64_t i = 0; i < 400; ++i)
+        EXPECT_TRUE(converted.contains(i));
+}
+
+TEST(static_bf_test, false_positive)
+{
+    static_bloom_filter<9586, 7> bf; // 1000 keys at 1%
+    for (std::uint64_t i = 0; i < 1000; ++i)
+        ASSERT_TRUE(bf.add(i));
+    for (std::uint64_t i = 0; i < 1000; ++i)
+        EXPECT_TRUE(bf.contains(i));
+
+    std::uint64_t false_positive = 0;
+    for (std::uint64_t i = 1000; i < 101000; ++i)
+        false_positive += bf.contains(i);
+    EXPECT_LE(false_positive / 100000.0, 0.015);
+}
+
+TEST(static_bf_test, merge)
+{
+    static_bloom_filter<2048, 4> left, right;
+    for (std::uint64_t i = 0; i < 100; ++i)
+    {
+        ASSERT_TRUE(left.add(i));
+        ASSERT_TRUE(right.add(i + 100));
+    }
+
+    static_bloom_filter<2048, 4> both = left;
+    both.merge(right);
+    for (std::uint64_t i = 0; i < 200; ++i)
+        EXPECT_TRUE(both.contains(i));
+
+    both.intersect(left);
+    EXPECT_EQ(std::memcmp(both.raw(), left.raw(), left.size()), 0);
+
+    both.clear();
+    EXPECT_EQ(both.popcount(), 0);
+}
+
+} // BF
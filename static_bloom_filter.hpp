@@ -0,0 +1,176 @@
+#ifndef STATIC_BLOOM_FILTER_HPP
+#define STATIC_BLOOM_FILTER_HPP
+
+#include <array>
+#include <initializer_list>
+
+#include "bloom_filter.hpp"
+
+namespace BF
+{
+
+// Bloom filter with m and k fixed at compile time and its bits stored inline,
+// for many small filters(e.g. one per connection or partition) where the heap
+// allocation and the runtime m, k, n and p of bloom_filter cost more than the
+// bits themselves. The k probes are unrolled and hash % m is a division by a
+// constant. The bits are laid out like those of a bloom_filter<hasher> with
+// the same m and k, so both find each other's keys.
+//
+// With a constexpr_hasher(murmur3) string and trivially copyable keys can be
+// added in constant expressions, e.g. to build a filter of a literal key set
+// at compile time:
+//   constexpr static_bloom_filter<1024, 5> keywords { "select", "from", "where" };
+template <std::uint64_t m, std::uint64_t k, bloom_hasher hasher = murmur3>
+class static_bloom_filter
+{
+    static_assert(m > 0 && k > 0, "a static_bloom_filter needs bits and hashes");
+    static_assert(requires(const hasher& h, const void* key, std::uint64_t len) { { h(key, len) } -> std::convertible_to<hash128>; },
+                  "the hasher has to return hash128");
+
+public:
+    constexpr static_bloom_filter() = default;
+
+    // The filter of a set of keys of the same type.
+    template <typename T>
+    constexpr static_bloom_filter(std::initializer_list<T> keys)
+    {
+        for (const T& key : keys)
+            add(key);
+    }
+
+    static constexpr std::uint64_t bit_count() { return m; }
+
+    static constexpr std::uint64_t hash_count() { return k; }
+
+    // The false positive rate once n keys are added.
+    static double false_positive(std::uint64_t n) { return compute_p(m, k, n); }
+
+    static constexpr std::size_t size() { return m / 8 + static_cast<bool>(m & 7); } // in bytes
+
+    // The words as size() bytes, bit i of the filter is bit i % 8 of byte i / 8.
+    const std::uint8_t* raw() const { return reinterpret_cast<const std::uint8_t*>(words.data()); }
+
+    bool add(const void* key, const std::uint64_t len)
+    {
+        return set(h(key, len));
+    }
+
+    bool contains(const void* key, const std::uint64_t len) const
+    {
+        return test(h(key, len));
+    }
+
+    // Typed keys, the same as add(&key, sizeof(key)), see bloom_filter.
+    template <trivial_key T>
+    constexpr bool add(const T& key)
+    {
+        return set(hash(key));
+    }
+
+    template <trivial_key T>
+    constexpr bool contains(const T& key) const
+    {
+        return test(hash(key));
+    }
+
+    constexpr bool add(std::string_view key) { return set(hash(key)); }
+
+    constexpr bool contains(std::string_view key) const { return test(hash(key)); }
+
+    bool add(std::span<const std::byte> key) { return add(key.data(), key.size()); }
+
+    bool contains(std::span<const std::byte> key) const { return contains(key.data(), key.size()); }
+
+    // Union: afterwards the filter contains the keys of both.
+    constexpr void merge(const static_bloom_filter& other)
+    {
+        for (std::uint64_t i = 0; i < WORDS; ++i)
+            words[i] |= other.words[i];
+    }
+
+    // Intersection, see bloom_filter::intersect.
+    constexpr void intersect(const static_bloom_filter& other)
+    {
+        for (std::uint64_t i = 0; i < WORDS; ++i)
+            words[i] &= other.words[i];
+    }
+
+    constexpr void clear() { words.fill(0); }
+
+    // The number of bits that are set.
+    constexpr std::uint64_t popcount() const
+    {
+        std::uint64_t count = 0;
+        for (const std::uint64_t word : words)
+            count += std::popcount(word);
+        return count;
+    }
+
+    // The same bits as a bloom_filter sized for n keys, e.g. to save it.
+    bloom_filter<hasher> to_bloom_filter(std::uint64_t n) const
+    {
+        bloom_filter<hasher> out;
+        out.from(m, k, n, false_positive(n), raw(), size());
+        return out;
+    }
+
+private:
+    static constexpr std::uint64_t WORDS = m / 64 + static_cast<bool>(m & 63);
+
+    std::array<std::uint64_t, WORDS> words {}; // bit i is bit i % 64 of word i / 64
+    [[no_unique_address]] hasher     h;
+
+    // Constant expressions cannot look at the bytes of a key through a
+    // pointer, there the key is copied into chars for hash_string.
+    template <typename T>
+    constexpr hash128 hash(const T& key) const
+    {
+        if constexpr (constexpr_hasher<hasher>)
+        {
+            if (std::is_constant_evaluated())
+            {
+                if constexpr (std::same_as<T, std::string_view>)
+                    return h.hash_string(key);
+                else
+                {
+                    const auto bytes = std::bit_cast<std::array<char, sizeof(T)>>(key);
+                    return h.hash_string(std::string_view(bytes.data(), bytes.size()));
+                }
+            }
+        }
+
+        if constexpr (std::same_as<T, std::string_view>)
+            return h(key.data(), key.size());
+        else
+            return hash_key<sizeof(T)>(h, &key);
+    }
+
+    // Calls visit(bit id) for the k probes of a key, unrolled, and stops as
+    // soon as visit returns false.
+    template <typename visitor>
+    static constexpr bool for_each_bit(const hash128& base, visitor&& visit)
+    {
+        probe_sequence probes(base);
+        return [&]<std::uint64_t... i>(std::integer_sequence<std::uint64_t, i...>) {
+            return ((static_cast<void>(i), visit(probes.next() % m)) && ...);
+        }(std::make_integer_sequence<std::uint64_t, k>());
+    }
+
+    constexpr bool set(const hash128& base)
+    {
+        return for_each_bit(base, [this](std::uint64_t bit_id) {
+            words[bit_id / 64] |= std::uint64_t(1) << (bit_id & 63);
+            return true;
+        });
+    }
+
+    constexpr bool test(const hash128& base) const
+    {
+        return for_each_bit(base, [this](std::uint64_t bit_id) {
+            return ((words[bit_id / 64] >> (bit_id & 63)) & 1) != 0;
+        });
+    }
+};
+
+} // BF
+#endif // STATIC_BLOOM_FILTER_HPP
@@ -0,0 +1,249 @@
+#include "bloom_filter_stream.hpp"
+#include "hashers.hpp"
+#include <fstream>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace BF
+{
+
+namespace
+{
+
+// a sink that appends to bytes and counts the calls
+struct vector_sink
+{
+    std::vector<std::uint8_t>& bytes;
+    std::uint64_t&             calls;
+
+    bool operator()(const std::uint8_t* data, std::size_t size)
+    {
+        bytes.insert(bytes.end(), data, data + size);
+        ++calls;
+        return true;
+    }
+};
+
+// a source that hands out at most 1000 bytes at a time
+struct trickle_source
+{
+    memory_source in;
+
+    std::size_t operator()(std::uint8_t* out, std::size_t size) { return in(out, std::min<std::size_t>(size, 1000)); }
+};
+
+} // namespace
+
+TEST(stream_bf_test, change_tracking)
+{
+    BF::bloom_filter bf;
+    ASSERT_TRUE(bf.config(100000, 0.01));
+    EXPECT_EQ(bf.block_count(), bf.size() / BF::bloom_filter<>::BLOCK_BYTES + 1);
+    EXPECT_EQ(bf.block_size(bf.block_count() - 1), bf.size() % BF::bloom_filter<>::BLOCK_BYTES);
+    EXPECT_EQ(bf.block_size(bf.block_count()), 0);
+
+    // nothing is tracked until asked for
+    const std::uint64_t key = 1;
+    ASSERT_TRUE(bf.add(key));
+    EXPECT_FALSE(bf.tracking_changes());
+    EXPECT_EQ(bf.changed_block_count(), 0);
+
+    ASSERT_TRUE(bf.track_changes());
+    EXPECT_EQ(bf.changed_block_count(), 0);
+    ASSERT_TRUE(bf.add(std::uint64_t(2)));
+    EXPECT_GE(bf.changed_block_count(), 1);
+    EXPECT_LE(bf.changed_block_count(), bf.hash_count());
+    for (std::uint64_t i = 0; i < bf.block_count(); ++i)
+    {
+        // every changed block has a bit of the key
+        if (bf.block_changed(i))
+        {
+            BF::bloom_filter probe;
+            ASSERT_TRUE(probe.config(100000, 0.01));
+            ASSERT_TRUE(probe.add(std::uint64_t(2)));
+            const std::uint8_t* block = probe.raw() + i * BF::bloom_filter<>::BLOCK_BYTES;
+            EXPECT_TRUE(std::any_of(block, block + probe.block_size(i), [](std::uint8_t byte) { return byte != 0; }));
+        }
+    }
+
+    bf.clear_changes();
+    EXPECT_EQ(bf.changed_block_count(), 0);
+    std::vector<std::uint64_t> keys(100);
+    for (std::uint64_t i = 0; i < keys.size(); ++i)
+        keys[i] = i + 10;
+    ASSERT_TRUE(bf.add_many(keys.data(), sizeof(std::uint64_t), keys.size()));
+    EXPECT_GT(bf.changed_block_count(), 0);
+
+    BF::bloom_filter other;
+    ASSERT_TRUE(other.config(100000, 0.01));
+    bf.clear_changes();
+    ASSERT_TRUE(bf.merge(other));
+    EXPECT_EQ(bf.changed_block_count(), bf.block_count());
+
+    // config starts over, still tracking
+    ASSERT_TRUE(bf.config(1000, 0.01));
+    EXPECT_TRUE(bf.tracking_changes());
+    EXPECT_EQ(bf.changed_block_count(), 0);
+}
+
+TEST(stream_bf_test, delta)
+{
+    BF::bloom_filter source, replica;
+    ASSERT_TRUE(source.config(1000000, 0.01));
+    ASSERT_TRUE(replica.config(1000000, 0.01));
+    ASSERT_TRUE(source.track_changes());
+
+    for (const bool compress : { true, false })
+    {
+        // a few keys touch a few blocks
+        const std::uint64_t first = compress ? 0 : 10;
+        for (std::uint64_t i = first; i < first + 10; ++i)
+            ASSERT_TRUE(source.add(i));
+
+        std::vector<std::uint8_t> delta;
+        std::uint64_t             calls = 0;
+        ASSERT_TRUE(BF::write_delta(source, vector_sink { delta, calls }, compress));
+        EXPECT_EQ(source.changed_block_count(), 0);
+        // a small part of the filter
+        EXPECT_LT(delta.size(), compress ? source.size() / 100 : source.size() / 2);
+
+        ASSERT_TRUE(BF::apply_delta(replica, trickle_source { { delta.data(), delta.size() } }));
+        ASSERT_EQ(std::memcmp(source.raw(), replica.raw(), source.size()), 0);
+
+        // applying twice does nothing
+        ASSERT_TRUE(BF::apply_delta(replica, memory_source { delta.data(), delta.size() }));
+        ASSERT_EQ(std::memcmp(source.raw(), replica.raw(), source.size()), 0);
+    }
+
+    // an empty delta is only a header
+    std::vector<std::uint8_t> empty;
+    std::uint64_t             calls = 0;
+    ASSERT_TRUE(BF::write_delta(source, vector_sink { empty, calls }));
+    EXPECT_EQ(empty.size(), sizeof(BF::delta_header));
+    EXPECT_TRUE(BF::apply_delta(replica, memory_source { empty.data(), empty.size() }));
+
+    // a failed write keeps the changes for the next one
+    ASSERT_TRUE(source.add(std::uint64_t(12345)));
+    const std::uint64_t changed = source.changed_block_count();
+    EXPECT_FALSE(BF::write_delta(source, [](const std::uint8_t*, std::size_t) { return false; }));
+    EXPECT_EQ(source.changed_block_count(), changed);
+
+    // a filter that does not track has no delta
+    BF::bloom_filter untracked;
+    ASSERT_TRUE(untracked.config(1000, 0.01));
+    EXPECT_FALSE(BF::write_delta(untracked, vector_sink { empty, calls }));
+}
+
+TEST(stream_bf_test, bad_deltas)
+{
+    BF::bloom_filter source, replica;
+    ASSERT_TRUE(source.config(100000, 0.01));
+    ASSERT_TRUE(replica.config(100000, 0.01));
+    ASSERT_TRUE(source.track_changes());
+    ASSERT_TRUE(source.add(std::uint64_t(7)));
+
+    std::vector<std::uint8_t> delta;
+    std::uint64_t             calls = 0;
+    ASSERT_TRUE(BF::write_delta(source, vector_sink { delta, calls }));
+
+    // a different shape
+    BF::bloom_filter smaller;
+    ASSERT_TRUE(smaller.config(1000, 0.01));
+    EXPECT_FALSE(BF::apply_delta(smaller, memory_source { delta.data(), delta.size() }));
+    BF::bloom_filter<BF::murmur3, BF::pow2_index> other_index;
+    ASSERT_TRUE(other_index.config(100000, 0.01));
+    EXPECT_FALSE(BF::apply_delta(other_index, memory_source { delta.data(), delta.size() }));
+
+    // truncated
+    EXPECT_FALSE(BF::apply_delta(replica, memory_source { delta.data(), delta.size() - 1 }));
+
+    // a flipped payload byte fails the checksum and is not merged
+    BF::bloom_filter clean;
+    ASSERT_TRUE(clean.config(100000, 0.01));
+    std::vector<std::uint8_t> corrupt = delta;
+    corrupt.back() ^= 0x10;
+    EXPECT_FALSE(BF::apply_delta(clean, memory_source { corrupt.data(), corrupt.size() }));
+    EXPECT_LT(clean.popcount(), source.popcount());
+
+    // a block past the end
+    corrupt = delta;
+    const std::uint64_t past_end = replica.block_count();
+    std::memcpy(corrupt.data() + sizeof(BF::delta_header), &past_end, sizeof(past_end));
+    EXPECT_FALSE(BF::apply_delta(replica, memory_source { corrupt.data(), corrupt.size() }));
+}
+
+TEST(stream_bf_test, run_length)
+{
+    std::uint8_t block[4096] = {};
+    std::uint8_t runs[4096];
+    std::uint8_t decoded[4096];
+
+    // all zeros is a single run
+    EXPECT_EQ(BF::encode_runs(block, sizeof(block), runs, sizeof(runs)), 4);
+    ASSERT_TRUE(BF::decode_runs(runs, 4, decoded, sizeof(decoded)));
+    EXPECT_EQ(std::memcmp(block, decoded, sizeof(block)), 0);
+
+    block[0]    = 1;
+    block[2]    = 2; // a short gap stays in the literals
+    block[100]  = 3;
+    block[4095] = 4;
+    const std::size_t size = BF::encode_runs(block, sizeof(block), runs, sizeof(runs));
+    ASSERT_GT(size, 0);
+    EXPECT_LT(size, 32);
+    ASSERT_TRUE(BF::decode_runs(runs, size, decoded, sizeof(decoded)));
+    EXPECT_EQ(std::memcmp(block, decoded, sizeof(block)), 0);
+
+    // does not decode into a block of a different size
+    EXPECT_FALSE(BF::decode_runs(runs, size, decoded, sizeof(decoded) - 1));
+    EXPECT_FALSE(BF::decode_runs(runs, size - 1, decoded, sizeof(decoded)));
+
+    // incompressible data does not fit
+    for (std::size_t i = 0; i < sizeof(block); ++i)
+        block[i] = i % 255 + 1;
+    EXPECT_EQ(BF::encode_runs(block, sizeof(block), runs, sizeof(runs) - 1), 0);
+}
+
+TEST(stream_bf_test, write_and_read_filter)
+{
+    BF::bloom_filter<BF::murmur3, BF::modulo_index, BF::counting_stats> bf;
+    ASSERT_TRUE(bf.config(100000, 0.01));
+    for (std::uint64_t i = 0; i < 100000; ++i)
+        ASSERT_TRUE(bf.add(i));
+
+    std::vector<std::uint8_t> bytes;
+    std::uint64_t             calls = 0;
+    ASSERT_TRUE(BF::write_filter(bf, vector_sink { bytes, calls }, 10000));
+    EXPECT_EQ(bytes.size(), sizeof(BF::file_header) + bf.size());
+    EXPECT_EQ(calls, 1 + bf.size() / 10000 + 1);
+
+    // the same bytes as save()
+    const std::string path = ::testing::TempDir() + "stream_bf_test.bf";
+    ASSERT_TRUE(BF::save(bf, path));
+    {
+        std::ifstream                   file(path, std::ios::binary);
+        const std::vector<std::uint8_t> saved((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        EXPECT_EQ(saved, bytes);
+    }
+    std::remove(path.c_str());
+
+    BF::bloom_filter<BF::murmur3, BF::modulo_index, BF::counting_stats> copy;
+    ASSERT_TRUE(BF::read_filter(copy, trickle_source { { bytes.data(), bytes.size() } }));
+    EXPECT_EQ(copy.bit_count(), bf.bit_count());
+    EXPECT_EQ(copy.hash_count(), bf.hash_count());
+    EXPECT_EQ(copy.expected_elements(), bf.expected_elements());
+    EXPECT_EQ(copy.false_positive(), bf.false_positive());
+    ASSERT_EQ(std::memcmp(copy.raw(), bf.raw(), bf.size()), 0);
+    EXPECT_EQ(copy.stats().inserts, 0);
+
+    // bad input leaves an empty filter
+    bytes[sizeof(BF::file_header) + 12345] ^= 1;
+    EXPECT_FALSE(BF::read_filter(copy, memory_source { bytes.data(), bytes.size() }));
+    EXPECT_EQ(copy.raw(), nullptr);
+    bytes[sizeof(BF::file_header) + 12345] ^= 1;
+    EXPECT_FALSE(BF::read_filter(copy, memory_source { bytes.data(), bytes.size() - 1 }));
+    EXPECT_EQ(copy.raw(), nullptr);
+    BF::bloom_filter<BF::xxh3> other_hasher;
+    EXPECT_FALSE(BF::read_filter(other_hasher, memory_source { bytes.data(), bytes.size() }));
+}
+
+} // BF